@@ -550,7 +550,20 @@ integrationtest_ubuntu_gpu_dist_kvstore() {
     cd tests/nightly/
     ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py
     ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --no-multiprecision
+    MXNET_KVSTORE_FUSION_THRESHOLD=65536 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type fused
+    ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type topk
+    MXNET_KVSTORE_WIRE_DTYPE=float16 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type default
+    MXNET_KVSTORE_SERVER_SPARSE_STORE=1 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type sparse_store
+    ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type save_snapshot
+    MXNET_KVSTORE_SERVER_RESTORE=/tmp/dist_sync_kvstore_snapshot ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type restore_snapshot
+    MXNET_KVSTORE_SERVER_SPARSE_STORE=1 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type save_snapshot
+    MXNET_KVSTORE_SERVER_SPARSE_STORE=1 MXNET_KVSTORE_SERVER_RESTORE=/tmp/dist_sync_kvstore_snapshot ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type restore_snapshot
     ../../tools/launch.py -n 7 --launcher local python dist_device_sync_kvstore.py
+    MXNET_KVSTORE_STALENESS=1 ../../tools/launch.py -n 7 --launcher local python dist_async_kvstore.py
+    # the servers update the keys in several threads
+    MXNET_KVSTORE_SERVER_UPDATE_THREADS=4 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py
+    MXNET_KVSTORE_SERVER_UPDATE_THREADS=4 MXNET_KVSTORE_FUSION_THRESHOLD=65536 ../../tools/launch.py -n 7 --launcher local python dist_sync_kvstore.py --type fused
+    MXNET_KVSTORE_SERVER_UPDATE_THREADS=4 ../../tools/launch.py -n 7 --launcher local python dist_async_kvstore.py
 }
 
 test_ubuntu_cpu_python2() {
@@ -0,0 +1,109 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+Benchmark the training speed on various CNNs with bulk execution segments cut
+by node count (MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN) against segments cut by
+the operator costs of a profiled run (MXNET_EXEC_BULK_EXEC_COST_PROFILE)
+"""
+from common import find_mxnet
+from common.util import get_gpus
+import mxnet as mx
+from importlib import import_module
+import argparse
+import logging
+import os
+import tempfile
+import time
+logging.basicConfig(level=logging.DEBUG)
+
+def get_symbol(network, batch_size):
+    image_shape = (3,299,299) if network == 'inception-v3' else (3,224,224)
+    num_layers = 0
+    if 'resnet' in network:
+        num_layers = int(network.split('-')[1])
+        network = 'resnet'
+    if 'vgg' in network:
+        num_layers = int(network.split('-')[1])
+        network = 'vgg'
+    net = import_module('symbols.'+network)
+    sym = net.get_symbol(num_classes = 1000,
+                         image_shape = ','.join([str(i) for i in image_shape]),
+                         num_layers  = num_layers)
+    return (sym, [('data', (batch_size,)+image_shape)], [('softmax_label', (batch_size,))])
+
+def run(network, dev, batch_size, num_batches, profile=False):
+    sym, data_shape, label_shape = get_symbol(network, batch_size)
+    mod = mx.mod.Module(symbol=sym, context=dev)
+    mod.bind(for_training=True, data_shapes=data_shape, label_shapes=label_shape)
+    mod.init_params(initializer=mx.init.Xavier(magnitude=2.))
+    mod.init_optimizer(optimizer='sgd', optimizer_params={'learning_rate': 0.01})
+
+    data = [mx.random.uniform(-1.0, 1.0, shape=shape, ctx=dev) for _, shape in data_shape]
+    label = [mx.nd.zeros(shape, ctx=dev) for _, shape in label_shape]
+    batch = mx.io.DataBatch(data, label)
+
+    dry_run = 5
+    for i in range(dry_run+num_batches):
+        if i == dry_run:
+            mx.nd.waitall()
+            if profile:
+                mx.profiler.set_state('run')
+            tic = time.time()
+        mod.forward_backward(batch)
+        mod.update()
+    mx.nd.waitall()
+    toc = time.time()
+    if profile:
+        mx.profiler.set_state('stop')
+    return num_batches*batch_size/(toc - tic)
+
+def profile_costs(network, dev, batch_size, num_batches):
+    """Profile a run without bulk execution and save its aggregate statistics."""
+    mx.profiler.set_config(profile_symbolic=True, aggregate_stats=True,
+                           filename=os.path.join(tempfile.gettempdir(), 'profile.json'))
+    run(network, dev, batch_size, num_batches, profile=True)
+    fd, path = tempfile.mkstemp(prefix='%s-' % network, suffix='.txt')
+    with os.fdopen(fd, 'w') as f:
+        f.write(mx.profiler.dumps(reset=True))
+    mx.profiler.set_config(profile_symbolic=False, aggregate_stats=False)
+    return path
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='benchmark cost guided bulk execution')
+    parser.add_argument('--networks', type=str, default='inception-bn,resnet-50,googlenet',
+                        help='comma separated networks of the symbols directory')
+    parser.add_argument('--batch-size', type=int, default=16)
+    parser.add_argument('--num-batches', type=int, default=10)
+    parser.add_argument('--max-segment-cost', type=float, default=1000,
+                        help='MXNET_EXEC_BULK_EXEC_MAX_SEGMENT_COST in microseconds')
+    args = parser.parse_args()
+
+    dev = mx.gpu(0) if len(get_gpus()) > 0 else mx.cpu()
+    os.environ['MXNET_EXEC_BULK_EXEC_MAX_SEGMENT_COST'] = str(args.max_segment_cost)
+    for net in args.networks.split(','):
+        logging.info('network: %s, device: %s, batch size: %d', net, dev, args.batch_size)
+        os.environ.pop('MXNET_EXEC_BULK_EXEC_COST_PROFILE', None)
+        speed = run(net, dev, args.batch_size, args.num_batches)
+        logging.info('node count segments, image/sec: %f', speed)
+
+        profile = profile_costs(net, dev, args.batch_size, args.num_batches)
+        os.environ['MXNET_EXEC_BULK_EXEC_COST_PROFILE'] = profile
+        speed = run(net, dev, args.batch_size, args.num_batches)
+        logging.info('cost guided segments, image/sec: %f', speed)
+        os.environ.pop('MXNET_EXEC_BULK_EXEC_COST_PROFILE')
+        os.remove(profile)
@@ -121,6 +121,13 @@ MXNET_DLL int MXPredCreatePartialOut(const char* symbol_json_str,
                                      PredictorHandle* out);
 /*!
  * \brief Change the input shape of an existing predictor.
+ *  If MXNET_PREDICTOR_EXEC_CACHE_SIZE is set, the executors of the shapes seen
+ *  before are reused and the original predictor stays valid. The predictors
+ *  reshaped from one predictor share their executors and memory but have their
+ *  own inputs and outputs, which are copied to and from the executor by
+ *  MXPredForward, so that they can be used in turn. They must not be used from
+ *  several threads at once, nor run partial forwards interleaved with each other.
+ *  Otherwise the original predictor must not be used after the reshape.
  * \param num_input_nodes Number of input nodes to the net,
  *    For feedforward net, this is 1.
  * \param input_keys The name of input argument.
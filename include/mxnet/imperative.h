@@ -26,8 +26,10 @@
 #include <nnvm/symbolic.h>
 #include <nnvm/op.h>
 #include <nnvm/graph.h>
+#include <nnvm/graph_attr_types.h>
 #include <vector>
 #include <atomic>
+#include <memory>
 #include <utility>
 #include <string>
 #include <unordered_map>
@@ -40,6 +42,9 @@ struct CachedOpParam : public dmlc::Parameter<CachedOpParam> {
   uint32_t inline_limit;
   uint32_t forward_bulk_size;
   uint32_t backward_bulk_size;
+  bool static_alloc;
+  bool static_shape;
+  uint32_t max_static_states;
   DMLC_DECLARE_PARAMETER(CachedOpParam) {
     DMLC_DECLARE_FIELD(inline_limit)
     .set_default(2)
@@ -50,6 +55,20 @@ struct CachedOpParam : public dmlc::Parameter<CachedOpParam> {
     DMLC_DECLARE_FIELD(backward_bulk_size)
     .set_default(dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN", 15))
     .describe("Segment size of bulk execution during backward pass.");
+    DMLC_DECLARE_FIELD(static_alloc)
+    .set_default(false)
+    .describe("Keep the memory plan, intermediate arrays and operator states of "
+              "each input shape signature across calls, so that inference forward "
+              "does neither allocate intermediate memory nor infer attributes.");
+    DMLC_DECLARE_FIELD(static_shape)
+    .set_default(false)
+    .describe("Assume the input shapes never change between calls. "
+              "Requires static_alloc.");
+    DMLC_DECLARE_FIELD(max_static_states)
+    .set_default(dmlc::GetEnv("MXNET_CACHEDOP_MAX_STATIC_STATES", 8))
+    .set_lower_bound(1)
+    .describe("Maximum number of input shape signatures of which static_alloc "
+              "keeps the memory. The least recently used one is freed beyond it.");
   }
 };
 /*! \brief runtime functions for NDArray */
@@ -137,6 +156,25 @@ class Imperative {
       std::vector<NDArray> buff;
       std::vector<OpStatePtr> states;
     };
+    /*! \brief execution state of one input signature kept by static_alloc */
+    struct StaticState {
+      Context ctx;
+      nnvm::ShapeVector input_shapes;
+      nnvm::DTypeVector input_dtypes;
+      StorageTypeVector input_stypes;
+      /*! \brief forward graph with the attributes inferred for the signature */
+      nnvm::Graph graph;
+      std::vector<NDArray> buff;
+      std::vector<NDArray*> arrays;
+      std::vector<OpStatePtr> states;
+      std::vector<OpReqType> array_reqs;
+      /*! \brief reference counts that never drop to zero, keeping buff alive */
+      std::vector<uint32_t> ref_count;
+    };
+    StaticState* GetStaticState(const Context& ctx,
+                                const std::vector<NDArray*>& inputs);
+    void StaticForward(const std::vector<NDArray*>& inputs,
+                       const std::vector<NDArray*>& outputs);
     std::mutex mutex_;
     CachedOpParam param_;
     nnvm::Graph fwd_graph_;
@@ -148,6 +186,8 @@ class Imperative {
     std::vector<uint32_t> bwd_in_dep_, bwd_out_dep_, bwd_ograd_dep_;
     std::vector<uint32_t> bwd_input_eid_;
     std::vector<bool> save_inputs_, save_outputs_;
+    /*! \brief states of static_alloc, most recently used first */
+    std::vector<std::unique_ptr<StaticState> > static_states_;
   };
   /*! \brief whether operator recording is on. */
   bool is_training() const {
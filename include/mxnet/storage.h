@@ -95,6 +95,13 @@ class Storage {
    * \param handle Handle struct.
    */
   virtual void DirectFree(Handle handle) = 0;
+  /*!
+   * \brief Release all memory cached by the pool of a device.
+   *  Memory that is still in use is not affected. No-op for devices without a pool.
+   *
+   * \param ctx Context of the device.
+   */
+  virtual void ReleaseAll(Context ctx) = 0;
   /*!
    * \brief Destructor.
    */
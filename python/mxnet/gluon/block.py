@@ -447,6 +447,15 @@ class Block(object):
         ----------
         active : bool, default True
             Whether to turn hybrid on or off.
+        static_alloc : bool, default False
+            Statically allocate memory to improve speed. Memory usage may increase.
+            Only applies to calls outside of autograd recording.
+        static_shape : bool, default False
+            Optimize for invariant input shapes between iterations.
+            Must also set static_alloc to True.
+        max_static_states : int, default 8
+            Maximum number of input shapes of which static_alloc keeps the memory.
+            The memory of the least recently used one is freed beyond it.
         **kwargs : string
             Additional flags for hybridized operator.
         """
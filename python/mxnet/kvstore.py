@@ -21,14 +21,21 @@ from __future__ import absolute_import
 
 from array import array
 import ctypes
+import os
 import pickle
 from .ndarray import NDArray
 from .ndarray import _ndarray_cls
+from .ndarray import zeros
 from .base import _LIB, c_str_array, c_handle_array, c_array, c_array_buf, c_str
 from .base import check_call, string_types, mx_uint, py_str
 from .base import NDArrayHandle, KVStoreHandle
 from . import optimizer as opt
 
+def _server_sparse_store():
+    """Whether the servers keep the rows of row_sparse values in hash tables."""
+    value = os.environ.get('MXNET_KVSTORE_SERVER_SPARSE_STORE', '0')
+    return value.lower() not in ('0', 'false', '')
+
 def _ctype_key_value(keys, vals):
     """
     Returns ctype arrays for the key-value args, and the whether string keys are used.
@@ -88,7 +95,9 @@ def _get_kvstore_server_command_type(command):
                      'kSetMultiPrecision': 1,
                      'kStopServer': 2,
                      'kSyncMode': 3,
-                     'kSetGradientCompression': 4}
+                     'kSetGradientCompression': 4,
+                     'kSaveSnapshot': 5,
+                     'kWaitSnapshot': 6}
     assert (command in command_types), "Unknown command type to send to server"
     return command_types[command]
 
@@ -400,6 +409,14 @@ class KVStore(object):
         original values is stored at the sender's end as residual and added to the
         gradient in the next iteration.
 
+        Top-k Gradient Compression takes a float `ratio` in (0, 0.5].
+        The gradient is split into blocks, and each block only sends the fraction `ratio`
+        of its values with the largest absolute values, as pairs of an index and a value.
+        The fraction is rounded to 1 / (2 * round(0.5 / ratio)), so that 0.3 sends 0.25.
+        The values which are not sent stay in the residual and are added to the gradient
+        in the next iteration, like for 2bit compression. Top-k compression runs on CPU only,
+        so it is meant for 'dist' kvstores whose gradients are sent from CPU.
+
         When kvstore is 'local', gradient compression is used to reduce communication
         between multiple devices (gpus). Gradient is quantized on each GPU which
         computed the gradients, then sent to the GPU which merges the gradients. This
@@ -422,13 +439,16 @@ class KVStore(object):
         a dictionary which includes `threshold` like:
         {'type': '2bit', 'threshold': 0.5}
 
+        To use top-k compression, we need to specify `type` as `topk` and optionally
+        the `ratio`, like: {'type': 'topk', 'ratio': 0.001}
+
         Parameters
         ----------
         compression_params : dict
             A dictionary specifying the type and parameters for gradient compression.
             The key `type` in this dictionary is a
             required string argument and specifies the type of gradient compression.
-            Currently `type` can be only `2bit`
+            Currently `type` can be `2bit` or `topk`
             Other keys in this dictionary are optional and specific to the type
             of gradient compression.
         """
@@ -473,6 +493,15 @@ class KVStore(object):
         is_worker = ctypes.c_int()
         check_call(_LIB.MXKVStoreIsWorkerNode(ctypes.byref(is_worker)))
 
+        # pylint: disable=unsupported-membership-test
+        if 'dist' in self.type and _server_sparse_store():
+            # the rows of a push reach the updater as one array of changing shape
+            if optimizer.create_state_multi_precision(0, zeros((1,))) is not None:
+                raise ValueError("Optimizer %s keeps states, which are not supported with "
+                                 "MXNET_KVSTORE_SERVER_SPARSE_STORE. Use an optimizer without "
+                                 "states, such as SGD without momentum."
+                                 % type(optimizer).__name__)
+
         # pylint: disable=invalid-name
         if 'dist' in self.type and is_worker.value: # pylint: disable=unsupported-membership-test
             # send the optimizer to server
@@ -555,6 +584,42 @@ class KVStore(object):
         assert self._updater is not None, "Cannot load states for distributed training"
         self._updater.set_states(open(fname, 'rb').read())
 
+    def save_server_snapshot(self, prefix):
+        """Saves the values stored by the servers of a distributed kvstore.
+
+        Each server copies its values and writes them in the background to
+        ``prefix-server-<rank>.params`` on its own disk, in the format of ``mx.nd.save``,
+        so that training continues while they are written. Servers started with the
+        environment variable ``MXNET_KVSTORE_SERVER_RESTORE`` set to ``prefix`` use the
+        saved values instead of the initial values of the keys found in them, which
+        requires the same number of servers.
+
+        The optimizer states are not saved. Call it from one worker, for instance the
+        worker of rank 0 after it pulled the values of an iteration.
+
+        It returns once the values are copied, before the files are written. Call
+        `wait_server_snapshot` to wait until they are. A server that fails to write
+        its file logs the error and keeps serving, without a file for this snapshot.
+
+        Parameters
+        ----------
+        prefix : str
+            Path prefix of the files written by the servers.
+        """
+        assert 'dist' in self.type, "Only distributed kvstores have servers"
+        cmd = _get_kvstore_server_command_type('kSaveSnapshot')
+        self._send_command_to_servers(cmd, prefix)
+
+    def wait_server_snapshot(self):
+        """Waits until the servers finished writing the last snapshot saved by
+        `save_server_snapshot`, or failed to.
+
+        The servers do not serve pushes and pulls while they wait for their files.
+        """
+        assert 'dist' in self.type, "Only distributed kvstores have servers"
+        cmd = _get_kvstore_server_command_type('kWaitSnapshot')
+        self._send_command_to_servers(cmd, '')
+
     def _set_updater(self, updater):
         """Sets a push updater into the store.
 
@@ -651,9 +716,16 @@ def create(name='local'):
     No two updates happen on the same weight at the same time. However, the order is not
     guaranteed.
 
+    For several processes on one machine, such as one per CPU socket:
+
+    ``shm``: Behaves like ``dist_sync`` without servers. The processes sum their
+    gradients through shared memory, and each of them updates its own copy of the weights.
+    Each process sets ``MXNET_KVSTORE_SHM_RANK`` and ``MXNET_KVSTORE_SHM_NUM_PROCS``, and
+    all processes of a job the same ``MXNET_KVSTORE_SHM_NAME``. Only dense values are supported.
+
     Parameters
     ----------
-    name : {'local', 'device', 'nccl', 'dist_sync', 'dist_device_sync', 'dist_async'}
+    name : {'local', 'device', 'nccl', 'dist_sync', 'dist_device_sync', 'dist_async', 'shm'}
         The type of KVStore.
     Returns
     -------
@@ -75,8 +75,8 @@ def _create_kvstore(kvstore, num_device, arg_params):
         kv = kvstore
     elif isinstance(kvstore, str):
         # create kvstore using the string type
-        if num_device is 1 and 'dist' not in kvstore:
-            # no need to use kv for single device and single machine
+        if num_device is 1 and 'dist' not in kvstore and 'shm' not in kvstore:
+            # no need to use kv for single device and single process
             kv = None
         else:
             kv = kvs.create(kvstore)
@@ -849,7 +849,8 @@ class FeedForward(BASE_ESTIMATOR):
         # init optmizer
         if isinstance(self.optimizer, str):
             batch_size = data.batch_size
-            if kvstore and 'dist' in kvstore.type and '_async' not in kvstore.type:
+            if kvstore and (('dist' in kvstore.type and '_async' not in kvstore.type) or
+                            'shm' in kvstore.type):
                 batch_size *= kvstore.num_workers
             optimizer = opt.create(self.optimizer,
                                    rescale_grad=(1.0/batch_size),
@@ -34,6 +34,7 @@
 #include "./c_api_common.h"
 #include "../operator/operator_common.h"
 #include "../executor/exec_pass.h"
+#include "../executor/bucketed_executor_cache.h"
 
 using namespace mxnet;
 
@@ -52,13 +53,69 @@ struct MXAPIPredictor {
   // key to arguments
   std::unordered_map<std::string, size_t> key2arg;
   // executor
-  std::unique_ptr<Executor> exec;
+  std::shared_ptr<Executor> exec;
   // symbol
   nnvm::Symbol sym;
   // Context
   Context ctx;
+  // executors of the input shapes seen so far, shared with the reshaped predictors
+  std::shared_ptr<exec::BucketedExecutorCache> exec_cache;
+  // with exec_cache, the argument arrays of exec the inputs are copied to
+  std::vector<NDArray> exec_arg_arrays;
+  // with exec_cache, the output arrays of exec copied to out_arrays
+  std::vector<NDArray> exec_out_arrays;
 };
 
+// number of executors kept by a predictor for the input shapes it is reshaped to,
+// 0 to rebind on every reshape
+inline size_t PredictorExecCacheSize() {
+  return dmlc::GetEnv("MXNET_PREDICTOR_EXEC_CACHE_SIZE", static_cast<size_t>(0));
+}
+
+// takes the executor of input_shape from the cache of the predictor. The predictor
+// has its own input and output arrays, since the executor and its memory are shared
+// with the other predictors of the cache.
+void BindFromCache(const std::unordered_map<std::string, TShape>& input_shape,
+                   MXAPIPredictor* p) {
+  p->exec = p->exec_cache->Get(input_shape);
+  const std::unordered_map<std::string, NDArray>& in_args = p->exec->in_arg_map();
+  const std::unordered_map<std::string, NDArray>& aux_states = p->exec->aux_state_map();
+  p->arg_arrays.clear();
+  p->exec_arg_arrays.clear();
+  for (const std::string& name : p->sym.ListInputNames(Symbol::kReadOnlyArgs)) {
+    const NDArray& arr = in_args.at(name);
+    p->exec_arg_arrays.push_back(arr);
+    p->arg_arrays.push_back(input_shape.count(name) == 0 ? arr :
+                            NDArray(arr.shape(), arr.ctx(), false, arr.dtype()));
+  }
+  p->aux_arrays.clear();
+  for (const std::string& name : p->sym.ListInputNames(Symbol::kAuxiliaryStates)) {
+    p->aux_arrays.push_back(aux_states.at(name));
+  }
+  p->exec_out_arrays = p->exec->outputs();
+  p->out_arrays.clear();
+  for (const NDArray& arr : p->exec_out_arrays) {
+    p->out_arrays.emplace_back(arr.shape(), arr.ctx(), false, arr.dtype());
+  }
+}
+
+// copies the inputs of a predictor of the cache into its executor
+void CopyInputsToCache(MXAPIPredictor* p) {
+  for (size_t i = 0; i < p->arg_arrays.size(); ++i) {
+    if (p->arg_arrays[i].var() != p->exec_arg_arrays[i].var()) {
+      CopyFromTo(p->arg_arrays[i], &p->exec_arg_arrays[i]);
+    }
+  }
+}
+
+// copies the outputs of the executor of a predictor of the cache, before the
+// executor, or another one sharing its memory, runs for another predictor
+void CopyOutputsFromCache(MXAPIPredictor* p) {
+  for (size_t i = 0; i < p->out_arrays.size(); ++i) {
+    CopyFromTo(p->exec_out_arrays[i], &p->out_arrays[i]);
+  }
+}
+
 struct MXAPINDList {
   std::vector<std::string> keys;
   std::vector<TShape> shapes;
@@ -214,36 +271,71 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
   }
 
   Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
-
-  std::vector<NDArray> arg_arrays, aux_arrays;
-  for (size_t i = 0; i < arg_shapes.size(); ++i) {
-    NDArray nd = NDArray(arg_shapes[i], ctx);
-    if (arg_params.count(arg_names[i]) != 0) {
-      CopyFromTo(arg_params[arg_names[i]], &nd);
+  ret->sym = sym;
+  ret->ctx = ctx;
+  ret->out_shapes = out_shapes;
+
+  const size_t exec_cache_size = PredictorExecCacheSize();
+  if (exec_cache_size != 0) {
+    // the executors of all the input shapes share the parameters of the first one
+    std::unordered_set<std::string> param_names;
+    std::unordered_map<std::string, int> input_dtype;
+    for (const std::string& name : arg_names) {
+      if (known_shape.count(name) == 0) {
+        param_names.insert(name);
+      } else {
+        input_dtype[name] = mshadow::kFloat32;
+      }
     }
-    arg_arrays.push_back(nd);
-  }
-  for (size_t i = 0; i < aux_shapes.size(); ++i) {
-    NDArray nd = NDArray(aux_shapes[i], ctx);
-    if (aux_params.count(aux_names[i]) != 0) {
-      CopyFromTo(aux_params[aux_names[i]], &nd);
+    ret->exec_cache = std::make_shared<exec::BucketedExecutorCache>(
+        sym, ctx, std::map<std::string, Context>(),
+        std::vector<Context>(arg_names.size(), ctx),
+        std::vector<Context>(arg_names.size(), ctx),
+        std::vector<Context>(aux_names.size(), ctx),
+        input_dtype, std::unordered_map<std::string, int>(),
+        std::vector<OpReqType>(arg_names.size(), kNullOp),
+        param_names, exec_cache_size);
+    BindFromCache(known_shape, ret);
+    for (size_t i = 0; i < arg_names.size(); ++i) {
+      if (arg_params.count(arg_names[i]) != 0) {
+        CopyFromTo(arg_params[arg_names[i]], &ret->arg_arrays[i]);
+      }
+    }
+    for (size_t i = 0; i < aux_names.size(); ++i) {
+      if (aux_params.count(aux_names[i]) != 0) {
+        CopyFromTo(aux_params[aux_names[i]], &ret->aux_arrays[i]);
+      }
+    }
+  } else {
+    std::vector<NDArray> arg_arrays, aux_arrays;
+    for (size_t i = 0; i < arg_shapes.size(); ++i) {
+      NDArray nd = NDArray(arg_shapes[i], ctx);
+      if (arg_params.count(arg_names[i]) != 0) {
+        CopyFromTo(arg_params[arg_names[i]], &nd);
+      }
+      arg_arrays.push_back(nd);
+    }
+    for (size_t i = 0; i < aux_shapes.size(); ++i) {
+      NDArray nd = NDArray(aux_shapes[i], ctx);
+      if (aux_params.count(aux_names[i]) != 0) {
+        CopyFromTo(aux_params[aux_names[i]], &nd);
+      }
+      aux_arrays.push_back(nd);
+    }
+    ret->arg_arrays = arg_arrays;
+    ret->aux_arrays = aux_arrays;
+    // bind
+    {
+      std::map<std::string, Context> ctx_map;
+      std::vector<NDArray> grad_store(arg_arrays.size());
+      std::vector<OpReqType> grad_req(arg_arrays.size(), kNullOp);
+
+      ret->exec.reset(Executor::Bind(sym, ctx, ctx_map,
+                                     arg_arrays,
+                                     grad_store, grad_req,
+                                     aux_arrays));
+      ret->out_arrays = ret->exec->outputs();
     }
-    aux_arrays.push_back(nd);
-  }
-  ret->arg_arrays = arg_arrays;
-  // bind
-  {
-    std::map<std::string, Context> ctx_map;
-    std::vector<NDArray> grad_store(arg_arrays.size());
-    std::vector<OpReqType> grad_req(arg_arrays.size(), kNullOp);
-
-
-    ret->exec.reset(Executor::Bind(sym, ctx, ctx_map,
-                                   arg_arrays,
-                                   grad_store, grad_req,
-                                   aux_arrays));
-    ret->out_shapes = out_shapes;
-    ret->out_arrays = ret->exec->outputs();
   }
   *out = ret;
   API_END_HANDLE_ERROR(delete ret);
@@ -296,45 +388,51 @@ int MXPredReshape(mx_uint num_input_nodes,
     throw dmlc::Error(err.msg);
   }
 
-  ret->arg_arrays = p->arg_arrays;
   ret->ctx = p->ctx;
-  for (size_t i=0; i < arg_names.size(); ++i) {
-    TShape newShape = arg_shapes[i];
-    NDArray &arr = p->arg_arrays[i];
-    if (new_shape.count(arg_names[i]) != 0) {
-      ret->arg_arrays[i].ReshapeAndAlloc(newShape);
-    } else {
-       CHECK_EQ(newShape.Size(), arr.shape().Size())
-        << "arg " << arg_names[i]
-        << " shape has been changed, only allow to change the shape of input data.";
+  ret->out_shapes = out_shapes;
+  if (p->exec_cache != nullptr) {
+    // the executors of the shapes seen before are reused, and p stays valid
+    ret->exec_cache = p->exec_cache;
+    BindFromCache(new_shape, ret.get());
+  } else {
+    ret->arg_arrays = p->arg_arrays;
+    for (size_t i=0; i < arg_names.size(); ++i) {
+      TShape newShape = arg_shapes[i];
+      NDArray &arr = p->arg_arrays[i];
+      if (new_shape.count(arg_names[i]) != 0) {
+        ret->arg_arrays[i].ReshapeAndAlloc(newShape);
+      } else {
+         CHECK_EQ(newShape.Size(), arr.shape().Size())
+          << "arg " << arg_names[i]
+          << " shape has been changed, only allow to change the shape of input data.";
+      }
     }
-  }
-  p->arg_arrays.clear();
+    p->arg_arrays.clear();
 
-  for (size_t i=0; i < aux_names.size(); ++i) {
-    TShape newShape = aux_shapes[i];
-    NDArray &arr = p->aux_arrays[i];
-    CHECK_EQ(newShape.Size(), arr.shape().Size())
-      << "aux " << aux_names[i]
-      << " shape has been changed, only allow to change the shape of input data.";
-  }
-  ret->aux_arrays = p->aux_arrays;
-  p->aux_arrays.clear();
-
-  // bind
-  {
-    std::map<std::string, Context> ctx_map;
-    std::vector<NDArray> grad_store;
-    grad_store.reserve(ret->arg_arrays.size());
-    std::vector<OpReqType> grad_req(ret->arg_arrays.size(), kNullOp);
-
-    ret->exec.reset(Executor::Bind(ret->sym, ret->ctx, ctx_map,
-                                   ret->arg_arrays,
-                                   grad_store, grad_req,
-                                   ret->aux_arrays,
-                                   p->exec.get()));
-    ret->out_shapes = out_shapes;
-    ret->out_arrays = ret->exec->outputs();
+    for (size_t i=0; i < aux_names.size(); ++i) {
+      TShape newShape = aux_shapes[i];
+      NDArray &arr = p->aux_arrays[i];
+      CHECK_EQ(newShape.Size(), arr.shape().Size())
+        << "aux " << aux_names[i]
+        << " shape has been changed, only allow to change the shape of input data.";
+    }
+    ret->aux_arrays = p->aux_arrays;
+    p->aux_arrays.clear();
+
+    // bind
+    {
+      std::map<std::string, Context> ctx_map;
+      std::vector<NDArray> grad_store;
+      grad_store.reserve(ret->arg_arrays.size());
+      std::vector<OpReqType> grad_req(ret->arg_arrays.size(), kNullOp);
+
+      ret->exec.reset(Executor::Bind(ret->sym, ret->ctx, ctx_map,
+                                     ret->arg_arrays,
+                                     grad_store, grad_req,
+                                     ret->aux_arrays,
+                                     p->exec.get()));
+      ret->out_arrays = ret->exec->outputs();
+    }
   }
   *out = ret.release();
   API_END();
@@ -375,14 +473,18 @@ int MXPredSetInput(PredictorHandle handle,
 int MXPredForward(PredictorHandle handle) {
   MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
   API_BEGIN();
+  if (p->exec_cache != nullptr) CopyInputsToCache(p);
   p->exec->Forward(false);
+  if (p->exec_cache != nullptr) CopyOutputsFromCache(p);
   API_END();
 }
 
 int MXPredPartialForward(PredictorHandle handle, int step, int* step_left) {
   MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
   API_BEGIN();
+  if (p->exec_cache != nullptr && step == 0) CopyInputsToCache(p);
   p->exec->PartialForward(false, step, step_left);
+  if (p->exec_cache != nullptr && *step_left == 0) CopyOutputsFromCache(p);
   API_END();
 }
 
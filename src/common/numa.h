@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file numa.h
+ * \brief NUMA topology of the host, thread and memory binding to NUMA nodes.
+ *  CPU contexts are mapped to the nodes with CPUs by dev_id, so that cpu(i) runs
+ *  on the i-th of them when MXNET_CPU_NUMA_BINDING is set. Binding is only implemented on Linux.
+ */
+#ifndef MXNET_COMMON_NUMA_H_
+#define MXNET_COMMON_NUMA_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif  // defined(__linux__)
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace common {
+
+/*!
+ * \brief Parse a cpu list of the form "0-3,8,10-11".
+ */
+inline std::vector<int> ParseCPUList(const std::string& list) {
+  std::vector<int> ret;
+  std::istringstream is(list);
+  std::string range;
+  while (std::getline(is, range, ',')) {
+    if (range.empty()) continue;
+    const size_t dash = range.find('-');
+    const int begin = std::stoi(range.substr(0, dash));
+    const int end = dash == std::string::npos ? begin : std::stoi(range.substr(dash + 1));
+    for (int cpu = begin; cpu <= end; ++cpu) ret.push_back(cpu);
+  }
+  return ret;
+}
+
+/*!
+ * \brief A NUMA node with CPUs.
+ */
+struct NumaNode {
+  /*! \brief id of the node, as used by the kernel */
+  int id;
+  /*! \brief CPUs of the node */
+  std::vector<int> cpus;
+};
+
+/*!
+ * \brief Read the online NUMA nodes with CPUs from a sysfs directory such as
+ *  /sys/devices/system/node. Node ids may have gaps, and nodes without CPUs,
+ *  such as memory-only nodes, are left out.
+ */
+inline std::vector<NumaNode> ReadNumaNodes(const std::string& dir) {
+  std::vector<NumaNode> ret;
+  std::ifstream online(dir + "/online");
+  std::string list;
+  if (!online || !std::getline(online, list)) return ret;
+  for (int id : ParseCPUList(list)) {
+    std::ifstream is(dir + "/node" + std::to_string(id) + "/cpulist");
+    std::string cpus;
+    if (!is || !std::getline(is, cpus)) continue;
+    NumaNode node{id, ParseCPUList(cpus)};
+    if (!node.cpus.empty()) ret.push_back(std::move(node));
+  }
+  return ret;
+}
+
+/*!
+ * \brief NUMA nodes with CPUs. A host without NUMA information has one node with all CPUs.
+ */
+inline const std::vector<NumaNode>& NumaNodes() {
+  static const std::vector<NumaNode> nodes = []() {
+    std::vector<NumaNode> ret;
+#if defined(__linux__)
+    ret = ReadNumaNodes("/sys/devices/system/node");
+#endif  // defined(__linux__)
+    if (ret.empty()) {
+      ret.push_back(NumaNode{0, {}});
+      const int num_cpus = std::max(1U, std::thread::hardware_concurrency());
+      for (int cpu = 0; cpu < num_cpus; ++cpu) ret.back().cpus.push_back(cpu);
+    }
+    return ret;
+  }();
+  return nodes;
+}
+
+/*!
+ * \brief Whether CPU workers and CPU memory are bound to the NUMA node of their context.
+ */
+inline bool NumaBindingEnabled() {
+  static const bool enabled = dmlc::GetEnv("MXNET_CPU_NUMA_BINDING", false);
+  return enabled;
+}
+
+/*!
+ * \brief Index in NumaNodes() of the NUMA node of a CPU context.
+ */
+inline int NumaNodeOfContext(const Context& ctx) {
+  return ctx.dev_id % static_cast<int>(NumaNodes().size());
+}
+
+/*!
+ * \brief Restrict the calling thread, and the threads it creates later, to the CPUs of a node.
+ * \param node index of the node in NumaNodes().
+ */
+inline void BindCurrentThreadToNumaNode(int node) {
+#if defined(__linux__)
+  const std::vector<int>& cpus = NumaNodes().at(node).cpus;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) CPU_SET(cpu, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    LOG(WARNING) << "Failed to bind thread to NUMA node " << node;
+  }
+#endif  // defined(__linux__)
+}
+
+/*!
+ * \brief Prefer a node for the pages of a memory range that are not faulted in yet.
+ *  Only the pages entirely within the range are affected.
+ * \param node id of the node, as in NumaNode::id.
+ */
+inline void BindMemoryToNumaNode(void* ptr, size_t size, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  if (node >= static_cast<int>(sizeof(unsigned long) * 8) - 1) return;  // NOLINT(runtime/int)
+  const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + page - 1) & ~(page - 1);
+  const uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(page - 1);
+  if (end <= begin) return;
+  unsigned long mask = 1UL << node;  // NOLINT(runtime/int)
+  // best effort, the memory stays usable if the policy cannot be set
+  syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+#endif  // defined(__linux__) && defined(SYS_mbind)
+}
+
+}  // namespace common
+}  // namespace mxnet
+#endif  // MXNET_COMMON_NUMA_H_
@@ -95,6 +95,8 @@ Engine *CreateNaiveEngine();
 Engine *CreateThreadedEnginePooled();
 /*! \return ThreadedEnginePerDevie instance */
 Engine *CreateThreadedEnginePerDevice();
+/*! \return ThreadedEnginePerDevice instance whose CPU workers steal work */
+Engine *CreateThreadedEngineWorkStealing();
 #endif
 }  // namespace engine
 }  // namespace mxnet
@@ -74,6 +74,13 @@ class OpenMP {
    */
   void on_start_worker_thread(bool use_omp);
 
+  /*!
+   * \brief Call at the beginning of a worker thread bound to a subset of the cores, instead
+   *        of on_start_worker_thread.  Limits omp regions created by this thread to that subset
+   * \param num_procs Number of logical cores the thread is bound to
+   */
+  void on_start_bound_worker_thread(int num_procs);
+
   /*!
    * \brief Get the OpenMP object's singleton pointer
    * \return Singleton OpenMP object pointer
@@ -49,12 +49,20 @@ ThreadedVar::ThreadedVar(VersionedVarBlock* head) : head_{head} {
 }
 
 inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
+  // fast path: no pending write, start the read without taking the lock
+  int state = read_state_.load();
+  while ((state & kWriteBit) == 0) {
+    if (read_state_.compare_exchange_weak(state, state + 1)) {
+      opr_block->decr_wait();
+      return;
+    }
+  }
   std::lock_guard<std::mutex> lock{mutex_};
   if (pending_write_ == nullptr) {
     // invariant: is_ready_to_read()
-    CHECK_GE(num_pending_reads_, 0);
+    // the pending write completed meanwhile, kWriteBit cannot be set under us.
     // STATE CHANGE
-    ++num_pending_reads_;
+    ++read_state_;
     // decrease wait counter
     opr_block->decr_wait();
   } else {
@@ -85,35 +93,31 @@ inline void ThreadedVar::AppendWriteDependency(OprBlock* opr_block) {
   if (pending_write_ == nullptr) {
     // invariant: is_ready_to_read()
     pending_write_ = head_;
-    CHECK_GE(num_pending_reads_, 0);
-    if (num_pending_reads_ == 0) {
-      // STATE CHANGE
+    // STATE CHANGE: stop new reads, running reads will trigger the write
+    const int state = read_state_.fetch_or(kWriteBit);
+    CHECK_GE(state, 0);
+    if (state == 0) {
       opr_block->decr_wait();
-      num_pending_reads_ = kWriteTriggered;
     }
-  } else {
-    CHECK_NE(num_pending_reads_, 0);
   }
   head_ = new_var_block;
 }
 
 template <typename Dispatcher>
 inline void ThreadedVar::CompleteReadDependency(Dispatcher dispatcher) {
+  const int state = --read_state_;
+  CHECK_GE(state & ~kWriteBit, 0);
+  if (state != kWriteBit) return;
+  // last running read before a pending write, trigger the write
   OprBlock *trigger = nullptr;
   {
     // this is lock scope
     std::lock_guard<std::mutex> lock{mutex_};
-    CHECK_GT(num_pending_reads_, 0);
-
-    if (--num_pending_reads_ == 0) {
-      if (pending_write_ != nullptr) {
-        // STATE CHANGE
-        trigger = pending_write_->trigger;
-        num_pending_reads_ = kWriteTriggered;
-      }
-    }
+    assert(pending_write_ != nullptr);
+    // STATE CHANGE
+    trigger = pending_write_->trigger;
   }
-  if (trigger != nullptr && trigger->decr_wait() == 0) {
+  if (trigger->decr_wait() == 0) {
     dispatcher(trigger);
   }
 }
@@ -128,7 +132,7 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
     // invariants
     assert(head_->next == nullptr);
     assert(pending_write_ != nullptr);
-    CHECK_EQ(num_pending_reads_, kWriteTriggered);
+    CHECK_EQ(read_state_.load(), kWriteBit);
 
     // really delete
     if (to_delete_) {
@@ -142,28 +146,29 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
     old_pending_write = pending_write_;
     // search for chains to trigger
     end_of_read_chain = old_pending_write->next;
-    // reset to 0 pending reads
-    num_pending_reads_ = 0;
+    // count the reads to trigger
+    int num_pending_reads = 0;
     while (end_of_read_chain != head_ &&
            end_of_read_chain->write == false) {
-      ++num_pending_reads_;
+      ++num_pending_reads;
       end_of_read_chain = end_of_read_chain->next;
     }
     if (end_of_read_chain == head_) {
       pending_write_ = nullptr;
+      // no read can start while kWriteBit is set, so a plain store is safe.
+      read_state_.store(num_pending_reads);
     } else {
       // check if there is pending reads, if not trigger write
       assert(end_of_read_chain->write == true);
       pending_write_ = end_of_read_chain;
-      if (num_pending_reads_ == 0) {
-        // mark write as already activated in this var
-        num_pending_reads_ = kWriteTriggered;
+      read_state_.store(kWriteBit | num_pending_reads);
+      if (num_pending_reads == 0) {
         trigger_write = end_of_read_chain->trigger;
       }
     }
   }
   // This is outside of lock scope
-  // Be very carful, pending_write_ and num_pending_reads_
+  // Be very carful, pending_write_ and read_state_
   // can change now, do not reply ont the two variables.
   // The linked list \in [old_pending_write, end_of_read_chain)
   // is already detached from this Var.
@@ -192,7 +197,6 @@ inline void ThreadedVar::SetToDelete() {
 }
 
 inline bool ThreadedVar::ready_to_read() {
-  std::lock_guard<std::mutex> lock{mutex_};
   return this->is_ready_to_read();
 }
 
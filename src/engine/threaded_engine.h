@@ -179,15 +179,20 @@ class ThreadedVar final
   std::shared_ptr<std::exception_ptr> var_exception;
 
  private:
-  // TODO(hotpxl) change this to spinlock for faster runtime
   // TODO(hotpxl) consider rename head
-  /*! \brief inetrnal mutex of the ThreadedVar */
+  /*!
+   * \brief inetrnal mutex of the ThreadedVar.
+   *  Guards the linked list and pending_write_. Reads that can run right away
+   *  and read completions only touch read_state_ and do not take the mutex.
+   */
   std::mutex mutex_;
   /*!
-   * \brief number of pending reads operation in the variable.
-   *  will be marked as -1 when there is a already triggered pending write.
+   * \brief number of running read operations in the low bits, and kWriteBit
+   *  when there is a pending write. The bit is only changed with mutex_ held.
+   *  Once the bit is set no more reads start, and the pending write is
+   *  triggered by whoever brings the number of running reads to zero.
    */
-  int num_pending_reads_{0};
+  std::atomic<int> read_state_{0};
   /*!
    * \brief Points to the last VersionedVarBlock in the queue.
    *  head_ always points to a empty VersionedVarBlock.
@@ -207,14 +212,14 @@ class ThreadedVar final
    * \brief If true, delete after operation completes.
    */
   bool to_delete_{false};
-  /*! \brief special const on num_pending_reads_ to mark write being triggered */
-  static constexpr int kWriteTriggered = -1;
+  /*! \brief bit of read_state_ marking a pending write */
+  static constexpr int kWriteBit = 1 << 30;
   /*!
    * \brief derived invariant of ready to ready, without lock.
    * \return whether the current variable is ready to read.
    */
   inline bool is_ready_to_read() const {
-    return pending_write_ == nullptr;
+    return (read_state_.load() & kWriteBit) == 0;
   }
 };  // struct ThreadedVar
 
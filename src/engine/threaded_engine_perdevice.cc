@@ -30,7 +30,9 @@
 #include <dmlc/thread_group.h>
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
+#include "./work_stealing_queue.h"
 #include "../common/lazy_alloc_array.h"
+#include "../common/numa.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -42,6 +44,9 @@ namespace engine {
  *  - Use fixed amount of threads for each device.
  *  - Use special threads for copy operations.
  *  - Each stream is allocated and bound to each of the thread.
+ *  - Optionally, CPU workers of a device share a work stealing queue
+ *    instead of a single blocking queue.
+ *  - Optionally, CPU workers of cpu(i) are bound to NUMA node i.
  */
 class ThreadedEnginePerDevice : public ThreadedEngine {
  public:
@@ -51,7 +56,8 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   static auto constexpr kPriorityQueue = kPriority;
   static auto constexpr kWorkerQueue = kFIFO;
 
-  ThreadedEnginePerDevice() noexcept(false) {
+  explicit ThreadedEnginePerDevice(bool cpu_work_stealing = false) noexcept(false)
+      : cpu_work_stealing_(cpu_work_stealing) {
     this->Start();
 #ifndef _WIN32
     pthread_atfork(
@@ -79,6 +85,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     gpu_normal_workers_.Clear();
     gpu_copy_workers_.Clear();
     cpu_normal_workers_.Clear();
+    cpu_stealing_workers_.Clear();
     cpu_priority_worker_.reset(nullptr);
   }
 
@@ -98,7 +105,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     cpu_priority_worker_->pool.reset(new ThreadPool(
         cpu_priority_nthreads,
         [this](std::shared_ptr<dmlc::ManualEvent> ready_event) {
-          this->CPUWorker(Context(), cpu_priority_worker_.get(), ready_event);
+          this->CPUWorker(Context(), cpu_priority_worker_.get(), false, ready_event);
         }, true));
     // GPU tasks will be created lazily
   }
@@ -118,6 +125,21 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
       if (ctx.dev_mask() == Context::kCPU) {
         if (opr_block->opr->prop == FnProperty::kCPUPrioritized) {
           cpu_priority_worker_->task_queue.Push(opr_block, opr_block->priority);
+        } else if (cpu_work_stealing_) {
+          int dev_id = ctx.dev_id;
+          int nthread = cpu_worker_nthreads_;
+          auto ptr =
+          cpu_stealing_workers_.Get(dev_id, [this, ctx, nthread]() {
+              auto blk = new StealingWorkerBlock(nthread);
+              blk->pool.reset(new ThreadPool(nthread,
+                  [this, ctx, blk](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+                    this->CPUStealingWorker(ctx, blk, ready_event);
+                  }, true));
+            return blk;
+          });
+          if (ptr) {
+            ptr->task_queue.Push(opr_block);
+          }
         } else {
           int dev_id = ctx.dev_id;
           int nthread = cpu_worker_nthreads_;
@@ -126,7 +148,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
               auto blk = new ThreadWorkerBlock<kWorkerQueue>();
               blk->pool.reset(new ThreadPool(nthread,
                   [this, ctx, blk](std::shared_ptr<dmlc::ManualEvent> ready_event) {
-                    this->CPUWorker(ctx, blk, ready_event);
+                    this->CPUWorker(ctx, blk, true, ready_event);
                   }, true));
             return blk;
           });
@@ -203,15 +225,32 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     // destructor
     ~ThreadWorkerBlock() noexcept(false) {}
   };
+  // working unit of cpu workers that steal tasks from each other.
+  struct StealingWorkerBlock {
+    // task queue on this task
+    WorkStealingQueue<OprBlock*> task_queue;
+    // number of workers that have started, used to assign their indices
+    std::atomic<size_t> num_started{0};
+    // thread pool that works on this task
+    std::unique_ptr<ThreadPool> pool;
+    // constructor
+    explicit StealingWorkerBlock(size_t nthread) : task_queue(nthread) {}
+    // destructor
+    ~StealingWorkerBlock() noexcept(false) {}
+  };
 
   /*! \brief whether this is a worker thread. */
   static MX_THREAD_LOCAL bool is_worker_;
+  /*! \brief whether cpu workers use work stealing */
+  bool cpu_work_stealing_;
   /*! \brief number of concurrent thread cpu worker uses */
   size_t cpu_worker_nthreads_;
   /*! \brief number of concurrent thread each gpu worker uses */
   size_t gpu_worker_nthreads_;
   // cpu worker
   common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > cpu_normal_workers_;
+  // cpu worker with work stealing
+  common::LazyAllocArray<StealingWorkerBlock> cpu_stealing_workers_;
   // cpu priority worker
   std::unique_ptr<ThreadWorkerBlock<kPriorityQueue> > cpu_priority_worker_;
   // workers doing normal works on GPU
@@ -264,10 +303,12 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   /*!
    * \brief CPU worker that performs operations on CPU.
    * \param block The task block of the worker.
+   * \param bind_numa whether the worker may be bound to the NUMA node of ctx.
    */
   template<dmlc::ConcurrentQueueType type>
   inline void CPUWorker(Context ctx,
                         ThreadWorkerBlock<type> *block,
+                        bool bind_numa,
                         const std::shared_ptr<dmlc::ManualEvent>& ready_event) {
     this->is_worker_ = true;
     auto* task_queue = &(block->task_queue);
@@ -277,14 +318,51 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     OprBlock* opr_block;
     ready_event->signal();
 
-    // Set default number of threads for OMP parallel regions initiated by this thread
-    OpenMP::Get()->on_start_worker_thread(true);
+    StartCPUWorkerThread(ctx, bind_numa);
 
     while (task_queue->Pop(&opr_block)) {
       this->ExecuteOprBlock(run_ctx, opr_block);
     }
   }
 
+  /*!
+   * \brief Set the default number of threads for OMP parallel regions initiated by
+   *  a CPU worker thread, binding it to the NUMA node of its context if enabled.
+   *  OMP threads created later by the worker inherit its binding.
+   */
+  inline void StartCPUWorkerThread(Context ctx, bool bind_numa) {
+    if (bind_numa && common::NumaBindingEnabled()) {
+      const int node = common::NumaNodeOfContext(ctx);
+      common::BindCurrentThreadToNumaNode(node);
+      OpenMP::Get()->on_start_bound_worker_thread(
+          static_cast<int>(common::NumaNodes()[node].cpus.size()));
+    } else {
+      OpenMP::Get()->on_start_worker_thread(true);
+    }
+  }
+  /*!
+   * \brief CPU worker that steals tasks from the other workers of its block.
+   * \param block The task block of the worker.
+   */
+  inline void CPUStealingWorker(Context ctx,
+                                StealingWorkerBlock *block,
+                                const std::shared_ptr<dmlc::ManualEvent>& ready_event) {
+    this->is_worker_ = true;
+    auto* task_queue = &(block->task_queue);
+    const size_t index = block->num_started++;
+    RunContext run_ctx{ctx, nullptr};
+
+    // execute task
+    OprBlock* opr_block;
+    ready_event->signal();
+
+    StartCPUWorkerThread(ctx, true);
+
+    while (task_queue->Pop(index, &opr_block)) {
+      this->ExecuteOprBlock(run_ctx, opr_block);
+    }
+  }
+
   /*!
    * \brief Get number of cores this engine should reserve for its own use
    * \param using_gpu Whether there is GPU usage
@@ -319,6 +397,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     SignalQueueForKill(&gpu_normal_workers_);
     SignalQueueForKill(&gpu_copy_workers_);
     SignalQueueForKill(&cpu_normal_workers_);
+    SignalQueueForKill(&cpu_stealing_workers_);
     if (cpu_priority_worker_) {
       cpu_priority_worker_->task_queue.SignalForKill();
     }
@@ -329,6 +408,10 @@ Engine *CreateThreadedEnginePerDevice() {
   return new ThreadedEnginePerDevice();
 }
 
+Engine *CreateThreadedEngineWorkStealing() {
+  return new ThreadedEnginePerDevice(true);
+}
+
 MX_THREAD_LOCAL bool ThreadedEnginePerDevice::is_worker_ = false;
 
 }  // namespace engine
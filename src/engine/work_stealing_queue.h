@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file work_stealing_queue.h
+ * \brief Task queue of a group of workers with work stealing.
+ */
+#ifndef MXNET_ENGINE_WORK_STEALING_QUEUE_H_
+#define MXNET_ENGINE_WORK_STEALING_QUEUE_H_
+
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mxnet {
+namespace engine {
+
+/*!
+ * \brief Task queue shared by a fixed number of worker threads.
+ *  Every worker owns a deque. Tasks pushed by a worker go to its own deque and
+ *  are popped in LIFO order, which keeps the inputs of a just finished task hot
+ *  in cache. Tasks pushed by other threads are spread round-robin. A worker whose
+ *  deque is empty steals the oldest task of a randomly chosen victim, and sleeps
+ *  only when all deques are empty.
+ *
+ * \tparam T type of the task.
+ */
+template<typename T>
+class WorkStealingQueue {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param num_workers number of workers popping from the queue.
+   */
+  explicit WorkStealingQueue(size_t num_workers) {
+    CHECK_GT(num_workers, 0);
+    for (size_t i = 0; i < num_workers; ++i) {
+      deques_.emplace_back(new WorkerDeque());
+    }
+  }
+  /*!
+   * \brief Push a task. Workers of this queue push to their own deque.
+   * \param item the task.
+   */
+  void Push(T item) {
+    const WorkerSlot& slot = CurrentWorker();
+    size_t index = slot.queue == this ? slot.index
+                                      : next_deque_.fetch_add(1) % deques_.size();
+    {
+      std::lock_guard<std::mutex> lock(deques_[index]->mutex);
+      deques_[index]->tasks.push_back(item);
+    }
+    ++num_pending_;
+    if (num_sleeping_.load() > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv_.notify_one();
+    }
+  }
+  /*!
+   * \brief Pop a task, blocking until one is available.
+   * \param worker index of the calling worker, in [0, num_workers).
+   * \param item output of the task.
+   * \return false if the queue was signaled for kill.
+   */
+  bool Pop(size_t worker, T* item) {
+    CHECK_LT(worker, deques_.size());
+    WorkerSlot& slot = CurrentWorker();
+    slot.queue = this;
+    slot.index = worker;
+    while (!exit_.load()) {
+      if (PopLocal(worker, item) || Steal(worker, item)) {
+        --num_pending_;
+        return true;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++num_sleeping_;
+      cv_.wait(lock, [this]() {
+        return num_pending_.load() > 0 || exit_.load();
+      });
+      --num_sleeping_;
+    }
+    return false;
+  }
+  /*!
+   * \brief Wake up all the workers and make Pop return false.
+   */
+  void SignalForKill() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_.store(true);
+    }
+    cv_.notify_all();
+  }
+  /*! \return number of workers of the queue. */
+  size_t num_workers() const {
+    return deques_.size();
+  }
+
+ private:
+  /*! \brief tasks of a single worker */
+  struct WorkerDeque {
+    std::mutex mutex;
+    std::deque<T> tasks;
+  };
+  /*! \brief the queue and worker index of the calling thread */
+  struct WorkerSlot {
+    const void* queue;
+    size_t index;
+  };
+
+  static WorkerSlot& CurrentWorker() {
+    static MX_THREAD_LOCAL WorkerSlot slot = {nullptr, 0};
+    return slot;
+  }
+
+  bool PopLocal(size_t worker, T* item) {
+    WorkerDeque* deque = deques_[worker].get();
+    std::lock_guard<std::mutex> lock(deque->mutex);
+    if (deque->tasks.empty()) return false;
+    *item = deque->tasks.back();
+    deque->tasks.pop_back();
+    return true;
+  }
+
+  bool Steal(size_t worker, T* item) {
+    const size_t num_deques = deques_.size();
+    if (num_deques == 1) return false;
+    static MX_THREAD_LOCAL unsigned seed = 0;
+    if (seed == 0) seed = static_cast<unsigned>(worker + 1) * 2654435761U;
+    seed = seed * 1103515245U + 12345U;
+    const size_t start = seed % num_deques;
+    for (size_t i = 0; i < num_deques; ++i) {
+      const size_t victim = (start + i) % num_deques;
+      if (victim == worker) continue;
+      WorkerDeque* deque = deques_[victim].get();
+      std::lock_guard<std::mutex> lock(deque->mutex);
+      if (deque->tasks.empty()) continue;
+      *item = deque->tasks.front();
+      deque->tasks.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+  /*! \brief deques of the workers */
+  std::vector<std::unique_ptr<WorkerDeque>> deques_;
+  /*! \brief deque receiving the next task pushed from outside the workers */
+  std::atomic<size_t> next_deque_{0};
+  /*! \brief number of tasks in all deques */
+  std::atomic<int> num_pending_{0};
+  /*! \brief number of workers waiting for tasks */
+  std::atomic<int> num_sleeping_{0};
+  /*! \brief whether the workers should exit */
+  std::atomic<bool> exit_{false};
+  /*! \brief mutex and condition variable for sleeping workers */
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingQueue);
+};
+
+}  // namespace engine
+}  // namespace mxnet
+
+#endif  // MXNET_ENGINE_WORK_STEALING_QUEUE_H_
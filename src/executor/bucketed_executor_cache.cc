@@ -0,0 +1,114 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file bucketed_executor_cache.cc
+ * \brief Cache of executors of one symbol, bound for different input shapes.
+ */
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include "./bucketed_executor_cache.h"
+
+namespace mxnet {
+namespace exec {
+
+BucketedExecutorCache::BucketedExecutorCache(
+    nnvm::Symbol symbol,
+    const Context& default_ctx,
+    const std::map<std::string, Context>& group2ctx,
+    const std::vector<Context>& in_arg_ctxes,
+    const std::vector<Context>& arg_grad_ctxes,
+    const std::vector<Context>& aux_state_ctxes,
+    const std::unordered_map<std::string, int>& arg_dtype_map,
+    const std::unordered_map<std::string, int>& arg_stype_map,
+    const std::vector<OpReqType>& grad_req_types,
+    const std::unordered_set<std::string>& param_names,
+    size_t capacity)
+  : symbol_(symbol), default_ctx_(default_ctx), group2ctx_(group2ctx),
+    in_arg_ctxes_(in_arg_ctxes), arg_grad_ctxes_(arg_grad_ctxes),
+    aux_state_ctxes_(aux_state_ctxes), arg_dtype_map_(arg_dtype_map),
+    arg_stype_map_(arg_stype_map), grad_req_types_(grad_req_types),
+    param_names_(param_names), capacity_(capacity) {
+  CHECK_GT(capacity_, 0U) << "BucketedExecutorCache needs room for at least one executor";
+}
+
+std::string BucketedExecutorCache::SignatureKey(
+    const std::unordered_map<std::string, TShape>& arg_shape_map) {
+  std::vector<std::pair<std::string, TShape> > sorted(arg_shape_map.begin(),
+                                                      arg_shape_map.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<std::string, TShape>& lhs,
+               const std::pair<std::string, TShape>& rhs) {
+              return lhs.first < rhs.first;
+            });
+  std::ostringstream os;
+  for (const auto& kv : sorted) os << kv.first << kv.second << ';';
+  return os.str();
+}
+
+std::shared_ptr<Executor> BucketedExecutorCache::Bind(
+    const std::unordered_map<std::string, TShape>& arg_shape_map) {
+  std::vector<NDArray> in_args, arg_grads, aux_states;
+  Executor* exec = Executor::SimpleBind(symbol_, default_ctx_, group2ctx_,
+                                        in_arg_ctxes_, arg_grad_ctxes_, aux_state_ctxes_,
+                                        arg_shape_map, arg_dtype_map_, arg_stype_map_,
+                                        grad_req_types_, param_names_,
+                                        &in_args, &arg_grads, &aux_states,
+                                        &shared_buffer_, root_.get());
+  return std::shared_ptr<Executor>(exec);
+}
+
+std::shared_ptr<Executor> BucketedExecutorCache::Get(
+    const std::unordered_map<std::string, TShape>& arg_shape_map) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::string key = SignatureKey(arg_shape_map);
+  auto it = buckets_.find(key);
+  if (it != buckets_.end()) {
+    ++hits_;
+    if (it->second.exec != root_) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+    }
+    return it->second.exec;
+  }
+
+  ++misses_;
+  std::shared_ptr<Executor> exec = Bind(arg_shape_map);
+  Bucket bucket;
+  bucket.exec = exec;
+  if (root_ == nullptr) {
+    root_ = exec;
+  } else {
+    lru_.push_front(key);
+    bucket.lru_pos = lru_.begin();
+  }
+  buckets_.emplace(key, std::move(bucket));
+
+  while (buckets_.size() > capacity_ && !lru_.empty()) {
+    // memory of the evicted executor stays in the pool of the root for later buckets
+    buckets_.erase(lru_.back());
+    lru_.pop_back();
+    ++evictions_;
+  }
+  return exec;
+}
+
+}  // namespace exec
+}  // namespace mxnet
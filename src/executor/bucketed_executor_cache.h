@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file bucketed_executor_cache.h
+ * \brief Cache of executors of one symbol, bound for different input shapes.
+ */
+#ifndef MXNET_EXECUTOR_BUCKETED_EXECUTOR_CACHE_H_
+#define MXNET_EXECUTOR_BUCKETED_EXECUTOR_CACHE_H_
+
+#include <mxnet/base.h>
+#include <mxnet/executor.h>
+#include <mxnet/ndarray.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief Executors of one symbol, simple bound once per input shape signature.
+ *
+ *  The executor of the first signature is the root of the cache. All the other
+ *  executors are bound with the root as shared_exec and with a common shared
+ *  buffer, so they share the parameters, the data arrays and the data entry
+ *  pool of the root instead of holding activation memory of their own. Binding
+ *  the largest shapes first lets the later buckets fit in that pool.
+ *
+ *  The root is never evicted. The other buckets are evicted in least recently
+ *  used order once the cache holds more than capacity executors.
+ */
+class BucketedExecutorCache {
+ public:
+  /*!
+   * \brief Constructor. The arguments are those of Executor::SimpleBind.
+   * \param capacity maximum number of cached executors, including the root.
+   */
+  BucketedExecutorCache(nnvm::Symbol symbol,
+                        const Context& default_ctx,
+                        const std::map<std::string, Context>& group2ctx,
+                        const std::vector<Context>& in_arg_ctxes,
+                        const std::vector<Context>& arg_grad_ctxes,
+                        const std::vector<Context>& aux_state_ctxes,
+                        const std::unordered_map<std::string, int>& arg_dtype_map,
+                        const std::unordered_map<std::string, int>& arg_stype_map,
+                        const std::vector<OpReqType>& grad_req_types,
+                        const std::unordered_set<std::string>& param_names,
+                        size_t capacity);
+  /*!
+   * \brief Get the executor bound for the given input shapes, binding it on a miss.
+   *  The inputs are fed through the in_arg_map of the returned executor.
+   * \param arg_shape_map shapes of the inputs, as given to SimpleBind.
+   */
+  std::shared_ptr<Executor> Get(const std::unordered_map<std::string, TShape>& arg_shape_map);
+  /*! \return number of calls to Get served by a cached executor */
+  size_t hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+  }
+  /*! \return number of calls to Get which bound a new executor */
+  size_t misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+  /*! \return number of executors evicted from the cache */
+  size_t evictions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return evictions_;
+  }
+  /*! \return number of cached executors */
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buckets_.size();
+  }
+
+ private:
+  /*! \brief a cached executor */
+  struct Bucket {
+    std::shared_ptr<Executor> exec;
+    /*! \brief position in lru_, unused for the root */
+    std::list<std::string>::iterator lru_pos;
+  };
+  /*! \brief key of a shape signature, independent of the map iteration order */
+  static std::string SignatureKey(const std::unordered_map<std::string, TShape>& arg_shape_map);
+  std::shared_ptr<Executor> Bind(const std::unordered_map<std::string, TShape>& arg_shape_map);
+
+  nnvm::Symbol symbol_;
+  Context default_ctx_;
+  std::map<std::string, Context> group2ctx_;
+  std::vector<Context> in_arg_ctxes_;
+  std::vector<Context> arg_grad_ctxes_;
+  std::vector<Context> aux_state_ctxes_;
+  std::unordered_map<std::string, int> arg_dtype_map_;
+  std::unordered_map<std::string, int> arg_stype_map_;
+  std::vector<OpReqType> grad_req_types_;
+  std::unordered_set<std::string> param_names_;
+  size_t capacity_;
+  /*! \brief data arrays shared by all the executors */
+  std::unordered_map<std::string, NDArray> shared_buffer_;
+  /*! \brief executor of the first signature, owning the shared data entry pool */
+  std::shared_ptr<Executor> root_;
+  std::unordered_map<std::string, Bucket> buckets_;
+  /*! \brief keys of the buckets other than the root, most recently used first */
+  std::list<std::string> lru_;
+  size_t hits_{0};
+  size_t misses_{0};
+  size_t evictions_{0};
+  mutable std::mutex mutex_;
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_EXECUTOR_BUCKETED_EXECUTOR_CACHE_H_
@@ -0,0 +1,175 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file bulk_segment_cost.h
+ * \brief Operator cost profile and the cut points of bulk execution segments.
+ */
+#ifndef MXNET_EXECUTOR_BULK_SEGMENT_COST_H_
+#define MXNET_EXECUTOR_BULK_SEGMENT_COST_H_
+
+#include <dmlc/logging.h>
+#include <nnvm/graph.h>
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief Parse the average run time in microseconds of each operator from the
+ *  "operator" table of the aggregate statistics dumped by the profiler.
+ *  Entries of one operator with different attributes are merged.
+ */
+inline std::unordered_map<std::string, double> ParseOpCostProfile(std::istream& is) {
+  // total time in ms and count of each operator
+  std::unordered_map<std::string, std::pair<double, double> > totals;
+  std::string line;
+  bool in_table = false;
+  while (std::getline(is, line)) {
+    if (!in_table) {
+      in_table = line == "operator";
+      continue;
+    }
+    if (line.empty()) break;
+    std::istringstream ls(line);
+    std::vector<std::string> tokens;
+    for (std::string token; ls >> token;) tokens.push_back(token);
+    // name, count, total, min, max and average time
+    if (tokens.size() < 6 || tokens[0] == "Name" || tokens[0][0] == '-' ||
+        tokens[0][0] == '=') {
+      continue;
+    }
+    std::string name = tokens[0];
+    for (size_t i = 1; i + 5 < tokens.size(); ++i) name += " " + tokens[i];
+    for (const char* attrs : {"in: [", "out: [", " ("}) {
+      name = name.substr(0, name.find(attrs));
+    }
+    const size_t n = tokens.size();
+    auto& total = totals[name];
+    total.first += std::stod(tokens[n - 4]);
+    total.second += std::stod(tokens[n - 5]);
+  }
+  std::unordered_map<std::string, double> ret;
+  for (const auto& kv : totals) {
+    if (kv.second.second > 0) ret[kv.first] = kv.second.first * 1000 / kv.second.second;
+  }
+  return ret;
+}
+
+/*!
+ * \brief Operator cost profile stored in a file, loaded once per path.
+ */
+inline const std::unordered_map<std::string, double>& OpCostProfile(const std::string& path) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::unordered_map<std::string, double> > profiles;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = profiles.find(path);
+  if (it == profiles.end()) {
+    std::ifstream is(path);
+    CHECK(is) << "Cannot open the operator cost profile " << path;
+    it = profiles.emplace(path, ParseOpCostProfile(is)).first;
+    LOG_IF(WARNING, it->second.empty())
+        << "No operator statistics in the operator cost profile " << path;
+  }
+  return it->second;
+}
+
+/*!
+ * \brief Decides where bulk execution segments end.
+ *  Without a cost profile a segment ends after a fixed number of nodes.
+ *  With a profile, a segment ends when its estimated run time would exceed a
+ *  budget, or before a node which does not depend on the segment once the
+ *  segment is long enough to be worth running in parallel to that branch.
+ */
+class BulkSegmentCutter {
+ public:
+  /*!
+   * \param idx the graph.
+   * \param max_nodes maximum number of nodes of a segment without a profile.
+   * \param profile average run time of the operators, or nullptr.
+   * \param budget maximum estimated run time of a segment in microseconds.
+   * \param default_cost run time of the operators missing from the profile.
+   */
+  BulkSegmentCutter(const nnvm::IndexedGraph& idx, size_t max_nodes,
+                    const std::unordered_map<std::string, double>* profile,
+                    double budget, double default_cost)
+    : idx_(idx), max_nodes_(max_nodes), budget_(budget) {
+    if (profile == nullptr) return;
+    cost_.resize(idx.num_nodes(), 0);
+    for (size_t nid = 0; nid < idx.num_nodes(); ++nid) {
+      const nnvm::Node* node = idx[nid].source;
+      if (node->is_variable()) continue;
+      auto it = profile->find(node->op()->name);
+      cost_[nid] = it != profile->end() ? it->second : default_cost;
+    }
+  }
+  /*!
+   * \brief Whether the segment starting at topo_start has to end before node nid.
+   *  Accounts nid to the segment otherwise.
+   */
+  bool CutBefore(size_t topo_start, size_t nid) {
+    if (cost_.empty()) return nid - topo_start > max_nodes_;
+    if (topo_start != segment_start_) {
+      segment_start_ = topo_start;
+      segment_cost_ = 0;
+    }
+    if (segment_cost_ > 0) {
+      if (segment_cost_ + cost_[nid] > budget_) return true;
+      if (segment_cost_ >= budget_ * kParallelFraction && !DependsOn(nid, topo_start)) {
+        return true;
+      }
+    }
+    segment_cost_ += cost_[nid];
+    return false;
+  }
+  /*! \brief fraction of the budget from which a segment runs next to an independent branch */
+  static constexpr double kParallelFraction = 0.25;
+
+ private:
+  bool DependsOn(size_t nid, size_t topo_start) const {
+    for (const auto& e : idx_[nid].inputs) {
+      if (e.node_id >= topo_start && e.node_id < nid &&
+          !idx_[e.node_id].source->is_variable()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const nnvm::IndexedGraph& idx_;
+  size_t max_nodes_;
+  double budget_;
+  /*! \brief estimated run time of each node, empty without a profile */
+  std::vector<double> cost_;
+  size_t segment_start_{0};
+  double segment_cost_{0};
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_EXECUTOR_BULK_SEGMENT_COST_H_
@@ -0,0 +1,202 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file elemwise_fusion_pass.cc
+ * \brief Pass fusing chains of elementwise operators into single nodes.
+ */
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "./exec_pass.h"
+#include "../operator/tensor/elemwise_fused_op.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+
+/*! \brief name of the operator of node in the program of a fused node, empty if not fusible */
+std::string FusedOpName(const nnvm::Node& node) {
+  static const nnvm::Op* activation = nnvm::Op::Get("Activation");
+  static const std::unordered_map<std::string, std::string> broadcast = {
+    {"broadcast_add", "elemwise_add"},
+    {"broadcast_sub", "elemwise_sub"},
+    {"broadcast_mul", "elemwise_mul"},
+    {"broadcast_div", "elemwise_div"},
+    {"broadcast_maximum", "_maximum"},
+    {"broadcast_minimum", "_minimum"},
+  };
+  if (node.is_variable()) return "";
+  std::string name = node.op()->name;
+  if (node.op() == activation) {
+    auto it = node.attrs.dict.find("act_type");
+    if (it == node.attrs.dict.end()) return "";
+    name = it->second;
+  } else if (broadcast.count(name)) {
+    name = broadcast.at(name);
+  }
+  const auto& ops = op::FusedElemwiseOps();
+  auto it = ops.find(name);
+  if (it == ops.end()) return "";
+  if (it->second.has_scalar && !node.attrs.dict.count("scalar")) return "";
+  return name;
+}
+
+}  // namespace
+
+Graph FuseElemwise(Graph&& g) {
+  using nnvm::IndexedGraph;
+  const IndexedGraph& idx = g.indexed_graph();
+  const auto& shapes = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& dtypes = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const uint32_t num_nodes = idx.num_nodes();
+
+  // number of readers of each entry, graph outputs count as readers
+  std::vector<uint32_t> entry_refs(idx.num_node_entries(), 0);
+  std::vector<bool> control_dep(num_nodes, false);
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    for (const auto& e : idx[nid].inputs) ++entry_refs[idx.entry_id(e)];
+    for (uint32_t dep : idx[nid].control_deps) control_dep[dep] = true;
+  }
+  for (const auto& e : idx.outputs()) ++entry_refs[idx.entry_id(e)];
+
+  std::vector<std::string> names(num_nodes);
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    if (node->is_variable() || node->num_outputs() != 1 || !idx[nid].control_deps.empty() ||
+        control_dep[nid]) {
+      continue;
+    }
+    const uint32_t eid = idx.entry_id(nid, 0);
+    if (dtypes[eid] != mshadow::kFloat32 && dtypes[eid] != mshadow::kFloat64) continue;
+    bool same = true;
+    for (const auto& e : idx[nid].inputs) {
+      same = same && shapes[idx.entry_id(e)] == shapes[eid] &&
+             dtypes[idx.entry_id(e)] == dtypes[eid];
+    }
+    if (same) names[nid] = FusedOpName(*node);
+  }
+
+  // grow groups from their last node towards the inputs
+  std::vector<int> group(num_nodes, -1);
+  std::vector<std::vector<uint32_t> > groups;
+  for (uint32_t root = num_nodes; root-- > 0;) {
+    if (names[root].empty() || group[root] != -1) continue;
+    const int gid = static_cast<int>(groups.size());
+    std::vector<uint32_t> members = {root}, stack = {root};
+    group[root] = gid;
+    while (!stack.empty()) {
+      const uint32_t nid = stack.back();
+      stack.pop_back();
+      for (const auto& e : idx[nid].inputs) {
+        const uint32_t src = e.node_id;
+        if (members.size() >= static_cast<size_t>(op::fused_elemwise::kMaxSteps)) break;
+        if (names[src].empty() || group[src] != -1 || entry_refs[idx.entry_id(e)] != 1 ||
+            shapes[idx.entry_id(e)] != shapes[idx.entry_id(root, 0)] ||
+            dtypes[idx.entry_id(e)] != dtypes[idx.entry_id(root, 0)]) {
+          continue;
+        }
+        group[src] = gid;
+        members.push_back(src);
+        stack.push_back(src);
+      }
+    }
+    std::sort(members.begin(), members.end());
+    groups.push_back(std::move(members));
+  }
+  size_t num_fused = 0;
+  for (const auto& members : groups) num_fused += members.size() > 1;
+  if (num_fused == 0) return std::move(g);
+
+  std::vector<nnvm::NodePtr> new_nodes(num_nodes);
+  auto new_entry = [&](const IndexedGraph::NodeEntry& e) {
+    CHECK(new_nodes[e.node_id] != nullptr);
+    return nnvm::NodeEntry{new_nodes[e.node_id], e.index, e.version};
+  };
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    if (node->is_variable()) {
+      new_nodes[nid] = idx[nid].weak_ref.lock();
+      continue;
+    }
+    const int gid = group[nid];
+    const bool fused = gid != -1 && groups[gid].size() > 1;
+    if (fused && groups[gid].back() != nid) continue;
+    nnvm::NodePtr n = nnvm::Node::Create();
+    if (!fused) {
+      n->attrs = node->attrs;
+      for (const auto& e : idx[nid].inputs) n->inputs.push_back(new_entry(e));
+      for (uint32_t dep : idx[nid].control_deps) n->control_deps.push_back(new_nodes[dep]);
+      new_nodes[nid] = n;
+      continue;
+    }
+    // inputs in the order of a depth first search from the root, like the unfused graph
+    const std::vector<uint32_t>& members = groups[gid];
+    std::vector<IndexedGraph::NodeEntry> inputs;
+    std::vector<uint32_t> input_eids;
+    std::function<void(uint32_t)> visit = [&](uint32_t m) {
+      for (const auto& e : idx[m].inputs) {
+        if (group[e.node_id] == gid) {
+          visit(e.node_id);
+        } else if (std::find(input_eids.begin(), input_eids.end(), idx.entry_id(e)) ==
+                   input_eids.end()) {
+          inputs.push_back(e);
+          input_eids.push_back(idx.entry_id(e));
+        }
+      }
+    };
+    visit(nid);
+    auto reg = [&](const IndexedGraph::NodeEntry& e) -> size_t {
+      if (group[e.node_id] == gid) {
+        return inputs.size() + (std::lower_bound(members.begin(), members.end(), e.node_id) -
+                                members.begin());
+      }
+      return std::find(input_eids.begin(), input_eids.end(), idx.entry_id(e)) -
+             input_eids.begin();
+    };
+    std::ostringstream program;
+    for (uint32_t m : members) {
+      if (m != members.front()) program << ';';
+      program << names[m];
+      for (const auto& e : idx[m].inputs) program << ' ' << reg(e);
+      if (op::FusedElemwiseOps().at(names[m]).has_scalar) {
+        program << ' ' << idx[m].source->attrs.dict.at("scalar");
+      }
+    }
+    n->attrs.op = nnvm::Op::Get("_FusedElemwise");
+    n->attrs.name = node->attrs.name;
+    n->attrs.dict["num_inputs"] = std::to_string(inputs.size());
+    n->attrs.dict["program"] = program.str();
+    n->attrs.op->attr_parser(&(n->attrs));
+    for (const auto& e : inputs) n->inputs.push_back(new_entry(e));
+    new_nodes[nid] = n;
+  }
+
+  Graph ret;
+  for (const auto& e : idx.outputs()) ret.outputs.push_back(new_entry(e));
+  return ret;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -178,6 +178,16 @@ Graph InferStorageType(Graph&& graph,
                        StorageTypeVector&& storage_type_inputs = StorageTypeVector(),
                        const std::string& storage_type_attr_key = "");
 
+/*!
+ * \brief Fuse chains of elementwise operators of a CPU graph into _FusedElemwise nodes,
+ *  which make a single pass over memory. An intermediate result is fused into its
+ *  consumer only if nothing else reads it. The order of the graph inputs is kept.
+ * \param graph The input graph, with the "shape" and "dtype" attributes.
+ * \return The graph with fused nodes and without attributes, or the input graph
+ *         if there is nothing to fuse.
+ */
+Graph FuseElemwise(Graph&& graph);
+
 }  // namespace exec
 }  // namespace mxnet
 
@@ -27,9 +27,12 @@
 #include <nnvm/pass_functions.h>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <functional>
 
 #include "./exec_pass.h"
 #include "./graph_executor.h"
+#include "./bulk_segment_cost.h"
 #include "../profiler/profiler.h"
 #include "../common/utils.h"
 
@@ -256,6 +259,8 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
 
   nnvm::Graph g;
   g.outputs = symbol.outputs;
+  head_grad_entry_.clear();
+  head_grad_map_.clear();
   bool need_grad = false;
   for (OpReqType req : grad_req_types) {
     if (req != kNullOp) need_grad = true;
@@ -275,10 +280,11 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
   }
 
   int do_mirror = dmlc::GetEnv("MXNET_BACKWARD_DO_MIRROR", 0);
-  auto need_mirror = [do_mirror](const nnvm::Node& node) -> int {
+  auto need_mirror = [do_mirror, this](const nnvm::Node& node) -> int {
     if (node.is_variable()) return 0;
     const std::string& type = node.attrs.op->name;
     if (type == "Dropout") return false;
+    if (mirror_nodes_.count(&node)) return true;
     if (get_node_attr(node, "__force_mirroring__", false)) return true;
     if (do_mirror == 0) return false;
     if (type == "Convolution") return false;
@@ -306,6 +312,144 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
   return g;
 }
 
+/*!
+ * \brief Bytes of the data entry pool that InitDataEntryMemory would allocate
+ *  for a graph with inferred shapes and types. Inputs and gradient outputs are
+ *  allocated outside of the pool.
+ */
+static size_t PlannedPoolBytes(Graph g, size_t num_forward_outputs) {
+  const auto& idx = g.indexed_graph();
+  nnvm::StorageVector storage(idx.num_node_entries(), kBadStorageID);
+  for (const auto nid : idx.input_nodes()) storage[idx.entry_id(nid, 0)] = kExternalStorageID;
+  for (size_t i = num_forward_outputs; i < idx.outputs().size(); ++i) {
+    storage[idx.entry_id(idx.outputs()[i])] = kExternalStorageID;
+  }
+  g.attrs["storage"] = std::make_shared<dmlc::any>(std::move(storage));
+  g = nnvm::ApplyPass(g, "PlanMemory");
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const auto& vstorage = g.GetAttr<nnvm::StorageVector>("storage_id");
+  std::vector<size_t> pool;
+  for (size_t i = 0; i < vstorage.size(); ++i) {
+    if (vstorage[i] < 0) continue;
+    const size_t sid = static_cast<size_t>(vstorage[i]);
+    if (sid >= pool.size()) pool.resize(sid + 1, 0);
+    pool[sid] = std::max(pool[sid], vshape[i].Size() * mshadow::mshadow_sizeof(vdtype[i]));
+  }
+  size_t bytes = 0;
+  for (size_t b : pool) bytes += b;
+  return bytes;
+}
+
+/*!
+ * \brief Whether recomputing the node in backward gives the same result
+ *  and leaves the state of the graph unchanged.
+ */
+static bool CanRematerialize(const nnvm::Node& node) {
+  static auto& fmutate = nnvm::Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+  static auto& fresource = nnvm::Op::GetAttr<FResourceRequest>("FResourceRequest");
+  if (node.is_variable()) return false;
+  const std::string& type = node.op()->name;
+  if (type == "Dropout" || type == "SoftmaxOutput") return false;
+  if (fmutate.count(node.op())) return false;
+  if (fresource.count(node.op())) {
+    for (const auto& req : fresource[node.op()](node.attrs)) {
+      if (req.type == ResourceRequest::kRandom ||
+          req.type == ResourceRequest::kParallelRandom) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+Graph GraphExecutor::FitMemoryBudget(
+    Graph g, size_t budget,
+    const std::unordered_map<std::string, TShape>& arg_shape_map,
+    const std::unordered_map<std::string, int>& arg_dtype_map,
+    const std::function<Graph()>& init_graph) {
+  static const std::unordered_set<std::string> expensive_ops = {
+    "Convolution", "Deconvolution", "FullyConnected", "RNN", "dot", "batch_dot"};
+  // infer shapes and types of a graph from the argument maps, false if unknown
+  auto infer = [&](Graph* pg) {
+    const auto& idx = pg->indexed_graph();
+    nnvm::ShapeVector arg_shapes(idx.input_nodes().size(), TShape());
+    nnvm::DTypeVector arg_dtypes(idx.input_nodes().size(), -1);
+    for (size_t i = 0; i < num_forward_inputs_; ++i) {
+      const std::string& name = idx[idx.input_nodes()[i]].source->attrs.name;
+      auto it1 = arg_shape_map.find(name);
+      if (it1 != arg_shape_map.end()) arg_shapes[i] = it1->second;
+      auto it2 = arg_dtype_map.find(name);
+      if (it2 != arg_dtype_map.end()) arg_dtypes[i] = it2->second;
+    }
+    *pg = InferShape(std::move(*pg), std::move(arg_shapes), "__shape__");
+    if (pg->GetAttr<size_t>("shape_num_unknown_nodes") != 0U) return false;
+    *pg = InferType(std::move(*pg), std::move(arg_dtypes), "__dtype__");
+    return pg->GetAttr<size_t>("dtype_num_unknown_nodes") == 0U;
+  };
+
+  Graph baseline = g;
+  if (!infer(&baseline)) return g;
+  const size_t baseline_bytes = PlannedPoolBytes(baseline, num_forward_outputs_);
+  if (baseline_bytes <= budget) return g;
+
+  // Candidates to recompute, cheap operators first, larger activations first.
+  // Activations of the outputs are kept anyway and gain nothing.
+  const auto& idx = baseline.indexed_graph();
+  const auto& vshape = baseline.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vdtype = baseline.GetAttr<nnvm::DTypeVector>("dtype");
+  std::unordered_set<uint32_t> output_nodes;
+  for (size_t i = 0; i < num_forward_outputs_; ++i) output_nodes.insert(idx.outputs()[i].node_id);
+  std::vector<std::pair<std::pair<bool, size_t>, const nnvm::Node*> > candidates;
+  for (size_t nid = 0; nid < num_forward_nodes_; ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    if (!CanRematerialize(*node) || output_nodes.count(nid)) continue;
+    size_t bytes = 0;
+    for (uint32_t j = 0; j < node->num_outputs(); ++j) {
+      const uint32_t eid = idx.entry_id(nid, j);
+      bytes += vshape[eid].Size() * mshadow::mshadow_sizeof(vdtype[eid]);
+    }
+    candidates.emplace_back(std::make_pair(expensive_ops.count(node->op()->name) > 0, bytes),
+                            node);
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const std::pair<std::pair<bool, size_t>, const nnvm::Node*>& lhs,
+                      const std::pair<std::pair<bool, size_t>, const nnvm::Node*>& rhs) {
+                     if (lhs.first.first != rhs.first.first) return rhs.first.first;
+                     return lhs.first.second > rhs.first.second;
+                   });
+
+  // the smallest prefix of the candidates meeting the budget, by binary search
+  auto plan = [&](size_t num_mirrored, size_t* bytes) {
+    mirror_nodes_.clear();
+    for (size_t i = 0; i < num_mirrored; ++i) mirror_nodes_.insert(candidates[i].second);
+    Graph mirrored = init_graph();
+    Graph inferred = mirrored;
+    *bytes = infer(&inferred) ? PlannedPoolBytes(inferred, num_forward_outputs_) : SIZE_MAX;
+    return mirrored;
+  };
+  size_t lo = std::min<size_t>(1, candidates.size()), hi = candidates.size(), bytes = 0;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    plan(mid, &bytes);
+    if (bytes <= budget) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  Graph ret = plan(lo, &bytes);
+  if (bytes > budget) {
+    LOG(WARNING) << "Cannot fit the backward memory budget of " << (budget >> 20) << " MB, "
+                 << "recomputing all " << candidates.size() << " candidate operators";
+  }
+  LOG(INFO) << "Rematerialization: recompute " << lo << " of " << candidates.size()
+            << " operators in backward, planned data entry memory "
+            << (bytes >> 20) << " MB, baseline " << (baseline_bytes >> 20)
+            << " MB, budget " << (budget >> 20) << " MB";
+  return ret;
+}
+
 /*!
  * \brief Assign context to the graph.
  * This is triggered by both simple_bind and bind flows.
@@ -504,6 +648,52 @@ static void HandleInferStorageTypeError(const size_t num_forward_inputs,
              << oss.str();
 }
 
+/*!
+ * \brief Fuse the chains of elementwise operators of a symbol bound for inference on CPU.
+ *  Returns the symbol itself for graphs computing gradients, graphs placed on other
+ *  devices and graphs whose shapes or types cannot be inferred from the arguments.
+ */
+static nnvm::Symbol FuseElemwiseSymbol(const nnvm::Symbol& symbol,
+                                       const Context& default_ctx,
+                                       const std::map<std::string, Context>& ctx_map,
+                                       const std::vector<OpReqType>& grad_req_types,
+                                       const std::unordered_map<std::string, TShape>& shape_map,
+                                       const std::unordered_map<std::string, int>& dtype_map) {
+  if (!dmlc::GetEnv("MXNET_CPU_ELEMWISE_FUSION", false) ||
+      default_ctx.dev_mask() != cpu::kDevMask || !ctx_map.empty()) {
+    return symbol;
+  }
+  for (OpReqType req : grad_req_types) {
+    if (req != kNullOp) return symbol;
+  }
+  nnvm::Graph g;
+  g.outputs = symbol.outputs;
+  const auto& idx = g.indexed_graph();
+  nnvm::ShapeVector arg_shapes(idx.input_nodes().size(), TShape());
+  nnvm::DTypeVector arg_dtypes(idx.input_nodes().size(), -1);
+  for (size_t i = 0; i < idx.input_nodes().size(); ++i) {
+    const std::string& name = idx[idx.input_nodes()[i]].source->attrs.name;
+    auto it1 = shape_map.find(name);
+    if (shape_map.end() != it1) arg_shapes[i] = it1->second;
+    auto it2 = dtype_map.find(name);
+    if (dtype_map.end() != it2) arg_dtypes[i] = it2->second;
+  }
+  g = InferShape(std::move(g), std::move(arg_shapes), "__shape__");
+  if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0U) return symbol;
+  g = InferType(std::move(g), std::move(arg_dtypes), "__dtype__");
+  if (g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0U) return symbol;
+  const size_t num_nodes = g.indexed_graph().num_nodes();
+  g = FuseElemwise(std::move(g));
+  if (g.indexed_graph().num_nodes() == num_nodes) return symbol;
+  nnvm::Symbol fused;
+  fused.outputs = g.outputs;
+  // arguments are bound by position
+  if (fused.ListInputNames(nnvm::Symbol::kAll) != symbol.ListInputNames(nnvm::Symbol::kAll)) {
+    return symbol;
+  }
+  return fused;
+}
+
 /*!
  * \brief GraphExecutor initializer for regular bind flow in which
  * input arguments and gradients are provided by users. This initializer
@@ -531,6 +721,24 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
   std::vector<Context> aux_state_ctxes(aux_states.size());
   std::transform(aux_states.begin(), aux_states.end(), aux_state_ctxes.begin(), get_ctx1);
 
+  if (feed_dict.empty()) {
+    std::unordered_map<std::string, TShape> arg_shape_map;
+    std::unordered_map<std::string, int> arg_dtype_map;
+    bool dense = true;
+    auto add_args = [&](const std::vector<std::string>& names, const std::vector<NDArray>& arrs) {
+      for (size_t i = 0; i < names.size() && i < arrs.size(); ++i) {
+        arg_shape_map[names[i]] = arrs[i].shape();
+        arg_dtype_map[names[i]] = arrs[i].dtype();
+        dense = dense && arrs[i].storage_type() == kDefaultStorage;
+      }
+    };
+    add_args(symbol.ListInputNames(nnvm::Symbol::kReadOnlyArgs), in_args);
+    add_args(symbol.ListInputNames(nnvm::Symbol::kAuxiliaryStates), aux_states);
+    if (dense) {
+      symbol = FuseElemwiseSymbol(symbol, default_ctx, ctx_map, grad_req_types,
+                                  arg_shape_map, arg_dtype_map);
+    }
+  }
   nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes,
                             arg_grad_ctxes, aux_state_ctxes, grad_req_types);
 
@@ -965,8 +1173,22 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                          std::unordered_map<std::string, NDArray>* shared_buffer,
                          Executor* shared_exec,
                          const nnvm::NodeEntryMap<NDArray>& feed_dict) {
+  bool dense = true;
+  for (const auto& kv : arg_stype_map) dense = dense && kv.second == kDefaultStorage;
+  if (feed_dict.empty() && dense) {
+    symbol = FuseElemwiseSymbol(symbol, default_ctx, ctx_map, grad_req_types,
+                                arg_shape_map, arg_dtype_map);
+  }
   nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes, arg_grad_ctxes,
                             aux_state_ctxes, grad_req_types);
+  const size_t memory_budget =
+      static_cast<size_t>(dmlc::GetEnv("MXNET_BACKWARD_MEMORY_BUDGET_MB", 0)) << 20;
+  if (memory_budget > 0 && num_forward_nodes_ != g.indexed_graph().num_nodes()) {
+    g = FitMemoryBudget(std::move(g), memory_budget, arg_shape_map, arg_dtype_map, [&]() {
+      return InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes, arg_grad_ctxes,
+                       aux_state_ctxes, grad_req_types);
+    });
+  }
   // The following code of shape and dtype inferences and argument
   // initialization is for simple_bind only. Regular bind operation
   // should do this differently.
@@ -1360,9 +1582,22 @@ void GraphExecutor::InitOpSegs() {
 }
 
 
+BulkSegmentCutter GraphExecutor::CreateSegmentCutter(size_t max_nodes) const {
+  const std::string profile_path = dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_COST_PROFILE",
+                                                std::string());
+  const double budget = dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_MAX_SEGMENT_COST", 1000.0);
+  // operators missing from the profile fill a segment like in training without one,
+  // for inference too
+  const size_t train_max_nodes = dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN", 15);
+  return BulkSegmentCutter(graph_.indexed_graph(), max_nodes,
+                           profile_path.empty() ? nullptr : &OpCostProfile(profile_path),
+                           budget, budget / std::max<size_t>(train_max_nodes, 1));
+}
+
 void GraphExecutor::BulkTrainingOpSegs(size_t total_num_nodes) {
   // The maximum number of node in a segment executed in bulk
   size_t num_nodes_threshold = dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN", 15);
+  BulkSegmentCutter cutter = CreateSegmentCutter(num_nodes_threshold);
 
   // create forward segments for training
   size_t topo_start = 0;
@@ -1371,7 +1606,7 @@ void GraphExecutor::BulkTrainingOpSegs(size_t total_num_nodes) {
     auto &op_node = op_nodes_[nid];
     // check if the segment relies on external input, or exceeds maxinum number of node,
     // or requires async ops
-    if (node->is_variable() || nid - topo_start > num_nodes_threshold ||
+    if (node->is_variable() || cutter.CutBefore(topo_start, nid) ||
         op_node.exec->exec_type() != ExecType::kSync) {
       // create a new segment for the previous nodes if the current one cannot be bulked
       cached_seg_opr_[topo_start] = this->CreateCachedSegOpr(topo_start, nid);
@@ -1396,7 +1631,7 @@ void GraphExecutor::BulkTrainingOpSegs(size_t total_num_nodes) {
     if (op_node.skip_exec_node || op_node.exec == nullptr) {
       continue;
     }
-    if (idx[nid].source->is_variable() || nid - topo_start > num_nodes_threshold ||
+    if (idx[nid].source->is_variable() || cutter.CutBefore(topo_start, nid) ||
         op_node.exec->exec_type() != ExecType::kSync) {
       cached_seg_opr_[topo_start] = this->CreateCachedSegOpr(topo_start, nid);
       topo_start = nid + 1;
@@ -1422,7 +1657,8 @@ void GraphExecutor::BulkTrainingOpSegs(size_t total_num_nodes) {
 
 void GraphExecutor::BulkInferenceOpSegs() {
   // Attempt to bulk the whole graph for inference.  We will only create new segments when
-  // required for non-kSync operations.
+  // required for non-kSync operations, or by the budget of the operator cost profile.
+  BulkSegmentCutter cutter = CreateSegmentCutter(num_forward_nodes_);
   size_t topo_start = 0;
   for (size_t nid = 0; nid < num_forward_nodes_; nid++) {
     auto &node = graph_.indexed_graph()[nid].source;
@@ -1431,7 +1667,7 @@ void GraphExecutor::BulkInferenceOpSegs() {
     // Variables do not need to be segmented at inference time.
     if (node->is_variable()) continue;
 
-    if (op_node.exec->exec_type() != ExecType::kSync) {
+    if (cutter.CutBefore(topo_start, nid) || op_node.exec->exec_type() != ExecType::kSync) {
       cached_seg_opr_[topo_start] = this->CreateCachedSegOpr(topo_start, nid);
       topo_start = nid + 1;
     }
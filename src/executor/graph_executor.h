@@ -33,12 +33,14 @@
 #include <nnvm/graph.h>
 #include <nnvm/op_attr_types.h>
 #include <nnvm/graph_attr_types.h>
+#include <functional>
 #include <map>
 #include <unordered_set>
 #include <string>
 #include <utility>
 #include <vector>
 #include "./exec_pass.h"
+#include "./bulk_segment_cost.h"
 
 namespace mxnet {
 
@@ -178,6 +180,12 @@ class GraphExecutor : public Executor {
   // intialize the full graph for simple bind, including gradient
   Graph InitFullGraph(nnvm::Symbol symbol,
                       const std::vector<OpReqType>& grad_req_types);
+  // choose forward nodes to recompute in backward so that the planned
+  // data entry memory of the graph fits in budget bytes
+  Graph FitMemoryBudget(Graph g, size_t budget,
+                        const std::unordered_map<std::string, TShape>& arg_shape_map,
+                        const std::unordered_map<std::string, int>& arg_dtype_map,
+                        const std::function<Graph()>& init_graph);
   // initialize the cached operator
   void InitCachedOps();
   // initialize the opr segments for bulk exec
@@ -200,6 +208,8 @@ class GraphExecutor : public Executor {
   void ExecuteMonCallback(size_t nid);
   // peform bulking and segmentation on an inference graph
   void BulkInferenceOpSegs();
+  // Segment cutter using the operator cost profile if one is configured.
+  BulkSegmentCutter CreateSegmentCutter(size_t max_nodes) const;
   // perform bulking and segmentation on a training graph
   void BulkTrainingOpSegs(size_t total_num_nodes);
 
@@ -234,6 +244,8 @@ class GraphExecutor : public Executor {
   size_t num_forward_inputs_{0};
   // number of forward nodes
   size_t num_forward_nodes_{0};
+  // forward nodes recomputed in backward to fit the memory budget
+  std::unordered_set<const nnvm::Node*> mirror_nodes_;
   // saved operator for autograd
   std::unordered_map<const nnvm::Node*, OpStatePtr> saved_states_;
   // monitor call back
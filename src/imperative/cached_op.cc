@@ -16,6 +16,7 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <algorithm>
 #include <unordered_set>
 #include <iostream>
 #include "./imperative_utils.h"
@@ -33,6 +34,8 @@ Imperative::CachedOp::CachedOp(
   static const auto _copy = Op::Get("_copy");
 
   param_.Init(kwargs);
+  CHECK(param_.static_alloc || !param_.static_shape)
+      << "CachedOp: static_shape requires static_alloc";
 
   // construct forward graph
   {
@@ -339,6 +342,161 @@ nnvm::Graph Imperative::CachedOp::GetBackwardGraph(
   return g;
 }
 
+Imperative::CachedOp::StaticState* Imperative::CachedOp::GetStaticState(
+    const Context& ctx, const std::vector<NDArray*>& inputs) {
+  using namespace nnvm;
+  using namespace imperative;
+
+  for (auto it = static_states_.begin(); it != static_states_.end(); ++it) {
+    const auto& s = *it;
+    if (s->ctx != ctx) continue;
+    bool match = true;
+    for (size_t i = 0; i < inputs.size() && match; ++i) {
+      match = inputs[i]->shape() == s->input_shapes[i] &&
+              inputs[i]->dtype() == s->input_dtypes[i] &&
+              inputs[i]->storage_type() == s->input_stypes[i];
+    }
+    if (match) {
+      std::rotate(static_states_.begin(), it, it + 1);
+      return static_states_.front().get();
+    }
+  }
+  CHECK(!param_.static_shape || static_states_.empty())
+      << "CachedOp was created with static_shape=True "
+      << "but the shape, type or context of its inputs changed";
+  // free the memory of the least recently used signatures
+  while (static_states_.size() >= param_.max_static_states) static_states_.pop_back();
+
+  std::unique_ptr<StaticState> state(new StaticState());
+  state->ctx = ctx;
+  for (const auto& i : inputs) {
+    state->input_shapes.emplace_back(i->shape());
+    state->input_dtypes.emplace_back(i->dtype());
+    state->input_stypes.emplace_back(i->storage_type());
+  }
+
+  nnvm::Graph& g = state->graph;
+  g.outputs = fwd_graph_.outputs;
+  CheckAndInferShape(&g, ShapeVector(state->input_shapes), true);
+  CheckAndInferType(&g, DTypeVector(state->input_dtypes), true);
+  exec::DevMaskVector dev_mask(g.indexed_graph().num_nodes(), ctx.dev_mask());
+  CheckAndInferStorageType(&g, std::move(dev_mask),
+                           StorageTypeVector(state->input_stypes), true);
+
+  std::vector<uint32_t> ref_count =
+      fwd_graph_.GetAttr<std::vector<uint32_t> >("forward_ref_count");
+  if (ctx.dev_mask() == cpu::kDevMask && dmlc::GetEnv("MXNET_CPU_ELEMWISE_FUSION", false) &&
+      common::ContainsOnlyStorage(state->input_stypes, kDefaultStorage)) {
+    nnvm::Graph fused = exec::FuseElemwise(nnvm::Graph(g));
+    const auto& fused_idx = fused.indexed_graph();
+    bool use_fused = fused_idx.num_nodes() != g.indexed_graph().num_nodes();
+    for (size_t i = 0; i < fused_idx.input_nodes().size() && use_fused; ++i) {
+      use_fused = fused_idx[fused_idx.input_nodes()[i]].source ==
+                    g.indexed_graph()[g.indexed_graph().input_nodes()[i]].source;
+    }
+    if (use_fused) {
+      g = std::move(fused);
+      CheckAndInferShape(&g, ShapeVector(state->input_shapes), true);
+      CheckAndInferType(&g, DTypeVector(state->input_dtypes), true);
+      exec::DevMaskVector fused_dev_mask(g.indexed_graph().num_nodes(), ctx.dev_mask());
+      CheckAndInferStorageType(&g, std::move(fused_dev_mask),
+                               StorageTypeVector(state->input_stypes), true);
+      const auto& idx = g.indexed_graph();
+      ref_count.assign(idx.num_node_entries(), 0);
+      for (const auto& i : idx.input_nodes()) ++ref_count[idx.entry_id(i, 0)];
+      for (const auto& i : idx.outputs()) ++ref_count[idx.entry_id(i)];
+      for (size_t i = 0; i < idx.num_nodes(); ++i) {
+        for (const auto& j : idx[i].inputs) ++ref_count[idx.entry_id(j)];
+      }
+    }
+  }
+
+  const auto& idx = g.indexed_graph();
+
+  // outputs are handed to the caller, so only intermediate entries are planned
+  StorageVector storage(idx.num_node_entries(), exec::kBadStorageID);
+  for (const auto i : idx.input_nodes()) storage[idx.entry_id(i, 0)] = exec::kExternalStorageID;
+  for (const auto& i : idx.outputs()) storage[idx.entry_id(i)] = exec::kExternalStorageID;
+  const auto& stypes = g.GetAttr<StorageTypeVector>("storage_type");
+  for (size_t i = 0; i < stypes.size(); i++) {
+    if (stypes[i] != kDefaultStorage) storage[i] = exec::kDynamicStorageID;
+  }
+  auto mem_plan = PlanMemory(&g, std::move(storage), ref_count);
+  g.attrs["forward_mem_plan"] = std::make_shared<dmlc::any>(std::move(mem_plan));
+
+  state->buff.resize(idx.num_node_entries());
+  state->states.resize(idx.num_nodes());
+  state->arrays.reserve(idx.num_node_entries());
+  for (auto& i : state->buff) state->arrays.push_back(&i);
+  state->array_reqs.resize(idx.num_node_entries(), kWriteTo);
+  state->ref_count.resize(idx.num_node_entries());
+  for (size_t i = 0; i < idx.num_node_entries(); ++i) {
+    if (ref_count[i] == 0) state->array_reqs[i] = kNullOp;
+    state->ref_count[i] = ref_count[i] + 1;
+  }
+
+  static_states_.insert(static_states_.begin(), std::move(state));
+  return static_states_.front().get();
+}
+
+void Imperative::CachedOp::StaticForward(
+    const std::vector<NDArray*>& inputs,
+    const std::vector<NDArray*>& outputs) {
+  using namespace nnvm;
+  using namespace imperative;
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK_EQ(inputs.size(), num_inputs())
+      << "CachedOp requires " << num_inputs() << " but got " << inputs.size();
+
+  Context default_ctx = inputs[0]->ctx();
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    CHECK_EQ(inputs[i]->ctx(), default_ctx)
+        << "CachedOp requires all inputs to live on the same context. But "
+        << "input 0 is on " << default_ctx << " while input " << i << " is on "
+        << inputs[i]->ctx();
+  }
+
+  StaticState* state = GetStaticState(default_ctx, inputs);
+  const nnvm::Graph& g = state->graph;
+  const auto& idx = g.indexed_graph();
+  std::vector<NDArray*>& arrays = state->arrays;
+
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    arrays[idx.entry_id(idx.input_nodes()[i], 0)] = inputs[i];
+  }
+  for (size_t i = 0; i < idx.outputs().size(); ++i) {
+    auto eid = idx.entry_id(idx.outputs()[i]);
+    if (!arrays[eid]->is_none()) *outputs[i] = arrays[eid]->Detach();
+    arrays[eid] = outputs[i];
+  }
+
+  // Intermediate entries are allocated on the first call of the signature
+  // and kept afterwards, only the outputs are allocated on every call.
+  const auto& mem_plan = g.GetAttr<MemoryPlanVector>("forward_mem_plan");
+  AllocateMemory(g, idx, default_ctx, 0, idx.num_node_entries(),
+                 mem_plan, arrays, &state->array_reqs);
+
+  const auto& dispatch_modes = g.GetAttr<DispatchModeVector>("dispatch_mode");
+  int prev_bulk_size = Engine::Get()->set_bulk_size(param_.forward_bulk_size);
+
+  Imperative::Get()->RunGraph(
+      false, idx, arrays, 0, idx.num_nodes(),
+      std::vector<OpReqType>(state->array_reqs),
+      std::vector<uint32_t>(state->ref_count), &state->states, dispatch_modes);
+
+  Engine::Get()->set_bulk_size(prev_bulk_size);
+
+  // unbind the arrays of the caller
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    auto eid = idx.entry_id(idx.input_nodes()[i], 0);
+    arrays[eid] = &state->buff[eid];
+  }
+  for (size_t i = 0; i < idx.outputs().size(); ++i) {
+    auto eid = idx.entry_id(idx.outputs()[i]);
+    arrays[eid] = &state->buff[eid];
+  }
+}
+
 void Imperative::CachedOp::Forward(
     const std::shared_ptr<CachedOp>& op_ptr,
     const std::vector<NDArray*>& inputs,
@@ -349,6 +507,11 @@ void Imperative::CachedOp::Forward(
 
   // Initialize
   bool recording = Imperative::Get()->is_recording();
+  // backward needs the arrays of each recorded call, which static buffers would overwrite
+  if (param_.static_alloc && !recording) {
+    StaticForward(inputs, outputs);
+    return;
+  }
   nnvm::Graph g = GetForwardGraph(recording, inputs);
   const auto& idx = g.indexed_graph();
   size_t num_inputs = idx.input_nodes().size();
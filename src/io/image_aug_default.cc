@@ -219,10 +219,7 @@ class DefaultImageAugmenter : public ImageAugmenter {
     }
 
     // normal augmentation by affine transformation.
-    if (param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
-        || param_.rotate > 0 || rotate_list_.size() > 0 || param_.max_random_scale != 1.0
-        || param_.min_random_scale != 1.0 || param_.max_aspect_ratio != 0.0f
-        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f) {
+    if (NeedAffine()) {
       std::uniform_real_distribution<float> rand_uniform(0, 1);
       // shear
       float s = rand_uniform(*prnd) * param_.max_shear_ratio * 2 - param_.max_shear_ratio;
@@ -313,7 +310,7 @@ class DefaultImageAugmenter : public ImageAugmenter {
     }
 
     // color space augmentation
-    if (param_.random_h != 0 || param_.random_s != 0 || param_.random_l != 0) {
+    if (NeedColor()) {
       std::uniform_real_distribution<float> rand_uniform(0, 1);
       cvtColor(res, res, CV_BGR2HLS);
       int h = rand_uniform(*prnd) * param_.random_h * 2 - param_.random_h;
@@ -336,7 +333,74 @@ class DefaultImageAugmenter : public ImageAugmenter {
     return res;
   }
 
+  bool PlanCrop(const cv::Mat &src, common::RANDOM_ENGINE *prnd,
+                ImageCropPlan *plan) override {
+    using mshadow::index_t;
+    const bool crop_size = param_.max_crop_size != -1 || param_.min_crop_size != -1;
+    // a crop with at most one bilinear resize, drawing as Process does
+    if (NeedAffine() || NeedColor() || param_.pad > 0 || param_.inter_method != 1
+        || (param_.resize != -1 && crop_size)) {
+      return false;
+    }
+    const int height = param_.data_shape[1];
+    const int width = param_.data_shape[2];
+    if (crop_size) {
+      CHECK(src.cols >= param_.max_crop_size && src.rows >= \
+              param_.max_crop_size && param_.max_crop_size >= param_.min_crop_size)
+          << "input image size smaller than max_crop_size";
+      index_t rand_crop_size =
+          std::uniform_int_distribution<index_t>(param_.min_crop_size, param_.max_crop_size)(*prnd);
+      index_t y = src.rows - rand_crop_size;
+      index_t x = src.cols - rand_crop_size;
+      if (param_.rand_crop != 0) {
+        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+      } else {
+        y /= 2; x /= 2;
+      }
+      const int size = rand_crop_size;
+      *plan = {static_cast<int>(y), static_cast<int>(x), size, size, height, width,
+               0, 0, height, width};
+      return true;
+    }
+    int new_height = src.rows, new_width = src.cols;
+    if (param_.resize != -1) {
+      if (src.rows > src.cols) {
+        new_height = param_.resize*src.rows/src.cols;
+        new_width = param_.resize;
+      } else {
+        new_height = param_.resize;
+        new_width = param_.resize*src.cols/src.rows;
+      }
+    }
+    CHECK(new_height >= height && new_width >= width)
+        << "input image size smaller than input shape";
+    index_t y = new_height - height;
+    index_t x = new_width - width;
+    if (param_.rand_crop != 0) {
+      y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+      x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+    } else {
+      y /= 2; x /= 2;
+    }
+    *plan = {0, 0, src.rows, src.cols, new_height, new_width,
+             static_cast<int>(y), static_cast<int>(x), height, width};
+    return true;
+  }
+
  private:
+  /*! \brief whether the image is transformed by an affine transformation */
+  bool NeedAffine() const {
+    return param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
+        || param_.rotate > 0 || rotate_list_.size() > 0 || param_.max_random_scale != 1.0
+        || param_.min_random_scale != 1.0 || param_.max_aspect_ratio != 0.0f
+        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f;
+  }
+  /*! \brief whether the colors are augmented in HSL space */
+  bool NeedColor() const {
+    return param_.random_h != 0 || param_.random_s != 0 || param_.random_l != 0;
+  }
+
   // temporal space
   cv::Mat temp_;
   // rotation param
@@ -33,6 +33,7 @@
 #include <utility> // NOLINT(*)
 #include <string> // NOLINT(*)
 
+#include "./image_fused_aug.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -59,6 +60,19 @@ class ImageAugmenter {
    */
   virtual cv::Mat Process(const cv::Mat &src, std::vector<float> *label,
                           common::RANDOM_ENGINE *prnd) = 0;
+  /*!
+   * \brief plan the augmentation of src instead of doing it, when it amounts
+   *   to a crop with a bilinear resize, so that the caller does it in one pass
+   *   with the normalization. The random numbers drawn are those of Process.
+   * \param src the source image
+   * \param prnd pointer to random number generator.
+   * \param plan the crop to do
+   * \return whether the augmentation is planned, Process is called otherwise
+   */
+  virtual bool PlanCrop(const cv::Mat &src, common::RANDOM_ENGINE *prnd,
+                        ImageCropPlan *plan) {
+    return false;
+  }
   // virtual destructor
   virtual ~ImageAugmenter() {}
   /*!
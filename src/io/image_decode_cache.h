@@ -0,0 +1,201 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file image_decode_cache.h
+ * \brief cache of decoded images, so that they are decoded once rather than every epoch
+ */
+#ifndef MXNET_IO_IMAGE_DECODE_CACHE_H_
+#define MXNET_IO_IMAGE_DECODE_CACHE_H_
+
+#include <dmlc/logging.h>
+
+#if MXNET_USE_OPENCV
+#include <opencv2/opencv.hpp>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief resizes the shorter edge of src to size, the way the resize of the
+ *  default augmenter does for the deterministic interpolation methods
+ */
+inline cv::Mat ResizeShorterEdge(const cv::Mat& src, int size, int inter_method) {
+  int new_height, new_width;
+  if (src.rows > src.cols) {
+    new_height = size * src.rows / src.cols;
+    new_width = size;
+  } else {
+    new_height = size;
+    new_width = size * src.cols / src.rows;
+  }
+  int interpolation = inter_method;
+  if (inter_method == 9) {
+    if (new_width > src.cols && new_height > src.rows) {
+      interpolation = 2;  // CV_INTER_CUBIC for enlarge
+    } else if (new_width < src.cols && new_height < src.rows) {
+      interpolation = 3;  // CV_INTER_AREA for shrink
+    } else {
+      interpolation = 1;  // CV_INTER_LINEAR for others
+    }
+  }
+  cv::Mat res;
+  cv::resize(src, res, cv::Size(new_width, new_height), 0, 0, interpolation);
+  return res;
+}
+
+/*!
+ * \brief decoded images by position of their record. The pixels are kept in segments of
+ *  memory, or of a file mapped into memory when a file is given so that the
+ *  cache may outgrow the memory. Images are only added, and are never
+ *  changed once added. Threadsafe.
+ */
+class DecodedImageCache {
+ public:
+  explicit DecodedImageCache(const std::string& file) : file_(file) {
+#if defined(_WIN32)
+    if (!file_.empty()) {
+      LOG(WARNING) << "Decoded images are cached in memory instead of " << file_;
+      file_.clear();
+    }
+#else
+    if (!file_.empty()) {
+      fd_ = open(file_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+      CHECK_NE(fd_, -1) << "Failed to create " << file_ << ": " << strerror(errno);
+    }
+#endif
+  }
+
+  ~DecodedImageCache() {
+#if !defined(_WIN32)
+    if (fd_ != -1) {
+      for (const auto& seg : segments_) munmap(seg.base, kSegmentBytes);
+      close(fd_);
+      unlink(file_.c_str());
+      return;
+    }
+#endif
+    for (const auto& seg : segments_) delete[] seg.base;
+  }
+
+  /*!
+   * \brief copies the image of a record to out
+   * \return false if the image is not cached
+   */
+  bool Get(uint64_t index, cv::Mat* out) const {
+    Entry entry;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      auto it = entries_.find(index);
+      if (it == entries_.end()) return false;
+      entry = it->second;
+    }
+    // copies, as augmenters may change their input in place
+    cv::Mat(entry.rows, entry.cols, entry.type, entry.data).copyTo(*out);
+    return true;
+  }
+
+  /*!
+   * \brief adds the image of a record, unless it is too big or already cached
+   */
+  void Put(uint64_t index, const cv::Mat& img) {
+    const cv::Mat src = img.isContinuous() ? img : img.clone();
+    const size_t bytes = src.total() * src.elemSize();
+    if (bytes > kSegmentBytes) return;
+    uint8_t* data = nullptr;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (entries_.count(index)) return;
+      data = Allocate(bytes);
+    }
+    std::memcpy(data, src.data, bytes);
+    std::lock_guard<std::mutex> lk(mu_);
+    entries_.emplace(index, Entry{data, src.rows, src.cols, src.type()});
+  }
+
+  /*! \brief number of images cached */
+  size_t size() const {
+    std::lock_guard<std::mutex> lk(mu_);
+    return entries_.size();
+  }
+
+ private:
+  static const size_t kSegmentBytes = 256UL << 20;
+
+  struct Entry {
+    uint8_t* data;
+    int rows;
+    int cols;
+    int type;
+  };
+
+  struct Segment {
+    uint8_t* base;
+    size_t used;
+  };
+
+  /*! \brief space for bytes in the last segment, or in a new one. Called under mu_ */
+  uint8_t* Allocate(size_t bytes) {
+    if (segments_.empty() || segments_.back().used + bytes > kSegmentBytes) {
+      Segment seg{nullptr, 0};
+#if !defined(_WIN32)
+      if (fd_ != -1) {
+        const off_t offset = static_cast<off_t>(segments_.size() * kSegmentBytes);
+        CHECK_EQ(ftruncate(fd_, offset + kSegmentBytes), 0)
+          << "Failed to grow " << file_ << ": " << strerror(errno);
+        void* ptr = mmap(nullptr, kSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+        CHECK_NE(ptr, MAP_FAILED) << "Failed to map " << file_ << ": " << strerror(errno);
+        seg.base = static_cast<uint8_t*>(ptr);
+      }
+#endif
+      if (seg.base == nullptr) seg.base = new uint8_t[kSegmentBytes];
+      segments_.push_back(seg);
+    }
+    Segment& seg = segments_.back();
+    uint8_t* data = seg.base + seg.used;
+    // keep the rows of the next image aligned
+    seg.used += (bytes + 63) / 64 * 64;
+    return data;
+  }
+
+  std::string file_;
+  int fd_ = -1;
+  mutable std::mutex mu_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  std::vector<Segment> segments_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_OPENCV
+#endif  // MXNET_IO_IMAGE_DECODE_CACHE_H_
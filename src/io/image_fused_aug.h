@@ -0,0 +1,203 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file image_fused_aug.h
+ * \brief crop, bilinear resize, mirror, normalization and transpose of an
+ *  image into the CHW output in one pass
+ */
+#ifndef MXNET_IO_IMAGE_FUSED_AUG_H_
+#define MXNET_IO_IMAGE_FUSED_AUG_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief augmentation amounting to a crop of a resized image: the region of
+ *  interest of the source is resized to resized_height x resized_width, and
+ *  the output is the window of height x width at (y, x) of the result
+ */
+struct ImageCropPlan {
+  int roi_y, roi_x, roi_height, roi_width;
+  int resized_height, resized_width;
+  int y, x, height, width;
+};
+
+/*!
+ * \brief normalization (v - mean) * mult + bias of each output channel
+ */
+struct ImageNormalization {
+  float mean[4];
+  float mult[4];
+  float bias[4];
+  /*! \brief mean image in the output shape, used instead of mean unless null */
+  const float* mean_img = nullptr;
+};
+
+/*!
+ * \brief writes the plan of an interleaved BGR(A) or gray image into a CHW
+ *  output of RGB(A) channels. The interpolation is separable: each source row
+ *  is interpolated horizontally once into planar rows of floats, and the
+ *  vertical interpolation and normalization of the output rows then run over
+ *  contiguous memory, which the compiler vectorizes. Keeps its buffers across
+ *  images, so an instance is used by one thread.
+ */
+class ImageCropNormalizer {
+ public:
+  /*!
+   * \brief runs the plan
+   * \param src first pixel of the source image
+   * \param src_step bytes between the rows of the source
+   * \param plan the crop and resize
+   * \param mirror whether to flip the output horizontally
+   * \param norm the normalization, ignored for uint8 outputs
+   * \param out n_channels x plan.height x plan.width output
+   */
+  template<int n_channels, typename DType>
+  void Run(const uint8_t* src, size_t src_step, const ImageCropPlan& plan, bool mirror,
+           const ImageNormalization& norm, DType* out) {
+    const int width = plan.width;
+    const int height = plan.height;
+    // the horizontal taps of the output columns, mirrored if asked
+    const float scale_x = static_cast<float>(plan.roi_width) / plan.resized_width;
+    x0_.resize(width);
+    x1_.resize(width);
+    wx_.resize(width);
+    for (int j = 0; j < width; ++j) {
+      const int col = mirror ? width - 1 - j : j;
+      int x0, x1;
+      Tap(col + plan.x, scale_x, plan.roi_width, &x0, &x1, &wx_[j]);
+      x0_[j] = (plan.roi_x + x0) * n_channels;
+      x1_[j] = (plan.roi_x + x1) * n_channels;
+    }
+    for (int s = 0; s < 2; ++s) {
+      rows_[s].resize(n_channels * width);
+      row_index_[s] = -1;
+    }
+    const float scale_y = static_cast<float>(plan.roi_height) / plan.resized_height;
+    for (int i = 0; i < height; ++i) {
+      int y0, y1;
+      float wy;
+      Tap(i + plan.y, scale_y, plan.roi_height, &y0, &y1, &wy);
+      const float* row0 = Row<n_channels>(src, src_step, plan.roi_y + y0, plan.roi_y + y1);
+      const float* row1 = Row<n_channels>(src, src_step, plan.roi_y + y1, plan.roi_y + y0);
+      for (int k = 0; k < n_channels; ++k) {
+        DType* dst = out + (static_cast<size_t>(k) * height + i) * width;
+        const float* mean_row = norm.mean_img == nullptr ? nullptr :
+                                norm.mean_img + (static_cast<size_t>(k) * height + i) * width;
+        Blend(row0 + k * width, row1 + k * width, wy, width, norm, k, mean_row, mirror, dst);
+      }
+    }
+  }
+
+ private:
+  /*!
+   * \brief source pixels and weight of the bilinear interpolation of the
+   *  destination pixel dst, the way OpenCV's INTER_LINEAR resize clamps them
+   */
+  static void Tap(int dst, float scale, int size, int* p0, int* p1, float* w) {
+    const float f = (dst + 0.5f) * scale - 0.5f;
+    int p = static_cast<int>(std::floor(f));
+    *w = f - p;
+    if (p < 0) {
+      p = 0;
+      *w = 0;
+    }
+    if (p >= size - 1) {
+      p = size - 1;
+      *w = 0;
+    }
+    *p0 = p;
+    *p1 = std::min(p + 1, size - 1);
+  }
+
+  /*!
+   * \brief the source row interpolated horizontally into planar RGB(A) rows,
+   *  kept unless the row of keep is to be kept instead
+   */
+  template<int n_channels>
+  const float* Row(const uint8_t* src, size_t src_step, int row, int keep) {
+    for (int s = 0; s < 2; ++s) {
+      if (row_index_[s] == row) return rows_[s].data();
+    }
+    const int slot = row_index_[0] == keep ? 1 : 0;
+    row_index_[slot] = row;
+    float* dst = rows_[slot].data();
+    const uint8_t* pixels = src + static_cast<size_t>(row) * src_step;
+    const int width = static_cast<int>(x0_.size());
+    for (int j = 0; j < width; ++j) {
+      const uint8_t* p0 = pixels + x0_[j];
+      const uint8_t* p1 = pixels + x1_[j];
+      const float w = wx_[j];
+      for (int k = 0; k < n_channels; ++k) {
+        // OpenCV stores BGR(A), the output is RGB(A)
+        const int c = k < 3 && n_channels > 1 ? 2 - k : k;
+        const float v0 = p0[c];
+        dst[k * width + j] = v0 + (p1[c] - v0) * w;
+      }
+    }
+    return dst;
+  }
+
+  /*! \brief vertical interpolation of a row of an output channel, normalized */
+  template<typename DType>
+  static void Blend(const float* __restrict row0, const float* __restrict row1, float wy,
+                    int width, const ImageNormalization& norm, int k,
+                    const float* __restrict mean_row, bool mirror, DType* __restrict dst) {
+    if (std::is_same<DType, uint8_t>::value) {
+      for (int j = 0; j < width; ++j) {
+        dst[j] = static_cast<DType>(static_cast<int>(row0[j] + (row1[j] - row0[j]) * wy + 0.5f));
+      }
+    } else if (mean_row != nullptr) {
+      // the mean image is subtracted before mirroring
+      const float mult = norm.mult[k], bias = norm.bias[k];
+      for (int j = 0; j < width; ++j) {
+        const float v = row0[j] + (row1[j] - row0[j]) * wy;
+        const float mean = mirror ? mean_row[width - 1 - j] : mean_row[j];
+        dst[j] = static_cast<DType>((v - mean) * mult + bias);
+      }
+    } else {
+      const float mult = norm.mult[k], bias = norm.bias[k] - norm.mean[k] * norm.mult[k];
+      for (int j = 0; j < width; ++j) {
+        const float v = row0[j] + (row1[j] - row0[j]) * wy;
+        dst[j] = static_cast<DType>(v * mult + bias);
+      }
+    }
+  }
+
+  /*! \brief byte offsets of the two source pixels of each output column */
+  std::vector<int> x0_, x1_;
+  /*! \brief weights of the second source pixel of each output column */
+  std::vector<float> wx_;
+  /*! \brief two source rows interpolated horizontally, and their indices */
+  std::vector<float> rows_[2];
+  int row_index_[2];
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_IMAGE_FUSED_AUG_H_
@@ -131,6 +131,12 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   size_t shuffle_chunk_size;
   /*! \brief the seed for chunk shuffling*/
   int shuffle_chunk_seed;
+  /*! \brief whether to cache the decoded images across epochs */
+  bool cache_decoded;
+  /*! \brief file to cache the decoded images in instead of memory */
+  std::string cache_decoded_file;
+  /*! \brief whether to crop, resize, mirror and normalize in one pass when possible */
+  bool fused_augment;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(ImageRecParserParam) {
@@ -165,6 +171,23 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
         .describe("The data shuffle buffer size in MB. Only valid if shuffle is true.");
     DMLC_DECLARE_FIELD(shuffle_chunk_seed).set_default(0)
         .describe("The random seed for shuffling");
+    DMLC_DECLARE_FIELD(cache_decoded).set_default(false)
+        .describe("Decode each image once and keep it for the next epochs. "\
+                  "If the first augmenter is the default one, the resize is done once too, "\
+                  "unless inter_method is random. The other augmentations are still random "\
+                  "in each epoch. The records must be read in the same order in every "\
+                  "epoch, so shuffle with path_imgidx and shuffle_chunk_size are not "\
+                  "supported. Only used by ImageRecordIter.");
+    DMLC_DECLARE_FIELD(cache_decoded_file).set_default("")
+        .describe("With cache_decoded, keep the decoded images in this file mapped into "\
+                  "memory instead of in memory, for datasets bigger than memory. "\
+                  "The file is removed by the iterator.");
+    DMLC_DECLARE_FIELD(fused_augment).set_default(false)
+        .describe("When the only augmenter is the default one and it crops with at most "\
+                  "one bilinear resize, crop, resize, mirror and normalize each image in "\
+                  "one pass into the batch. The resize may differ from the one of OpenCV "\
+                  "by one level of intensity, so it is off by default. "\
+                  "Only used by ImageRecordIter.");
   }
 };
 
@@ -339,6 +362,13 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
   size_t prefetch_buffer;
   /*! \brief data type */
   dmlc::optional<int> dtype;
+  /*! \brief context of the output arrays */
+  dmlc::optional<int> ctx;
+
+  /*! \brief context of the output arrays, def unless set */
+  Context OutputContext(Context def) const {
+    return ctx ? Context::Create(static_cast<Context::DeviceType>(ctx.value()), 0) : def;
+  }
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(PrefetcherParam) {
@@ -352,6 +382,14 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
       .add_enum("uint8", mshadow::kUint8)
       .set_default(dmlc::optional<int>())
       .describe("Output data type. ``None`` means no change.");
+    DMLC_DECLARE_FIELD(ctx)
+      .add_enum("cpu", Context::kCPU)
+      .add_enum("cpu_pinned", Context::kCPUPinned)
+      .add_enum("cpu_shared", Context::kCPUShared)
+      .set_default(dmlc::optional<int>())
+      .describe("Context of the output arrays, which the batches are written into. "
+                "``cpu_pinned`` speeds up copies to GPUs, ``cpu_shared`` passes batches "
+                "to other processes without copies. ``None`` means the default of the iterator.");
   }
 };
 
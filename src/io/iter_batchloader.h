@@ -71,10 +71,21 @@ class BatchLoader : public IIterator<TBlobBatch> {
     head_ = 1;
   }
 
+  /*!
+   * \brief makes the next batches be written into data instead of the buffers
+   *  of the loader, so that the caller needs not copy them. data must have the
+   *  shapes and types of the batches. An empty data goes back to the buffers
+   *  of the loader.
+   */
+  void set_output(const std::vector<TBlob>& data) {
+    output_ = data;
+  }
+
   virtual bool Next(void) {
     out_.num_batch_padd = 0;
     out_.batch_size = param_.batch_size;
     this->head_ = 0;
+    if (data_.size() != 0) this->SelectOutput();
 
     // if overflow from previous round, directly return false, until before first is called
     if (num_overflow_ != 0) return false;
@@ -85,13 +96,13 @@ class BatchLoader : public IIterator<TBlobBatch> {
       out_.inst_index[top] = d.index;
       if (data_.size() == 0) {
         this->InitData(d);
+        this->SelectOutput();
       }
       for (size_t i = 0; i < d.data.size(); ++i) {
         CHECK_EQ(unit_size_[i], d.data[i].Size());
         MSHADOW_TYPE_SWITCH(data_[i].type_flag_, DType, {
             mshadow::Copy(
-              data_[i].get<cpu, 1, DType>().Slice(top * unit_size_[i],
-                                                  (top + 1) * unit_size_[i]),
+              this->Output<DType>(i).Slice(top * unit_size_[i], (top + 1) * unit_size_[i]),
               d.data[i].get_with_shape<cpu, 1, DType>(mshadow::Shape1(unit_size_[i])));
           });
       }
@@ -112,8 +123,7 @@ class BatchLoader : public IIterator<TBlobBatch> {
             CHECK_EQ(unit_size_[i], d.data[i].Size());
             MSHADOW_TYPE_SWITCH(data_[i].type_flag_, DType, {
                 mshadow::Copy(
-                  data_[i].get<cpu, 1, DType>().Slice(top * unit_size_[i],
-                                                      (top + 1) * unit_size_[i]),
+                  this->Output<DType>(i).Slice(top * unit_size_[i], (top + 1) * unit_size_[i]),
                   d.data[i].get_with_shape<cpu, 1, DType>(mshadow::Shape1(unit_size_[i])));
               });
           }
@@ -149,6 +159,28 @@ class BatchLoader : public IIterator<TBlobBatch> {
   std::vector<TShape> shape_;
   /*! \brief unit size */
   std::vector<size_t> unit_size_;
+  /*! \brief buffers of the caller the batches are written into, if any */
+  std::vector<TBlob> output_;
+  // where the current batch is written to
+  inline void SelectOutput() {
+    if (output_.empty()) {
+      for (size_t i = 0; i < data_.size(); ++i) {
+        out_.data[i] = TBlob(data_[i].dptr_, shape_[i], cpu::kDevMask, data_[i].type_flag_, 0);
+      }
+      return;
+    }
+    CHECK_EQ(output_.size(), data_.size());
+    for (size_t i = 0; i < data_.size(); ++i) {
+      CHECK_EQ(output_[i].shape_, shape_[i]);
+      CHECK_EQ(output_[i].type_flag_, data_[i].type_flag_);
+      CHECK_EQ(output_[i].dev_mask(), cpu::kDevMask);
+      out_.data[i] = output_[i];
+    }
+  }
+  template<typename DType>
+  inline mshadow::Tensor<cpu, 1, DType> Output(size_t i) {
+    return out_.data[i].get_with_shape<cpu, 1, DType>(mshadow::Shape1(shape_[i].Size()));
+  }
   // initialize the data holder by using from the first batch.
   inline void InitData(const DataInst& first_batch) {
     shape_.resize(first_batch.data.size());
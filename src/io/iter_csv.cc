@@ -26,9 +26,11 @@
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
-#include <dmlc/data.h>
-#include "./iter_prefetcher.h"
-#include "./iter_batchloader.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./iter_text_block.h"
 
 namespace mxnet {
 namespace io {
@@ -42,6 +44,8 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
   std::string label_csv;
   /*! \brief label shape */
   TShape label_shape;
+  /*! \brief number of threads parsing the text */
+  int preprocess_threads;
   // declare parameters
   DMLC_DECLARE_PARAMETER(CSVIterParam) {
     DMLC_DECLARE_FIELD(data_csv)
@@ -54,95 +58,59 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
     index_t shape1[] = {1};
     DMLC_DECLARE_FIELD(label_shape).set_default(TShape(shape1, shape1 + 1))
         .describe("The shape of one label.");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+        .describe("The number of threads parsing the text of the files.");
   }
 };
 
-class CSVIter: public IIterator<DataInst> {
+class CSVIter: public TextBlockIter {
  public:
-  CSVIter() {
-    out_.data.resize(2);
+  CSVIter() {}
+  virtual ~CSVIter() {
+    StopPrefetch();
   }
-  virtual ~CSVIter() {}
 
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
-    data_parser_.reset(dmlc::Parser<uint32_t>::Create(param_.data_csv.c_str(), 0, 1, "csv"));
+    const int nthread = TextParseThreads(param_.preprocess_threads);
+    TextBlockReader* label_reader = nullptr;
     if (param_.label_csv != "NULL") {
-      label_parser_.reset(dmlc::Parser<uint32_t>::Create(param_.label_csv.c_str(), 0, 1, "csv"));
-    } else {
-      dummy_label.set_pad(false);
-      dummy_label.Resize(mshadow::Shape1(1));
-      dummy_label = 0.0f;
+      label_reader = new TextBlockReader(param_.label_csv, 0, 1, kCSVText, nthread);
     }
+    InitReaders(kwargs, new TextBlockReader(param_.data_csv, 0, 1, kCSVText, nthread),
+                label_reader);
   }
 
-  virtual void BeforeFirst() {
-    data_parser_->BeforeFirst();
-    if (label_parser_.get() != nullptr) {
-      label_parser_->BeforeFirst();
-    }
-    data_ptr_ = label_ptr_ = 0;
-    data_size_ = label_size_ = 0;
-    inst_counter_ = 0;
-    end_ = false;
-  }
-
-  virtual bool Next() {
-    if (end_) return false;
-    while (data_ptr_ >= data_size_) {
-      if (!data_parser_->Next()) {
-        end_ = true; return false;
+ protected:
+  virtual void WriteBatch(DataBatch* out) {
+    if (out->data.empty()) {
+      const Context ctx = prefetch_param_.OutputContext(Context::CPU());
+      out->data.emplace_back(BatchShape(param_.data_shape), ctx, false, OutputType());
+      out->data.emplace_back(BatchShape(param_.label_shape), ctx, false, OutputType());
+      // all labels are 0 without a label file
+      if (!has_label_reader()) {
+        MSHADOW_TYPE_SWITCH(OutputType(), DType, {
+          const TBlob label = out->data[1].data();
+          std::fill(label.dptr<DType>(), label.dptr<DType>() + label.Size(), DType(0));
+        });
       }
-      data_ptr_ = 0;
-      data_size_ = data_parser_->Value().size;
     }
-    out_.index = inst_counter_++;
-    CHECK_LT(data_ptr_, data_size_);
-    out_.data[0] = AsTBlob(data_parser_->Value()[data_ptr_++], param_.data_shape);
-
-    if (label_parser_.get() != nullptr) {
-      while (label_ptr_ >= label_size_) {
-        CHECK(label_parser_->Next())
-            << "Data CSV's row is smaller than the number of rows in label_csv";
-        label_ptr_ = 0;
-        label_size_ = label_parser_->Value().size;
-      }
-      CHECK_LT(label_ptr_, label_size_);
-      out_.data[1] = AsTBlob(label_parser_->Value()[label_ptr_++], param_.label_shape);
-    } else {
-      out_.data[1] = dummy_label;
+    WriteDense(data_spans_, param_.data_shape, out->data[0].data());
+    if (has_label_reader()) {
+      WriteDense(label_spans_, param_.label_shape, out->data[1].data());
     }
-    return true;
-  }
-
-  virtual const DataInst &Value(void) const {
-    return out_;
   }
 
  private:
-  inline TBlob AsTBlob(const dmlc::Row<uint32_t>& row, const TShape& shape) {
-    CHECK_EQ(row.length, shape.Size())
-        << "The data size in CSV do not match size of shape: "
-        << "specified shape=" << shape << ", the csv row-length=" << row.length;
-    const real_t* ptr = row.value;
-    return TBlob((real_t*)ptr, shape, cpu::kDevMask, 0);  // NOLINT(*)
+  /*! \brief shape of a batch of rows of shape */
+  TShape BatchShape(const TShape& shape) const {
+    std::vector<index_t> shape_vec(1, batch_param_.batch_size);
+    shape_vec.insert(shape_vec.end(), shape.begin(), shape.end());
+    return TShape(shape_vec.begin(), shape_vec.end());
   }
 
   CSVIterParam param_;
-  // output instance
-  DataInst out_;
-  // internal instance counter
-  unsigned inst_counter_{0};
-  // at end
-  bool end_{false};
-  // dummy label
-  mshadow::TensorContainer<cpu, 1, real_t> dummy_label;
-  // label parser
-  size_t label_ptr_{0}, label_size_{0};
-  size_t data_ptr_{0}, data_size_{0};
-  std::unique_ptr<dmlc::Parser<uint32_t> > label_parser_;
-  std::unique_ptr<dmlc::Parser<uint32_t> > data_parser_;
 };
 
 
@@ -225,9 +193,7 @@ Examples::
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
 .set_body([]() {
-    return new PrefetcherIter(
-        new BatchLoader(
-            new CSVIter()));
+    return new CSVIter();
   });
 
 }  // namespace io
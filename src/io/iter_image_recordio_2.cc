@@ -39,6 +39,8 @@
 #endif
 #include "./image_recordio.h"
 #include "./image_augmenter.h"
+#include "./image_decode_cache.h"
+#include "./image_fused_aug.h"
 #include "./image_iter_common.h"
 #include "./inst_vector.h"
 #include "../common/utils.h"
@@ -56,6 +58,7 @@ class ImageRecordIOParser2 {
   inline void BeforeFirst(void) {
     if (batch_param_.round_batch == 0 || !overflow) {
       n_parsed_ = 0;
+      record_pos_ = 0;
       return source_->BeforeFirst();
     } else {
       overflow = false;
@@ -71,9 +74,12 @@ class ImageRecordIOParser2 {
   void ProcessImage(const cv::Mat& res,
     mshadow::Tensor<cpu, 3, DType>* data_ptr, const bool is_mirrored, const float contrast_scaled,
     const float illumination_scaled);
+  ImageNormalization GetNormalization(const float contrast_scaled,
+                                      const float illumination_scaled) const;
 #if MXNET_USE_LIBJPEG_TURBO
   cv::Mat TJimdecode(cv::Mat buf, int color);
 #endif
+  cv::Mat DecodeImage(const ImageRecordIO& rec);
 #endif
   inline unsigned ParseChunk(DType* data_dptr, real_t* label_dptr, const unsigned current_size,
     dmlc::InputSplit::Blob * chunk);
@@ -91,7 +97,17 @@ class ImageRecordIOParser2 {
   #if MXNET_USE_OPENCV
   /*! \brief augmenters */
   std::vector<std::vector<std::unique_ptr<ImageAugmenter> > > augmenters_;
+  /*! \brief decoded images of the previous epochs, if cached */
+  std::unique_ptr<DecodedImageCache> decoded_cache_;
+  /*! \brief one pass crop and normalization of the planned augmentations */
+  std::vector<ImageCropNormalizer> fused_augs_;
   #endif
+  /*! \brief shorter edge the cached images are resized to, or -1 */
+  int cache_resize_ = -1;
+  /*! \brief interpolation method of the resize of cached images */
+  int cache_inter_method_ = 1;
+  /*! \brief position in the part of the first record of the next chunk, keying the cache */
+  uint64_t record_pos_ = 0;
   /*! \brief random samplers */
   std::vector<std::unique_ptr<common::RANDOM_ENGINE> > prnds_;
   common::RANDOM_ENGINE rnd_;
@@ -149,13 +165,33 @@ inline void ImageRecordIOParser2<DType>::Init(
   param_.preprocess_threads = threadget;
 
   std::vector<std::string> aug_names = dmlc::Split(param_.aug_seq, ',');
+  // the resize of the default augmenter, when it comes first, is done before caching
+  std::vector<std::pair<std::string, std::string> > first_kwargs = kwargs;
+  if (param_.cache_decoded) {
+    decoded_cache_.reset(new DecodedImageCache(param_.cache_decoded_file));
+    if (!aug_names.empty() && aug_names[0] == "aug_default") {
+      int resize = -1, inter_method = 1;
+      for (const auto& kv : kwargs) {
+        if (kv.first == "resize") resize = std::stoi(kv.second);
+        if (kv.first == "inter_method") inter_method = std::stoi(kv.second);
+      }
+      if (resize > 0 && inter_method != 10) {
+        cache_resize_ = resize;
+        cache_inter_method_ = inter_method;
+        for (auto& kv : first_kwargs) {
+          if (kv.first == "resize") kv.second = "-1";
+        }
+      }
+    }
+  }
   augmenters_.clear();
   augmenters_.resize(threadget);
+  fused_augs_.resize(threadget);
   // setup decoders
   for (int i = 0; i < threadget; ++i) {
-    for (const auto& aug_name : aug_names) {
-      augmenters_[i].emplace_back(ImageAugmenter::Create(aug_name));
-      augmenters_[i].back()->Init(kwargs);
+    for (size_t j = 0; j < aug_names.size(); ++j) {
+      augmenters_[i].emplace_back(ImageAugmenter::Create(aug_names[j]));
+      augmenters_[i].back()->Init(j == 0 ? first_kwargs : kwargs);
     }
     prnds_.emplace_back(new common::RANDOM_ENGINE((i + 1) * kRandMagic));
   }
@@ -180,6 +216,9 @@ inline void ImageRecordIOParser2<DType>::Init(
         record_param_.shuffle,
         record_param_.seed,
         batch_param_.batch_size));
+    CHECK(!param_.cache_decoded || !record_param_.shuffle)
+      << "cache_decoded needs the records in the same order in every epoch, "
+      << "which shuffle with path_imgidx changes";
   } else {
     source_.reset(dmlc::InputSplit::Create(
         param_.path_imgrec.c_str(), param_.part_index,
@@ -208,6 +247,9 @@ inline void ImageRecordIOParser2<DType>::Init(
             param_.num_parts, "recordio", num_shuffle_parts, param_.shuffle_chunk_seed));
       }
       source_->HintChunkSize(param_.shuffle_chunk_size << 17UL);
+      CHECK(!param_.cache_decoded || num_shuffle_parts <= 1)
+        << "cache_decoded needs the records in the same order in every epoch, "
+        << "which shuffle_chunk_size changes";
     } else {
       // use 64 MB chunk when possible
       source_->HintChunkSize(64 << 20UL);
@@ -283,10 +325,9 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
     shape_vec.push_back(param_.label_width);
     TShape label_shape(shape_vec.begin(), shape_vec.end());
 
-    out->data.at(0) = NDArray(data_shape, Context::CPUPinned(0), false,
-      mshadow::DataType<DType>::kFlag);
-    out->data.at(1) = NDArray(label_shape, Context::CPUPinned(0), false,
-      mshadow::DataType<real_t>::kFlag);
+    const Context ctx = prefetch_param_.OutputContext(Context::CPUPinned(0));
+    out->data.at(0) = NDArray(data_shape, ctx, false, mshadow::DataType<DType>::kFlag);
+    out->data.at(1) = NDArray(label_shape, ctx, false, mshadow::DataType<real_t>::kFlag);
     unit_size_[0] = param_.data_shape.Size();
     unit_size_[1] = param_.label_width;
   }
@@ -319,6 +360,7 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
         if (batch_param_.round_batch != 0) {
           overflow = true;
           source_->BeforeFirst();
+          record_pos_ = 0;
         } else {
           current_size = batch_param_.batch_size;
         }
@@ -358,26 +400,8 @@ template<int n_channels>
 void ImageRecordIOParser2<DType>::ProcessImage(const cv::Mat& res,
   mshadow::Tensor<cpu, 3, DType>* data_ptr, const bool is_mirrored, const float contrast_scaled,
   const float illumination_scaled) {
-  float RGBA_MULT[4] = { 0 };
-  float RGBA_BIAS[4] = { 0 };
-  float RGBA_MEAN[4] = { 0 };
+  const ImageNormalization norm = GetNormalization(contrast_scaled, illumination_scaled);
   mshadow::Tensor<cpu, 3, DType>& data = (*data_ptr);
-  if (!std::is_same<DType, uint8_t>::value) {
-    RGBA_MULT[0] = contrast_scaled / normalize_param_.std_r;
-    RGBA_MULT[1] = contrast_scaled / normalize_param_.std_g;
-    RGBA_MULT[2] = contrast_scaled / normalize_param_.std_b;
-    RGBA_MULT[3] = contrast_scaled / normalize_param_.std_a;
-    RGBA_BIAS[0] = illumination_scaled / normalize_param_.std_r;
-    RGBA_BIAS[1] = illumination_scaled / normalize_param_.std_g;
-    RGBA_BIAS[2] = illumination_scaled / normalize_param_.std_b;
-    RGBA_BIAS[3] = illumination_scaled / normalize_param_.std_a;
-    if (!meanfile_ready_) {
-      RGBA_MEAN[0] = normalize_param_.mean_r;
-      RGBA_MEAN[1] = normalize_param_.mean_g;
-      RGBA_MEAN[2] = normalize_param_.mean_b;
-      RGBA_MEAN[3] = normalize_param_.mean_a;
-    }
-  }
 
   int swap_indices[n_channels]; // NOLINT(*)
   if (n_channels == 1) {
@@ -405,9 +429,9 @@ void ImageRecordIOParser2<DType>::ProcessImage(const cv::Mat& res,
         // logic from iter_normalize.h, function SetOutImg
         for (int k = 0; k < n_channels; ++k) {
           if (meanfile_ready_) {
-            RGBA[k] = (RGBA[k] - meanimg_[k][i][j]) * RGBA_MULT[k] + RGBA_BIAS[k];
+            RGBA[k] = (RGBA[k] - meanimg_[k][i][j]) * norm.mult[k] + norm.bias[k];
           } else {
-            RGBA[k] = (RGBA[k] - RGBA_MEAN[k]) * RGBA_MULT[k] + RGBA_BIAS[k];
+            RGBA[k] = (RGBA[k] - norm.mean[k]) * norm.mult[k] + norm.bias[k];
           }
         }
       }
@@ -425,6 +449,24 @@ void ImageRecordIOParser2<DType>::ProcessImage(const cv::Mat& res,
   }
 }
 
+template<typename DType>
+ImageNormalization ImageRecordIOParser2<DType>::GetNormalization(
+  const float contrast_scaled, const float illumination_scaled) const {
+  ImageNormalization norm = {};
+  if (std::is_same<DType, uint8_t>::value) return norm;
+  const float stds[4] = {normalize_param_.std_r, normalize_param_.std_g,
+                         normalize_param_.std_b, normalize_param_.std_a};
+  const float means[4] = {normalize_param_.mean_r, normalize_param_.mean_g,
+                          normalize_param_.mean_b, normalize_param_.mean_a};
+  for (int k = 0; k < 4; ++k) {
+    norm.mult[k] = contrast_scaled / stds[k];
+    norm.bias[k] = illumination_scaled / stds[k];
+    norm.mean[k] = meanfile_ready_ ? 0 : means[k];
+  }
+  if (meanfile_ready_) norm.mean_img = meanimg_.dptr_;
+  return norm;
+}
+
 #if MXNET_USE_LIBJPEG_TURBO
 
 bool is_jpeg(unsigned char * file) {
@@ -473,6 +515,38 @@ cv::Mat ImageRecordIOParser2<DType>::TJimdecode(cv::Mat image, int color) {
   return ret;
 }
 #endif
+
+template<typename DType>
+cv::Mat ImageRecordIOParser2<DType>::DecodeImage(const ImageRecordIO& rec) {
+  cv::Mat res;
+  cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
+  switch (param_.data_shape[0]) {
+   case 1:
+#if MXNET_USE_LIBJPEG_TURBO
+    res = TJimdecode(buf, 0);
+#else
+    res = cv::imdecode(buf, 0);
+#endif
+    break;
+   case 3:
+#if MXNET_USE_LIBJPEG_TURBO
+    res = TJimdecode(buf, 1);
+#else
+    res = cv::imdecode(buf, 1);
+#endif
+    break;
+   case 4:
+    // -1 to keep the number of channel of the encoded image, and not force gray or color.
+    res = cv::imdecode(buf, -1);
+    CHECK_EQ(res.channels(), 4)
+      << "Invalid image with index " << rec.image_index()
+      << ". Expected 4 channels, got " << res.channels();
+    break;
+   default:
+    LOG(FATAL) << "Invalid output shape " << param_.data_shape;
+  }
+  return res;
+}
 #endif
 
 // Returns the number of images that are put into output
@@ -511,31 +585,13 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
       // Opencv decode and augments
       cv::Mat res;
       rec.Load(blob.dptr, blob.size);
-      cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
-      switch (param_.data_shape[0]) {
-       case 1:
-#if MXNET_USE_LIBJPEG_TURBO
-        res = TJimdecode(buf, 0);
-#else
-        res = cv::imdecode(buf, 0);
-#endif
-        break;
-       case 3:
-#if MXNET_USE_LIBJPEG_TURBO
-        res = TJimdecode(buf, 1);
-#else
-        res = cv::imdecode(buf, 1);
-#endif
-        break;
-       case 4:
-        // -1 to keep the number of channel of the encoded image, and not force gray or color.
-        res = cv::imdecode(buf, -1);
-        CHECK_EQ(res.channels(), 4)
-          << "Invalid image with index " << rec.image_index()
-          << ". Expected 4 channels, got " << res.channels();
-        break;
-       default:
-        LOG(FATAL) << "Invalid output shape " << param_.data_shape;
+      if (decoded_cache_ == nullptr) {
+        res = DecodeImage(rec);
+      } else if (!decoded_cache_->Get(record_pos_ + idx - current_size, &res)) {
+        // keyed by position, as the ids of the records need not be unique
+        res = DecodeImage(rec);
+        if (cache_resize_ > 0) res = ResizeShorterEdge(res, cache_resize_, cache_inter_method_);
+        decoded_cache_->Put(record_pos_ + idx - current_size, res);
       }
       const int n_channels = res.channels();
       // load label before augmentations
@@ -553,16 +609,24 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
              "or the rec file is packed with multi dimensional label";
         label_buf.assign(&rec.header.label, &rec.header.label + 1);
       }
-      for (auto& aug : augmenters_[tid]) {
-        res = aug->Process(res, &label_buf, prnds_[tid].get());
+      // a crop planned by the default augmenter is done with the normalization
+      ImageCropPlan plan;
+      const bool fused = param_.fused_augment && augmenters_[tid].size() == 1 &&
+        res.depth() == CV_8U && augmenters_[tid][0]->PlanCrop(res, prnds_[tid].get(), &plan);
+      if (!fused) {
+        for (auto& aug : augmenters_[tid]) {
+          res = aug->Process(res, &label_buf, prnds_[tid].get());
+        }
       }
+      const int out_rows = fused ? plan.height : res.rows;
+      const int out_cols = fused ? plan.width : res.cols;
       mshadow::Tensor<cpu, 3, DType> data;
       if (idx < batch_param_.batch_size) {
         data = mshadow::Tensor<cpu, 3, DType>(data_dptr + idx*unit_size_[0],
-          mshadow::Shape3(n_channels, res.rows, res.cols));
+          mshadow::Shape3(n_channels, out_rows, out_cols));
       } else {
         out_tmp.Push(static_cast<unsigned>(rec.image_index()),
-                 mshadow::Shape3(n_channels, res.rows, res.cols),
+                 mshadow::Shape3(n_channels, out_rows, out_cols),
                  mshadow::Shape1(param_.label_width));
         data = out_tmp.data().Back();
       }
@@ -583,7 +647,17 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
       }
       // For RGB or RGBA data, swap the B and R channel:
       // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
-      if (n_channels == 1) {
+      if (fused) {
+        const ImageNormalization norm = GetNormalization(contrast_scaled, illumination_scaled);
+        ImageCropNormalizer& fused_aug = fused_augs_[tid];
+        if (n_channels == 1) {
+          fused_aug.Run<1>(res.ptr<uint8_t>(), res.step, plan, is_mirrored, norm, data.dptr_);
+        } else if (n_channels == 3) {
+          fused_aug.Run<3>(res.ptr<uint8_t>(), res.step, plan, is_mirrored, norm, data.dptr_);
+        } else if (n_channels == 4) {
+          fused_aug.Run<4>(res.ptr<uint8_t>(), res.step, plan, is_mirrored, norm, data.dptr_);
+        }
+      } else if (n_channels == 1) {
         ProcessImage<1>(res, &data, is_mirrored, contrast_scaled, illumination_scaled);
       } else if (n_channels == 3) {
         ProcessImage<3>(res, &data, is_mirrored, contrast_scaled, illumination_scaled);
@@ -604,6 +678,7 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
       res.release();
     }
   }
+  record_pos_ += gl_idx - current_size;
   return (std::min(batch_param_.batch_size, gl_idx) - current_size);
 #else
   LOG(FATAL) << "Opencv is needed for image decoding and augmenting.";
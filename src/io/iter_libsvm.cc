@@ -25,9 +25,10 @@
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
-#include <dmlc/data.h>
-#include "./iter_sparse_prefetcher.h"
-#include "./iter_sparse_batchloader.h"
+#include <string>
+#include <utility>
+#include <vector>
+#include "./iter_text_block.h"
 
 namespace mxnet {
 namespace io {
@@ -45,6 +46,8 @@ struct LibSVMIterParam : public dmlc::Parameter<LibSVMIterParam> {
   int num_parts;
   /*! \brief the index of the part will read*/
   int part_index;
+  /*! \brief number of threads parsing the text */
+  int preprocess_threads;
   // declare parameters
   DMLC_DECLARE_PARAMETER(LibSVMIterParam) {
     DMLC_DECLARE_FIELD(data_libsvm)
@@ -61,13 +64,17 @@ struct LibSVMIterParam : public dmlc::Parameter<LibSVMIterParam> {
         .describe("partition the data into multiple parts");
     DMLC_DECLARE_FIELD(part_index).set_default(0)
         .describe("the index of the part will read");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+        .describe("The number of threads parsing the text of the files.");
   }
 };
 
-class LibSVMIter: public SparseIIterator<DataInst> {
+class LibSVMIter: public TextBlockIter {
  public:
   LibSVMIter() {}
-  virtual ~LibSVMIter() {}
+  virtual ~LibSVMIter() {
+    StopPrefetch();
+  }
 
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
@@ -75,123 +82,55 @@ class LibSVMIter: public SparseIIterator<DataInst> {
     CHECK_EQ(param_.data_shape.ndim(), 1) << "dimension of data_shape is expected to be 1";
     CHECK_GT(param_.num_parts, 0) << "number of parts should be positive";
     CHECK_GE(param_.part_index, 0) << "part index should be non-negative";
-    data_parser_.reset(dmlc::Parser<uint64_t>::Create(param_.data_libsvm.c_str(),
-                                                      param_.part_index,
-                                                      param_.num_parts, "libsvm"));
     if (param_.label_libsvm != "NULL") {
-      label_parser_.reset(dmlc::Parser<uint64_t>::Create(param_.label_libsvm.c_str(),
-                                                         param_.part_index,
-                                                         param_.num_parts, "libsvm"));
       CHECK_GT(param_.label_shape.Size(), 1)
         << "label_shape is not expected to be (1,) when param_.label_libsvm is set.";
     } else {
       CHECK_EQ(param_.label_shape.Size(), 1)
         << "label_shape is expected to be (1,) when param_.label_libsvm is NULL";
     }
-    // both data and label are of CSRStorage in libsvm format
-    if (param_.label_shape.Size() > 1) {
-      out_.data.resize(6);
-    } else {
-      // only data is of CSRStorage in libsvm format.
-      out_.data.resize(4);
+    BatchParam batch_param;
+    batch_param.InitAllowUnknown(kwargs);
+    if (batch_param.round_batch == 0) {
+      LOG(FATAL) << "LibSVMIter doesn't support round_batch == false yet";
     }
-  }
-
-  virtual void BeforeFirst() {
-    data_parser_->BeforeFirst();
-    if (label_parser_.get() != nullptr) {
-      label_parser_->BeforeFirst();
+    const int nthread = TextParseThreads(param_.preprocess_threads);
+    TextBlockReader* label_reader = nullptr;
+    if (param_.label_libsvm != "NULL") {
+      label_reader = new TextBlockReader(param_.label_libsvm, param_.part_index,
+                                         param_.num_parts, kLibSVMText, nthread);
     }
-    data_ptr_ = label_ptr_ = 0;
-    data_size_ = label_size_ = 0;
-    inst_counter_ = 0;
-    end_ = false;
+    InitReaders(kwargs, new TextBlockReader(param_.data_libsvm, param_.part_index,
+                                            param_.num_parts, kLibSVMText, nthread),
+                label_reader);
   }
 
-  virtual bool Next() {
-    if (end_) return false;
-    while (data_ptr_ >= data_size_) {
-      if (!data_parser_->Next()) {
-        end_ = true; return false;
+ protected:
+  virtual void WriteBatch(DataBatch* out) {
+    const index_t batch_size = batch_param_.batch_size;
+    if (out->data.empty()) {
+      const Context ctx = prefetch_param_.OutputContext(Context::CPU());
+      // both data and label are of CSRStorage if the labels are in a libsvm file
+      out->data.emplace_back(kCSRStorage, mshadow::Shape2(batch_size, param_.data_shape[0]),
+                             ctx, false, OutputType());
+      if (has_label_reader()) {
+        out->data.emplace_back(kCSRStorage,
+                               mshadow::Shape2(batch_size, param_.label_shape[0]),
+                               ctx, false, OutputType());
+      } else {
+        out->data.emplace_back(mshadow::Shape1(batch_size), ctx, false, OutputType());
       }
-      data_ptr_ = 0;
-      data_size_ = data_parser_->Value().size;
     }
-    out_.index = inst_counter_++;
-    CHECK_LT(data_ptr_, data_size_);
-    const auto data_row = data_parser_->Value()[data_ptr_++];
-    // data, indices and indptr
-    out_.data[0] = AsDataBlob(data_row);
-    out_.data[1] = AsIdxBlob(data_row);
-    out_.data[2] = AsIndPtrPlaceholder(data_row);
-
-    if (label_parser_.get() != nullptr) {
-      while (label_ptr_ >= label_size_) {
-        CHECK(label_parser_->Next())
-            << "Data LibSVM's row is smaller than the number of rows in label_libsvm";
-        label_ptr_ = 0;
-        label_size_ = label_parser_->Value().size;
-      }
-      CHECK_LT(label_ptr_, label_size_);
-      const auto label_row = label_parser_->Value()[label_ptr_++];
-      // data, indices and indptr
-      out_.data[3] = AsDataBlob(label_row);
-      out_.data[4] = AsIdxBlob(label_row);
-      out_.data[5] = AsIndPtrPlaceholder(label_row);
+    WriteCSR(data_spans_, &out->data[0]);
+    if (has_label_reader()) {
+      WriteCSR(label_spans_, &out->data[1]);
     } else {
-      out_.data[3] = AsScalarLabelBlob(data_row);
+      WriteLabels(data_spans_, out->data[1].data());
     }
-    return true;
-  }
-
-  virtual const DataInst &Value(void) const {
-    return out_;
-  }
-
-  virtual const NDArrayStorageType GetStorageType(bool is_data) const {
-    if (is_data) return kCSRStorage;
-    return param_.label_shape.Size() > 1 ? kCSRStorage : kDefaultStorage;
-  }
-
-  virtual const TShape GetShape(bool is_data) const {
-    if (is_data) return param_.data_shape;
-    return param_.label_shape;
   }
 
  private:
-  inline TBlob AsDataBlob(const dmlc::Row<uint64_t>& row) {
-    const real_t* ptr = row.value;
-    TShape shape(mshadow::Shape1(row.length));
-    return TBlob((real_t*) ptr, shape, cpu::kDevMask);  // NOLINT(*)
-  }
-
-  inline TBlob AsIdxBlob(const dmlc::Row<uint64_t>& row) {
-    const uint64_t* ptr = row.index;
-    TShape shape(mshadow::Shape1(row.length));
-    return TBlob((int64_t*) ptr, shape, cpu::kDevMask, mshadow::kInt64);  // NOLINT(*)
-  }
-
-  inline TBlob AsIndPtrPlaceholder(const dmlc::Row<uint64_t>& row) {
-    return TBlob(nullptr, mshadow::Shape1(0), cpu::kDevMask, mshadow::kInt64);
-  }
-
-  inline TBlob AsScalarLabelBlob(const dmlc::Row<uint64_t>& row) {
-    const real_t* ptr = row.label;
-    return TBlob((real_t*) ptr, mshadow::Shape1(1), cpu::kDevMask);  // NOLINT(*)
-  }
-
   LibSVMIterParam param_;
-  // output instance
-  DataInst out_;
-  // internal instance counter
-  unsigned inst_counter_{0};
-  // at end
-  bool end_{false};
-  // label parser
-  size_t label_ptr_{0}, label_size_{0};
-  size_t data_ptr_{0}, data_size_{0};
-  std::unique_ptr<dmlc::Parser<uint64_t> > label_parser_;
-  std::unique_ptr<dmlc::Parser<uint64_t> > data_parser_;
 };
 
 
@@ -300,9 +239,7 @@ Example::
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
 .set_body([]() {
-    return new SparsePrefetcherIter(
-        new SparseBatchLoader(
-            new LibSVMIter()));
+    return new LibSVMIter();
   });
 
 }  // namespace io
@@ -39,6 +39,7 @@
 #include <queue>
 #include <algorithm>
 #include "./inst_vector.h"
+#include "./iter_batchloader.h"
 #include "./image_iter_common.h"
 
 namespace mxnet {
@@ -47,7 +48,9 @@ namespace io {
 class PrefetcherIter : public IIterator<DataBatch> {
  public:
   explicit PrefetcherIter(IIterator<TBlobBatch>* base)
-      : loader_(base), out_(nullptr) {}
+      : loader_(base), out_(nullptr) {
+    batch_loader_ = dynamic_cast<BatchLoader*>(base);
+  }
 
   ~PrefetcherIter() {
     while (recycle_queue_.size() != 0) {
@@ -74,33 +77,39 @@ class PrefetcherIter : public IIterator<DataBatch> {
     // use the kwarg to init batch loader
     loader_->Init(kwargs);
     iter.Init([this](DataBatch **dptr) {
+        // once the shapes are known, a batch loader writes into the arrays directly
+        if (*dptr == nullptr && !shapes_.empty()) *dptr = NewBatch();
+        if (batch_loader_ != nullptr) {
+          std::vector<TBlob> output;
+          if (*dptr != nullptr && direct_) {
+            for (const NDArray& arr : (*dptr)->data) output.push_back(arr.data());
+          }
+          batch_loader_->set_output(output);
+        }
         if (!loader_->Next()) return false;
         const TBlobBatch& batch = loader_->Value();
         if (*dptr == nullptr) {
-          // allocate databatch
-          *dptr = new DataBatch();
-          (*dptr)->num_batch_padd = batch.num_batch_padd;
-          (*dptr)->data.resize(batch.data.size());
-          (*dptr)->index.resize(batch.batch_size);
+          direct_ = true;
+          batch_size_ = batch.batch_size;
           for (size_t i = 0; i < batch.data.size(); ++i) {
-            auto dtype = param_.dtype
-                             ? param_.dtype.value()
-                             : batch.data[i].type_flag_;
-            (*dptr)->data.at(i) = NDArray(batch.data[i].shape_,
-                                          Context::CPU(), false,
-                                          dtype);
+            shapes_.push_back(batch.data[i].shape_);
+            dtypes_.push_back(param_.dtype ? param_.dtype.value() : batch.data[i].type_flag_);
+            direct_ = direct_ && dtypes_.back() == batch.data[i].type_flag_;
           }
+          *dptr = NewBatch();
         }
         CHECK(batch.data.size() == (*dptr)->data.size());
-        // copy data over
+        // copy data over, unless it was written in place
         for (size_t i = 0; i < batch.data.size(); ++i) {
           CHECK_EQ((*dptr)->data.at(i).shape(), batch.data[i].shape_);
-          MSHADOW_TYPE_SWITCH(batch.data[i].type_flag_, DType, {
-              mshadow::Copy(((*dptr)->data)[i].data().FlatTo2D<cpu, DType>(),
-                        batch.data[i].FlatTo2D<cpu, DType>());
-          });
-          (*dptr)->num_batch_padd = batch.num_batch_padd;
+          const TBlob dst = (*dptr)->data[i].data();
+          if (dst.dptr_ != batch.data[i].dptr_) {
+            MSHADOW_TYPE_SWITCH(batch.data[i].type_flag_, DType, {
+                mshadow::Copy(dst.FlatTo2D<cpu, DType>(), batch.data[i].FlatTo2D<cpu, DType>());
+            });
+          }
         }
+        (*dptr)->num_batch_padd = batch.num_batch_padd;
         if (batch.inst_index) {
           std::copy(batch.inst_index,
                     batch.inst_index + batch.batch_size,
@@ -144,6 +153,26 @@ class PrefetcherIter : public IIterator<DataBatch> {
   std::unique_ptr<IIterator<TBlobBatch> > loader_;
 
  private:
+  DataBatch* NewBatch() const {
+    DataBatch* batch = new DataBatch();
+    batch->index.resize(batch_size_);
+    for (size_t i = 0; i < shapes_.size(); ++i) {
+      batch->data.emplace_back(shapes_[i], param_.OutputContext(Context::CPU()), false,
+                               dtypes_[i]);
+    }
+    return batch;
+  }
+
+  /*! \brief loader_, if it is a batch loader which can write into the output arrays */
+  BatchLoader* batch_loader_;
+  /*! \brief whether the batch loader writes into the output arrays */
+  bool direct_ = false;
+  /*! \brief batch size of the output arrays */
+  index_t batch_size_ = 0;
+  /*! \brief shapes of the output arrays */
+  std::vector<TShape> shapes_;
+  /*! \brief types of the output arrays */
+  std::vector<int> dtypes_;
   /*! \brief output data */
   DataBatch *out_;
   /*! \brief queue to be recycled */
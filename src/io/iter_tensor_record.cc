@@ -0,0 +1,250 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file iter_tensor_record.cc
+ * \brief iterator on the tensor record files, mapped into memory
+ */
+#include <mxnet/io.h>
+#include <mxnet/base.h>
+#include <mxnet/ndarray.h>
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <dmlc/parameter.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./image_iter_common.h"
+#include "./tensor_record.h"
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace io {
+
+struct TensorRecordParam : public dmlc::Parameter<TensorRecordParam> {
+  /*! \brief path to tensor record file */
+  std::string path_tensorrec;
+  /*! \brief whether to shuffle the records */
+  bool shuffle;
+  /*! \brief random seed of the shuffle */
+  int seed;
+  /*! \brief partition the data into multiple parts */
+  int num_parts;
+  /*! \brief the index of the part will read*/
+  int part_index;
+  /*! \brief number of threads gathering shuffled records */
+  int preprocess_threads;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(TensorRecordParam) {
+    DMLC_DECLARE_FIELD(path_tensorrec)
+        .describe("Path to the tensor record file, created with tools/tensor2rec.");
+    DMLC_DECLARE_FIELD(shuffle).set_default(false)
+        .describe("Whether to shuffle the records in each epoch.");
+    DMLC_DECLARE_FIELD(seed).set_default(0)
+        .describe("The random seed of the shuffle.");
+    DMLC_DECLARE_FIELD(num_parts).set_default(1)
+        .describe("Virtually partition the data into these many parts.");
+    DMLC_DECLARE_FIELD(part_index).set_default(0)
+        .describe("The *i*-th virtual partition to be read.");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+        .describe("The number of threads to gather shuffled records.");
+  }
+};
+
+/*!
+ * \brief serves batches of a tensor record file mapped into memory. The records
+ *  of a batch are copied from the mapping into arrays owned by the iterator, so
+ *  that the batches may be changed in place and outlive the iterator.
+ */
+class TensorRecordIter : public IIterator<DataBatch> {
+ public:
+  TensorRecordIter() {}
+
+  virtual ~TensorRecordIter() {
+#if !defined(_WIN32)
+    if (base_ != nullptr) munmap(base_, size_);
+#endif
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    batch_param_.InitAllowUnknown(kwargs);
+    Map(param_.path_tensorrec);
+    CHECK(param_.num_parts > 0 && param_.part_index >= 0 && param_.part_index < param_.num_parts);
+    const uint64_t begin = header_.num_records * param_.part_index / param_.num_parts;
+    const uint64_t end = header_.num_records * (param_.part_index + 1) / param_.num_parts;
+    CHECK_GE(end - begin, batch_param_.batch_size)
+      << "number of records must be bigger than the batch size";
+    order_.resize(end - begin);
+    std::iota(order_.begin(), order_.end(), begin);
+    rnd_.seed(kRandMagic + param_.seed);
+
+    const TShape shape = header_.Shape();
+    std::vector<index_t> shape_vec = {batch_param_.batch_size};
+    shape_vec.insert(shape_vec.end(), shape.begin(), shape.end());
+    data_shape_ = TShape(shape_vec.begin(), shape_vec.end());
+    label_shape_ = mshadow::Shape2(batch_param_.batch_size, header_.label_width);
+    out_.index.resize(batch_param_.batch_size);
+    BeforeFirst();
+  }
+
+  virtual void BeforeFirst() {
+    if (param_.shuffle) std::shuffle(order_.begin(), order_.end(), rnd_);
+    pos_ = 0;
+  }
+
+  virtual bool Next() {
+    if (pos_ >= order_.size()) return false;
+    const size_t batch_size = batch_param_.batch_size;
+    const size_t num = std::min(batch_size, order_.size() - pos_);
+    // the last batch is padded with the first records
+    std::vector<uint64_t> records(order_.begin() + pos_, order_.begin() + pos_ + num);
+    records.insert(records.end(), order_.begin(), order_.begin() + (batch_size - num));
+    out_.num_batch_padd = static_cast<int>(batch_size - num);
+    pos_ += num;
+
+    bool consecutive = true;
+    for (size_t i = 1; i < batch_size && consecutive; ++i) {
+      consecutive = records[i] == records[i - 1] + 1;
+    }
+    const uint64_t* ids = reinterpret_cast<const uint64_t*>(base_ + header_.ids_offset);
+    for (size_t i = 0; i < batch_size; ++i) out_.index[i] = ids[records[i]];
+    if (buffers_.empty()) {
+      buffers_ = {NDArray(data_shape_, Context::CPU(), false, header_.dtype),
+                  NDArray(label_shape_, Context::CPU(), false, mshadow::kFloat32)};
+    }
+    for (NDArray& arr : buffers_) arr.WaitToWrite();
+    char* data = static_cast<char*>(buffers_[0].data().dptr_);
+    float* label = buffers_[1].data().dptr<float>();
+    const size_t record_bytes = header_.RecordBytes();
+    const size_t label_width = header_.label_width;
+    #pragma omp parallel for num_threads(param_.preprocess_threads)
+    for (int i = 0; i < static_cast<int>(batch_size); ++i) {
+      std::memcpy(data + i * record_bytes, Data(records[i]), record_bytes);
+      std::memcpy(label + i * label_width, Label(records[i]), label_width * sizeof(float));
+    }
+    out_.data = buffers_;
+    if (consecutive && pos_ < order_.size()) {
+      WillNeed(order_[pos_], std::min(batch_size, order_.size() - pos_));
+    }
+    return true;
+  }
+
+  virtual const DataBatch &Value() const {
+    return out_;
+  }
+
+ private:
+  void Map(const std::string& path) {
+#if defined(_WIN32)
+    LOG(FATAL) << "TensorRecordIter is not supported on Windows";
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    CHECK_NE(fd, -1) << "Failed to open " << path << ": " << strerror(errno);
+    struct stat st;
+    CHECK_EQ(fstat(fd, &st), 0);
+    size_ = st.st_size;
+    CHECK_GE(size_, sizeof(TensorRecordHeader)) << path << " is not a tensor record file";
+    // the batches are copies, so the mapping is only read
+    void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    CHECK_NE(ptr, MAP_FAILED) << "Failed to map " << path << ": " << strerror(errno);
+    base_ = static_cast<char*>(ptr);
+    std::memcpy(&header_, base_, sizeof(header_));
+    header_.Check(size_);
+    if (param_.shuffle) madvise(base_ + header_.data_offset, size_ - header_.data_offset,
+                                MADV_RANDOM);
+#endif
+  }
+
+  /*! \brief reads ahead the records of the next batch */
+  void WillNeed(uint64_t record, size_t num) {
+#if !defined(_WIN32)
+    const uint64_t page = sysconf(_SC_PAGESIZE);
+    const uint64_t begin = (Data(record) - base_) / page * page;
+    const uint64_t end = Data(record) - base_ + num * header_.RecordBytes();
+    madvise(base_ + begin, end - begin, MADV_WILLNEED);
+#endif
+  }
+
+  const char* Data(uint64_t record) const {
+    return base_ + header_.data_offset + record * header_.RecordBytes();
+  }
+
+  const float* Label(uint64_t record) const {
+    return reinterpret_cast<const float*>(base_ + header_.labels_offset) +
+           record * header_.label_width;
+  }
+
+  static const int kRandMagic = 111;
+  TensorRecordParam param_;
+  BatchParam batch_param_;
+  /*! \brief the file mapped into memory */
+  char* base_ = nullptr;
+  size_t size_ = 0;
+  TensorRecordHeader header_;
+  TShape data_shape_;
+  TShape label_shape_;
+  /*! \brief records of the part, in the order of the epoch */
+  std::vector<uint64_t> order_;
+  size_t pos_ = 0;
+  common::RANDOM_ENGINE rnd_;
+  /*! \brief arrays the records of the batches are copied into */
+  std::vector<NDArray> buffers_;
+  DataBatch out_;
+};
+
+DMLC_REGISTER_PARAMETER(TensorRecordParam);
+
+MXNET_REGISTER_IO_ITER(TensorRecordIter)
+.describe(R"code(Iterates on tensor record files.
+
+A tensor record file holds records of decoded tensors of the same shape and
+type, such as feature vectors or spectrograms, with their labels. They are
+created by ``tools/tensor2rec``. The file is mapped into memory, and the records
+of a batch are copied from it in parallel without any decoding. Without
+``shuffle``, the records of the next batch are read ahead.
+
+The last batch of an epoch is padded with the first records of the epoch.
+
+Example::
+
+  data_iter = mx.io.TensorRecordIter(path_tensorrec="./train.trec", batch_size=64,
+                                     shuffle=True)
+
+)code" ADD_FILELINE)
+.add_arguments(TensorRecordParam::__FIELDS__())
+.add_arguments(BatchParam::__FIELDS__())
+.set_body([]() {
+    return new TensorRecordIter();
+  });
+
+}  // namespace io
+}  // namespace mxnet
@@ -0,0 +1,301 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file iter_text_block.h
+ * \brief base of the iterators of text files, which write the rows parsed in
+ *  parallel by TextBlockReader into the arrays of the batches directly
+ */
+#ifndef MXNET_IO_ITER_TEXT_BLOCK_H_
+#define MXNET_IO_ITER_TEXT_BLOCK_H_
+
+#include <mxnet/io.h>
+#include <mxnet/ndarray.h>
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <dmlc/threadediter.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./image_iter_common.h"
+#include "./text_block_parser.h"
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief takes the rows of each batch from the readers of the data and the
+ *  label in a prefetching thread, and lets the subclass write them into the
+ *  output arrays. Overflowing batches wrap around as by BatchLoader.
+ */
+class TextBlockIter : public IIterator<DataBatch> {
+ public:
+  typedef std::vector<TextBlockReader::Span> Spans;
+
+  TextBlockIter() : out_(nullptr) {}
+
+  virtual ~TextBlockIter() {
+    StopPrefetch();
+    while (recycle_queue_.size() != 0) {
+      delete recycle_queue_.front();
+      recycle_queue_.pop();
+    }
+    delete out_;
+  }
+
+  virtual void BeforeFirst(void) {
+    iter_.BeforeFirst();
+  }
+
+  virtual bool Next(void) {
+    if (out_ != nullptr) {
+      recycle_queue_.push(out_); out_ = nullptr;
+    }
+    // do recycle
+    if (recycle_queue_.size() == prefetch_param_.prefetch_buffer) {
+      DataBatch *old_batch = recycle_queue_.front();
+      for (NDArray& arr : old_batch->data) {
+        arr.WaitToWrite();
+      }
+      recycle_queue_.pop();
+      iter_.Recycle(&old_batch);
+    }
+    return iter_.Next(&out_);
+  }
+
+  virtual const DataBatch &Value(void) const {
+    return *out_;
+  }
+
+ protected:
+  /*!
+   * \brief starts prefetching, once the subclass has created the readers
+   * \param label_reader reader of the labels, or null if they are not in a
+   *  file of their own
+   */
+  void InitReaders(const std::vector<std::pair<std::string, std::string> >& kwargs,
+                   TextBlockReader* data_reader, TextBlockReader* label_reader) {
+    batch_param_.InitAllowUnknown(kwargs);
+    prefetch_param_.InitAllowUnknown(kwargs);
+    data_reader_.reset(data_reader);
+    label_reader_.reset(label_reader);
+    // maximum prefetch threaded iter internal size
+    const int kMaxPrefetchBuffer = 16;
+    iter_.set_max_capacity(kMaxPrefetchBuffer);
+    iter_.Init([this](DataBatch **dptr) {
+        if (*dptr == nullptr) {
+          *dptr = new DataBatch();
+          (*dptr)->index.resize(batch_param_.batch_size);
+        }
+        return ParseNext(*dptr);
+      },
+      [this]() {
+        if (batch_param_.round_batch == 0 || !overflow_) {
+          ResetReaders();
+        } else {
+          // the readers went past the beginning already
+          overflow_ = false;
+        }
+      });
+  }
+
+  /*!
+   * \brief stops the prefetching thread, which calls WriteBatch, so that the
+   *  destructors of subclasses must call it first
+   */
+  void StopPrefetch() {
+    iter_.Destroy();
+  }
+
+  /*!
+   * \brief writes the rows of data_spans_ and label_spans_ into out, of which
+   *  the data is empty on the first batch
+   */
+  virtual void WriteBatch(DataBatch* out) = 0;
+
+  /*! \brief whether the labels are in a file of their own */
+  bool has_label_reader() const {
+    return label_reader_ != nullptr;
+  }
+
+  /*! \brief output type of the arrays, float32 unless set */
+  int OutputType() const {
+    return prefetch_param_.dtype ? prefetch_param_.dtype.value() : mshadow::kFloat32;
+  }
+
+  /*!
+   * \brief writes the rows of spans into the dense rows of shape in out; the
+   *  rows after them are left as they are
+   */
+  static void WriteDense(const Spans& spans, const TShape& shape, const TBlob& out) {
+    const size_t row_size = shape.Size();
+    MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+      DType* dst = out.dptr<DType>();
+      for (const auto& span : spans) {
+        const TextRows& rows = *span.rows;
+        for (size_t r = span.begin; r < span.end; ++r) {
+          const size_t length = rows.offset[r + 1] - rows.offset[r];
+          CHECK_EQ(length, row_size)
+            << "The data size in CSV do not match size of shape: "
+            << "specified shape=" << shape << ", the csv row-length=" << length;
+        }
+        const float* src = rows.value.data() + rows.offset[span.begin];
+        const size_t size = rows.offset[span.end] - rows.offset[span.begin];
+        for (size_t i = 0; i < size; ++i) dst[i] = static_cast<DType>(src[i]);
+        dst += size;
+      }
+    });
+  }
+
+  /*! \brief writes the labels of the rows of spans into out */
+  static void WriteLabels(const Spans& spans, const TBlob& out) {
+    MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+      DType* dst = out.dptr<DType>();
+      for (const auto& span : spans) {
+        for (size_t r = span.begin; r < span.end; ++r) {
+          *dst++ = static_cast<DType>(span.rows->label[r]);
+        }
+      }
+    });
+  }
+
+  /*!
+   * \brief writes the rows of spans into the csr array out of batch_size
+   *  rows. Rows after them are empty.
+   */
+  static void WriteCSR(const Spans& spans, NDArray* out) {
+    const index_t batch_size = out->shape()[0];
+    const int64_t num_cols = out->shape()[1];
+    size_t nnz = 0;
+    for (const auto& span : spans) {
+      const TextRows& rows = *span.rows;
+      for (int64_t i = rows.offset[span.begin]; i < rows.offset[span.end]; ++i) {
+        CHECK_LT(rows.index[i], num_cols)
+          << "Feature index " << rows.index[i] << " is out of the shape of the data, "
+          << "which has " << num_cols << " columns";
+      }
+      nnz += rows.offset[span.end] - rows.offset[span.begin];
+    }
+    out->CheckAndAllocAuxData(csr::kIndPtr, mshadow::Shape1(batch_size + 1));
+    out->CheckAndAllocAuxData(csr::kIdx, mshadow::Shape1(nnz));
+    out->CheckAndAllocData(mshadow::Shape1(nnz));
+    int64_t* indptr = out->aux_data(csr::kIndPtr).dptr<int64_t>();
+    int64_t* idx = out->aux_data(csr::kIdx).dptr<int64_t>();
+    const TBlob values = out->data();
+    int64_t pos = 0;
+    index_t row = 0;
+    indptr[0] = 0;
+    for (const auto& span : spans) {
+      const TextRows& rows = *span.rows;
+      const int64_t first = rows.offset[span.begin];
+      const int64_t size = rows.offset[span.end] - first;
+      for (size_t r = span.begin; r < span.end; ++r) {
+        indptr[++row] = pos + rows.offset[r + 1] - first;
+      }
+      std::memcpy(idx + pos, rows.index.data() + first, size * sizeof(int64_t));
+      MSHADOW_TYPE_SWITCH(values.type_flag_, DType, {
+        DType* dst = values.dptr<DType>() + pos;
+        const float* src = rows.value.data() + first;
+        for (int64_t i = 0; i < size; ++i) dst[i] = static_cast<DType>(src[i]);
+      });
+      pos += size;
+    }
+    for (; row < batch_size; ++row) indptr[row + 1] = pos;
+  }
+
+  /*! \brief batch parameters */
+  BatchParam batch_param_;
+  /*! \brief prefetcher parameters */
+  PrefetcherParam prefetch_param_;
+  /*! \brief rows of the data and the label of the batch being written */
+  Spans data_spans_, label_spans_;
+
+ private:
+  void ResetReaders() {
+    data_reader_->BeforeFirst();
+    if (label_reader_ != nullptr) label_reader_->BeforeFirst();
+    inst_counter_ = 0;
+  }
+
+  /*! \brief takes the next n rows of the data and the label */
+  size_t Take(size_t n) {
+    const size_t num = data_reader_->Take(n, &data_spans_);
+    if (label_reader_ != nullptr) {
+      CHECK_EQ(label_reader_->Take(num, &label_spans_), num)
+        << "Data's row is smaller than the number of rows in the label file";
+    }
+    return num;
+  }
+
+  bool ParseNext(DataBatch* out) {
+    // if overflow from previous round, directly return false, until before first is called
+    if (overflow_) return false;
+    data_spans_.clear();
+    label_spans_.clear();
+    const size_t batch_size = batch_param_.batch_size;
+    size_t num = Take(batch_size);
+    if (num == 0) return false;
+    for (size_t i = 0; i < num; ++i) out->index[i] = inst_counter_++;
+    out->num_batch_padd = 0;
+    if (num < batch_size) {
+      if (batch_param_.round_batch != 0) {
+        ResetReaders();
+        const size_t more = Take(batch_size - num);
+        CHECK_EQ(more, batch_size - num) << "number of input must be bigger than batch size";
+        for (; num < batch_size; ++num) out->index[num] = inst_counter_++;
+        out->num_batch_padd = more;
+        overflow_ = true;
+      } else {
+        out->num_batch_padd = batch_size - num;
+      }
+    }
+    WriteBatch(out);
+    // lets the reader reuse the buffers of the rows
+    data_spans_.clear();
+    label_spans_.clear();
+    return true;
+  }
+
+  /*! \brief readers of the data and the label */
+  std::unique_ptr<TextBlockReader> data_reader_, label_reader_;
+  /*! \brief index of the next row */
+  unsigned inst_counter_{0};
+  /*! \brief whether the last batch wrapped around the data */
+  bool overflow_{false};
+  /*! \brief backend thread */
+  dmlc::ThreadedIter<DataBatch> iter_;
+  /*! \brief output data */
+  DataBatch *out_;
+  /*! \brief queue to be recycled */
+  std::queue<DataBatch*> recycle_queue_;
+};
+
+/*! \brief number of threads parsing the text, given the wanted number */
+inline int TextParseThreads(int preprocess_threads) {
+  return std::max(std::min(preprocess_threads, omp_get_num_procs()), 1);
+}
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ITER_TEXT_BLOCK_H_
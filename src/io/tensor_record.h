@@ -0,0 +1,129 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file tensor_record.h
+ * \brief file of records holding decoded tensors of the same shape and type
+ *
+ *  Tensor Record Format:
+ *    header (128 bytes, see TensorRecordHeader)
+ *    ids[num_records] (uint64)
+ *    labels[num_records][label_width] (float32)
+ *    padding to a multiple of 4096 bytes
+ *    data[num_records][shape] (dtype)
+ *  All numbers are little endian. As the tensors of consecutive records are
+ *  consecutive, a batch of them is read with a single copy from the read-only
+ *  mapping of the file into the buffers of the iterator.
+ */
+#ifndef MXNET_IO_TENSOR_RECORD_H_
+#define MXNET_IO_TENSOR_RECORD_H_
+
+#include <dmlc/logging.h>
+#include <mshadow/base.h>
+#include <mxnet/base.h>
+#include <cstdint>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief header at the start of a tensor record file
+ */
+struct TensorRecordHeader {
+  /*! \brief "MXTENSOR" */
+  static const uint64_t kMagic = 0x524f534e4554584dULL;
+  static const uint32_t kVersion = 1;
+  static const uint32_t kMaxDim = 8;
+  /*! \brief alignment of the data section */
+  static const uint64_t kAlign = 4096;
+
+  uint64_t magic;
+  uint32_t version;
+  /*! \brief type flag of the tensors, as in mshadow */
+  int32_t dtype;
+  uint32_t ndim;
+  uint32_t label_width;
+  /*! \brief shape of a tensor, the first ndim are used */
+  uint64_t shape[kMaxDim];
+  uint64_t num_records;
+  /*! \brief offsets of the sections in the file */
+  uint64_t ids_offset;
+  uint64_t labels_offset;
+  uint64_t data_offset;
+  /*! \brief zero, reserved for future use */
+  uint64_t reserved;
+
+  /*!
+   * \brief header of a file with the sections laid out one after another
+   */
+  static TensorRecordHeader Create(int dtype, const TShape& shape, uint32_t label_width,
+                                   uint64_t num_records) {
+    CHECK_LE(shape.ndim(), static_cast<uint32_t>(kMaxDim))
+      << "Tensors have at most " << kMaxDim << " dimensions";
+    TensorRecordHeader h;
+    h.magic = kMagic;
+    h.version = kVersion;
+    h.dtype = dtype;
+    h.ndim = shape.ndim();
+    h.label_width = label_width;
+    for (uint32_t i = 0; i < kMaxDim; ++i) h.shape[i] = i < h.ndim ? shape[i] : 0;
+    h.num_records = num_records;
+    h.ids_offset = sizeof(TensorRecordHeader);
+    h.labels_offset = h.ids_offset + num_records * sizeof(uint64_t);
+    const uint64_t labels_end = h.labels_offset + num_records * label_width * sizeof(float);
+    h.data_offset = (labels_end + kAlign - 1) / kAlign * kAlign;
+    h.reserved = 0;
+    return h;
+  }
+
+  TShape Shape() const {
+    return TShape(shape, shape + ndim);
+  }
+
+  /*! \brief bytes of the tensor of a record */
+  size_t RecordBytes() const {
+    return Shape().Size() * mshadow::mshadow_sizeof(dtype);
+  }
+
+  /*! \brief bytes of the whole file */
+  uint64_t FileBytes() const {
+    return data_offset + num_records * RecordBytes();
+  }
+
+  /*!
+   * \brief checks the header read from a file of file_bytes
+   */
+  void Check(uint64_t file_bytes) const {
+    CHECK_EQ(magic, static_cast<uint64_t>(kMagic)) << "Not a tensor record file";
+    CHECK_EQ(version, static_cast<uint32_t>(kVersion))
+      << "Unsupported version of tensor record file";
+    CHECK_LE(ndim, static_cast<uint32_t>(kMaxDim));
+    CHECK_GE(labels_offset, ids_offset + num_records * sizeof(uint64_t));
+    CHECK_GE(data_offset, labels_offset + num_records * label_width * sizeof(float));
+    CHECK_GE(file_bytes, FileBytes()) << "Truncated tensor record file";
+  }
+};
+
+static_assert(sizeof(TensorRecordHeader) == 128, "The header of tensor records is 128 bytes");
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_TENSOR_RECORD_H_
@@ -0,0 +1,350 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file text_block_parser.h
+ * \brief parses blocks of LibSVM or CSV text in parallel into rows in CSR form
+ */
+#ifndef MXNET_IO_TEXT_BLOCK_PARSER_H_
+#define MXNET_IO_TEXT_BLOCK_PARSER_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+
+/*! \brief formats of the text */
+enum TextFormat {
+  kLibSVMText,
+  kCSVText
+};
+
+/*!
+ * \brief rows parsed from a piece of text, in CSR form. The values of a CSV
+ *  row are dense, so that it has no indices.
+ */
+struct TextRows {
+  /*! \brief label of each row, for LibSVM */
+  std::vector<float> label;
+  /*! \brief offsets of the rows in index and value, starting with 0 */
+  std::vector<int64_t> offset;
+  /*! \brief column of each value, for LibSVM */
+  std::vector<int64_t> index;
+  /*! \brief values of the rows */
+  std::vector<float> value;
+
+  TextRows() {
+    Clear();
+  }
+  /*! \brief number of rows */
+  size_t Size() const {
+    return offset.size() - 1;
+  }
+  void Clear() {
+    label.clear();
+    offset.assign(1, 0);
+    index.clear();
+    value.clear();
+  }
+};
+
+namespace text {
+
+inline bool IsBlank(char c) {
+  return c == ' ' || c == '\t';
+}
+
+inline bool IsEndLine(char c) {
+  return c == '\n' || c == '\r';
+}
+
+/*! \brief whether [p, end) starts with word, ignoring the case */
+inline bool StartsWithWord(const char* p, const char* end, const char* word) {
+  for (; *word != '\0'; ++p, ++word) {
+    if (p == end || (*p | 0x20) != *word) return false;
+  }
+  return true;
+}
+
+/*!
+ * \brief parses the decimal number at *p, which must end before end. As
+ *  strtod, nan, inf and infinity are accepted in any case.
+ * \return false if there is no number at *p
+ */
+inline bool ParseNumber(const char** p, const char* end, double* out) {
+  static const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                                  1e20, 1e21, 1e22};
+  const char* s = *p;
+  bool negative = false;
+  if (s != end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+  if (s != end && ((*s | 0x20) == 'n' || (*s | 0x20) == 'i')) {
+    if (StartsWithWord(s, end, "nan")) {
+      *out = negative ? -NAN : NAN;
+      *p = s + 3;
+      return true;
+    }
+    if (StartsWithWord(s, end, "inf")) {
+      *out = negative ? -HUGE_VAL : HUGE_VAL;
+      *p = s + (StartsWithWord(s, end, "infinity") ? 8 : 3);
+      return true;
+    }
+    return false;
+  }
+  uint64_t mantissa = 0;
+  int exponent = 0, digits = 0;
+  for (; s != end && *s >= '0' && *s <= '9'; ++s, ++digits) {
+    // digits beyond the precision of the mantissa only scale it
+    if (mantissa < (UINT64_MAX - 9) / 10) {
+      mantissa = mantissa * 10 + (*s - '0');
+    } else {
+      ++exponent;
+    }
+  }
+  if (s != end && *s == '.') {
+    for (++s; s != end && *s >= '0' && *s <= '9'; ++s, ++digits) {
+      if (mantissa < (UINT64_MAX - 9) / 10) {
+        mantissa = mantissa * 10 + (*s - '0');
+        --exponent;
+      }
+    }
+  }
+  if (digits == 0) return false;
+  if (s != end && (*s == 'e' || *s == 'E')) {
+    const char* e = s + 1;
+    bool negative_exp = false;
+    if (e != end && (*e == '-' || *e == '+')) negative_exp = *e++ == '-';
+    if (e != end && *e >= '0' && *e <= '9') {
+      int exp = 0;
+      for (; e != end && *e >= '0' && *e <= '9'; ++e) exp = std::min(exp * 10 + (*e - '0'), 9999);
+      exponent += negative_exp ? -exp : exp;
+      s = e;
+    }
+  }
+  double v = static_cast<double>(mantissa);
+  if (exponent >= -22 && exponent <= 22) {
+    v = exponent < 0 ? v / kPow10[-exponent] : v * kPow10[exponent];
+  } else {
+    v *= std::pow(10.0, exponent);
+  }
+  *out = negative ? -v : v;
+  *p = s;
+  return true;
+}
+
+/*! \brief parses a LibSVM line [p, end) without its end of line */
+inline void ParseLibSVMLine(const char* p, const char* end, TextRows* rows) {
+  end = std::find(p, end, '#');
+  while (p != end && IsBlank(*p)) ++p;
+  if (p == end) return;
+  double label;
+  CHECK(ParseNumber(&p, end, &label))
+    << "Invalid LibSVM label in line: " << std::string(p, end);
+  // the weight of the label is ignored
+  if (p != end && *p == ':') {
+    while (p != end && !IsBlank(*p)) ++p;
+  }
+  rows->label.push_back(static_cast<float>(label));
+  while (true) {
+    while (p != end && IsBlank(*p)) ++p;
+    if (p == end) break;
+    if (end - p > 4 && std::equal(p, p + 4, "qid:")) {
+      while (p != end && !IsBlank(*p)) ++p;
+      continue;
+    }
+    const char* token = p;
+    double index, value = 1;
+    CHECK(ParseNumber(&p, end, &index) && std::isfinite(index) && index == std::floor(index))
+      << "Invalid LibSVM feature: " << std::string(token, end);
+    CHECK_GE(index, 0) << "Negative LibSVM feature index: " << std::string(token, end);
+    if (p != end && *p == ':') {
+      ++p;
+      CHECK(ParseNumber(&p, end, &value))
+        << "Invalid LibSVM feature value: " << std::string(token, end);
+    }
+    CHECK(p == end || IsBlank(*p)) << "Invalid LibSVM feature: " << std::string(token, end);
+    rows->index.push_back(static_cast<int64_t>(index));
+    rows->value.push_back(static_cast<float>(value));
+  }
+  rows->offset.push_back(rows->value.size());
+}
+
+/*! \brief parses a CSV line [p, end) without its end of line */
+inline void ParseCSVLine(const char* p, const char* end, TextRows* rows) {
+  if (p == end) return;
+  while (true) {
+    while (p != end && IsBlank(*p)) ++p;
+    const char* field = p;
+    double value = 0;
+    // an empty field is 0
+    if (p != end && *p != ',') {
+      CHECK(ParseNumber(&p, end, &value))
+        << "Invalid CSV value: " << std::string(field, std::find(field, end, ','));
+      while (p != end && IsBlank(*p)) ++p;
+      CHECK(p == end || *p == ',')
+        << "Invalid CSV value: " << std::string(field, std::find(field, end, ','));
+    }
+    rows->value.push_back(static_cast<float>(value));
+    if (p == end) break;
+    ++p;
+  }
+  rows->offset.push_back(rows->value.size());
+}
+
+}  // namespace text
+
+/*! \brief parses the lines of the text [begin, end) into rows */
+inline void ParseTextRows(TextFormat format, const char* begin, const char* end,
+                          TextRows* rows) {
+  const char* p = begin;
+  while (p != end) {
+    const char* line_end = p;
+    while (line_end != end && !text::IsEndLine(*line_end)) ++line_end;
+    if (format == kLibSVMText) {
+      text::ParseLibSVMLine(p, line_end, rows);
+    } else {
+      text::ParseCSVLine(p, line_end, rows);
+    }
+    p = line_end;
+    while (p != end && text::IsEndLine(*p)) ++p;
+  }
+}
+
+/*!
+ * \brief reads the rows of text files by chunk. Each chunk is cut into a
+ *  piece per thread at line ends, and the pieces are parsed in parallel.
+ */
+class TextBlockReader {
+ public:
+  /*! \brief rows [begin, end) of parsed rows */
+  struct Span {
+    std::shared_ptr<const TextRows> rows;
+    size_t begin;
+    size_t end;
+  };
+
+  /*!
+   * \brief reads the part part_index of num_parts of the files at path
+   * \param nthread number of threads parsing a chunk
+   * \param chunk_bytes size of the chunks read at once
+   */
+  TextBlockReader(const std::string& path, unsigned part_index, unsigned num_parts,
+                  TextFormat format, int nthread, size_t chunk_bytes = 16UL << 20)
+      : format_(format), nthread_(std::max(nthread, 1)), parts_(nthread_) {
+    source_.reset(dmlc::InputSplit::Create(path.c_str(), part_index, num_parts, "text"));
+    source_->HintChunkSize(chunk_bytes);
+  }
+
+  void BeforeFirst() {
+    source_->BeforeFirst();
+    part_ = parts_.size();
+    row_ = 0;
+  }
+
+  /*!
+   * \brief takes the next n rows, or the rest of them at the end of the data.
+   *  The rows stay valid as long as the spans are kept.
+   * \return the number of rows taken
+   */
+  size_t Take(size_t n, std::vector<Span>* spans) {
+    size_t taken = 0;
+    while (taken < n) {
+      if (part_ == parts_.size()) {
+        if (!ReadChunk()) break;
+        continue;
+      }
+      const std::shared_ptr<TextRows>& rows = parts_[part_];
+      if (row_ == rows->Size()) {
+        ++part_;
+        row_ = 0;
+        continue;
+      }
+      const size_t num = std::min(n - taken, rows->Size() - row_);
+      spans->push_back(Span{rows, row_, row_ + num});
+      row_ += num;
+      taken += num;
+    }
+    return taken;
+  }
+
+ private:
+  /*! \brief parses the next chunk into parts_ */
+  bool ReadChunk() {
+    dmlc::InputSplit::Blob chunk;
+    if (!source_->NextChunk(&chunk)) return false;
+    const char* begin = static_cast<const char*>(chunk.dptr);
+    const char* end = begin + chunk.size;
+    // the rows of spans still kept by the caller are not overwritten
+    for (auto& part : parts_) {
+      if (part == nullptr || part.use_count() > 1) part = std::make_shared<TextRows>();
+    }
+    std::exception_ptr error;
+    const int nthread = nthread_;
+    #pragma omp parallel for num_threads(nthread) schedule(static, 1)
+    for (int i = 0; i < nthread; ++i) {
+      try {
+        parts_[i]->Clear();
+        ParseTextRows(format_, PieceBegin(begin, end, i), PieceBegin(begin, end, i + 1),
+                      parts_[i].get());
+      } catch (...) {
+        #pragma omp critical
+        {
+          error = std::current_exception();
+        }
+      }
+    }
+    if (error) std::rethrow_exception(error);
+    part_ = 0;
+    row_ = 0;
+    return true;
+  }
+
+  /*! \brief first line of the i-th piece of the chunk [begin, end) */
+  const char* PieceBegin(const char* begin, const char* end, int i) const {
+    if (i == 0) return begin;
+    if (i == nthread_) return end;
+    const char* p = begin + (end - begin) * i / nthread_;
+    while (p != end && !text::IsEndLine(*p)) ++p;
+    while (p != end && text::IsEndLine(*p)) ++p;
+    return p;
+  }
+
+  TextFormat format_;
+  int nthread_;
+  std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief rows parsed from the pieces of the current chunk */
+  std::vector<std::shared_ptr<TextRows> > parts_;
+  /*! \brief position of the next row */
+  size_t part_ = 0;
+  size_t row_ = 0;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_TEXT_BLOCK_PARSER_H_
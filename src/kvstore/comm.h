@@ -368,6 +368,11 @@ class CommCPU : public Comm {
     }
   }
 
+ public:
+  /**
+   * \brief sums total values at each of dptr into dptr[0], with several threads
+   *  for big arrays. Also used by the shared memory kvstore across processes.
+   */
   template<typename DType>
   inline void ReduceSumCPUImpl(std::vector<DType*> dptr, size_t total) {
     const size_t step = std::min(bigarray_bound_, static_cast<size_t>(4 << 10));
@@ -386,6 +391,7 @@ class CommCPU : public Comm {
     }
   }
 
+ private:
   /// \brief temporal space for pushing and pulling
   struct BufferEntry {
     /// \brief the merged value
@@ -25,6 +25,10 @@
 #ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
 #define MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
 #include <vector>
 #include "../operator/mxnet_op.h"
 
@@ -149,6 +153,108 @@ inline void Dequantize2BitImpl(mshadow::Stream<mshadow::cpu> *s,
                                const float threshold) {
   Dequantize2BitKernelLaunch(s, inputs, threshold);
 }
+
+/*!
+ * Top-k compression splits the gradient into blocks of TopKBlockSize(factor) elements.
+ * Each block sends its TopKNumEntries largest entries, by absolute value after adding
+ * the residual, as pairs of an index into the block and a value. The other entries stay
+ * in the residual. A block compresses independently of the others, so that partitions of
+ * the compressed array made of whole blocks can be decompressed on their own.
+ */
+const int kTopKBlockEntries = 64;
+
+/*!
+ * \brief factor of a ratio, an index and a value are sent for every 2 * factor elements,
+ *  so that the ratio actually sent is TopKEffectiveRatio(factor)
+ */
+inline int TopKCompressionFactor(const float ratio) {
+  return std::max(1, static_cast<int>(std::round(0.5 / ratio)));
+}
+
+inline float TopKEffectiveRatio(const int factor) {
+  return 0.5f / factor;
+}
+
+inline int64_t TopKBlockSize(const int factor) {
+  return 2 * kTopKBlockEntries * static_cast<int64_t>(factor);
+}
+
+/*! \brief number of entries sent for a block of len elements */
+inline int64_t TopKNumEntries(const int64_t len, const int factor) {
+  return std::min<int64_t>(kTopKBlockEntries, (len + 2 * factor - 1) / (2 * factor));
+}
+
+inline int64_t TopKCompressedSize(const int64_t original_size, const int factor) {
+  const int64_t block = TopKBlockSize(factor);
+  const int64_t rem = original_size % block;
+  return 2 * ((original_size / block) * kTopKBlockEntries +
+              (rem > 0 ? TopKNumEntries(rem, factor) : 0));
+}
+
+/*!
+ * \brief compresses inputs[0] plus the residual inputs[1] into inputs[2],
+ *  the entries which are sent are cleared from the residual
+ */
+inline void QuantizeTopKImpl(mshadow::Stream<mshadow::cpu> *s,
+                             const std::vector<mxnet::TBlob> &inputs,
+                             const int factor) {
+  const float *grad = inputs[0].dptr<float>();
+  float *residual = inputs[1].dptr<float>();
+  float *out = inputs[2].dptr<float>();
+  const int64_t original_size = inputs[0].Size();
+  CHECK_EQ(static_cast<int64_t>(inputs[2].Size()), TopKCompressedSize(original_size, factor));
+  const int64_t block = TopKBlockSize(factor);
+  const int64_t num_blocks = (original_size + block - 1) / block;
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel for num_threads(omp_threads)
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    const int64_t begin = b * block;
+    const int len = static_cast<int>(std::min(block, original_size - begin));
+    const int k = static_cast<int>(TopKNumEntries(len, factor));
+    float *res = residual + begin;
+    for (int i = 0; i < len; ++i) res[i] += grad[begin + i];
+    std::vector<int32_t> idx(len);
+    std::iota(idx.begin(), idx.end(), 0);
+    auto larger = [res](int32_t x, int32_t y) { return std::abs(res[x]) > std::abs(res[y]); };
+    if (k < len) std::nth_element(idx.begin(), idx.begin() + k, idx.end(), larger);
+    std::sort(idx.begin(), idx.begin() + k);
+    float *compr = out + 2 * b * kTopKBlockEntries;
+    for (int j = 0; j < k; ++j) {
+      // the index is sent as the bits of a float
+      std::memcpy(compr + 2 * j, &idx[j], sizeof(int32_t));
+      compr[2 * j + 1] = res[idx[j]];
+      res[idx[j]] = 0;
+    }
+  }
+}
+
+/*!
+ * \brief decompresses inputs[0] into inputs[1], entries which were not sent are 0
+ */
+inline void DequantizeTopKImpl(mshadow::Stream<mshadow::cpu> *s,
+                               const std::vector<mxnet::TBlob> &inputs,
+                               const int factor) {
+  const float *in = inputs[0].dptr<float>();
+  float *out = inputs[1].dptr<float>();
+  const int64_t original_size = inputs[1].Size();
+  CHECK_EQ(static_cast<int64_t>(inputs[0].Size()), TopKCompressedSize(original_size, factor));
+  const int64_t block = TopKBlockSize(factor);
+  const int64_t num_blocks = (original_size + block - 1) / block;
+  const int omp_threads = engine::OpenMP::Get()->GetRecommendedOMPThreadCount();
+  #pragma omp parallel for num_threads(omp_threads)
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    const int64_t begin = b * block;
+    const int64_t len = std::min(block, original_size - begin);
+    const int64_t k = TopKNumEntries(len, factor);
+    std::fill(out + begin, out + begin + len, 0.0f);
+    const float *compr = in + 2 * b * kTopKBlockEntries;
+    for (int64_t j = 0; j < k; ++j) {
+      int32_t i;
+      std::memcpy(&i, compr + 2 * j, sizeof(int32_t));
+      out[begin + i] = compr[2 * j + 1];
+    }
+  }
+}
 }  // namespace kvstore
 }  // namespace mxnet
 
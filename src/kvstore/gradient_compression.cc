@@ -23,6 +23,10 @@
  * \author Rahul Huilgol
  */
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
 #include <sstream>
 #include <vector>
 #include "gradient_compression.h"
@@ -61,6 +65,13 @@ void GradientCompression::SetParams(const std::vector<std::pair<std::string, std
   CHECK_GT(params.threshold, 0) << "threshold must be greater than 0";
   if (params.type == "2bit") {
     SetTwoBitCompression(params.threshold);
+  } else if (params.type == "topk") {
+    CHECK(params.ratio > 0 && params.ratio <= 0.5) << "ratio must be in (0, 0.5]";
+    const float effective = TopKEffectiveRatio(TopKCompressionFactor(params.ratio));
+    LOG_IF(WARNING, std::abs(effective - params.ratio) > 0.01 * params.ratio)
+      << "Top-k compression sends 1 / (2 * round(0.5 / ratio)) of the gradient values, "
+      << effective << " for a ratio of " << params.ratio;
+    SetTopKCompression(params.ratio);
   } else {
     LOG(FATAL) << "Unknown type for gradient compression " << params.type;
   }
@@ -79,11 +90,21 @@ void GradientCompression::SetTwoBitCompression(const float threshold) {
   threshold_ = threshold;
 }
 
+void GradientCompression::SetTopKCompression(const float ratio) {
+  type_ = CompressionType::kTopK;
+  ratio_ = ratio;
+}
+
 std::string GradientCompression::EncodeParams() {
   using namespace std;  // to reduce length of next line
   string rval = get_type_str();
   if (type_ == CompressionType::kTwoBit) {
     rval += "," + to_string(threshold_);
+  } else if (type_ == CompressionType::kTopK) {
+    // to_string keeps only 6 decimals, too few for small ratios
+    ostringstream os;
+    os << setprecision(numeric_limits<float>::max_digits10) << ratio_;
+    rval += ",," + os.str();
   }
   return rval;
 }
@@ -97,11 +118,18 @@ void GradientCompression::DecodeParams(const std::string &s) {
       threshold_ = stof(elems[1]);
     }
   }
+  if (elems.size() > 2) {
+    if (!elems[2].empty()) {
+      ratio_ = stof(elems[2]);
+    }
+  }
 }
 
 int GradientCompression::GetCompressionFactor() {
   if (type_ == CompressionType::kTwoBit) {
     return 16;
+  } else if (type_ == CompressionType::kTopK) {
+    return TopKCompressionFactor(ratio_);
   } else {
     LOG(FATAL) << "Unsupported compression type: " << get_type_str();
     return 0;
@@ -109,12 +137,22 @@ int GradientCompression::GetCompressionFactor() {
 }
 
 int64_t GradientCompression::GetCompressedSize(const int64_t original_size) {
+  if (type_ == CompressionType::kTopK) {
+    return TopKCompressedSize(original_size, GetCompressionFactor());
+  }
   const int bits = GetCompressionFactor();
   return ((original_size % bits == 0) ?
           original_size / bits :
           original_size / bits + 1);
 }
 
+int64_t GradientCompression::GetCompressedBlockSize() {
+  if (type_ == CompressionType::kTopK) {
+    return 2 * kTopKBlockEntries;
+  }
+  return 1;
+}
+
 void GradientCompression::Quantize(const mxnet::NDArray &from, mxnet::NDArray *to,
                   mxnet::NDArray *residual, const int priority) {
   CHECK(from.shape().ndim() != 0) << "source operand has zero dimension shape";
@@ -147,6 +185,15 @@ void GradientCompression::Quantize(const mxnet::NDArray &from, mxnet::NDArray *t
     LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
 #endif
     }
+  } else if (type_ == CompressionType::kTopK) {
+    CHECK(a == mshadow::cpu::kDevMask && b == mshadow::cpu::kDevMask)
+      << "topk gradient compression is only supported on CPU";
+    const int factor = GetCompressionFactor();
+    mxnet::Engine::Get()->PushSync([from, to, residual, factor](mxnet::RunContext ctx) {
+      std::vector<mxnet::TBlob> inputs = {from.data(), residual->data(), to->data()};
+      QuantizeTopKImpl(ctx.get_stream<mshadow::cpu>(), inputs, factor);
+    }, from.ctx(), {from.var()}, {to->var(), residual->var()},
+    mxnet::FnProperty::kNormal, priority, "QuantizeTopKCPU");
   } else {
     LOG(FATAL) << "Unsupported quantization of type " << get_type_str();
   }
@@ -183,6 +230,15 @@ void GradientCompression::Dequantize(const mxnet::NDArray &from, mxnet::NDArray
       LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
 #endif
     }
+  } else if (type_ == CompressionType::kTopK) {
+    CHECK(a == mshadow::cpu::kDevMask && b == mshadow::cpu::kDevMask)
+      << "topk gradient compression is only supported on CPU";
+    const int factor = GetCompressionFactor();
+    mxnet::Engine::Get()->PushSync([from, to, factor](mxnet::RunContext ctx) {
+      std::vector<mxnet::TBlob> inputs = {from.data(), to->data()};
+      DequantizeTopKImpl(ctx.get_stream<mshadow::cpu>(), inputs, factor);
+    }, from.ctx(), {from.var()}, {to->var()},
+    mxnet::FnProperty::kNormal, priority, "DequantizeTopKCPU");
   } else {
     LOG(FATAL) << "Unsupported dequantization of type " << get_type_str();
   }
@@ -35,17 +35,21 @@ namespace mxnet {
 namespace kvstore {
 
 enum class CompressionType {
-  kNone, kTwoBit
+  kNone, kTwoBit, kTopK
 };
 
 struct GradientCompressionParam : public dmlc::Parameter<GradientCompressionParam> {
   std::string type;
   float threshold;
+  float ratio;
   DMLC_DECLARE_PARAMETER(GradientCompressionParam) {
     DMLC_DECLARE_FIELD(type)
-      .describe("Type of gradient compression to use, like `2bit` for example");
+      .describe("Type of gradient compression to use, like `2bit` or `topk` for example");
     DMLC_DECLARE_FIELD(threshold).set_default(0.5)
       .describe("Threshold to use for 2bit gradient compression");
+    DMLC_DECLARE_FIELD(ratio).set_default(0.001)
+      .describe("Fraction of the gradient entries sent by topk gradient compression, "
+                "rounded to 1 / (2 * round(0.5 / ratio))");
   }
 };
 
@@ -78,6 +82,12 @@ class GradientCompression {
    */
   void SetTwoBitCompression(const float threshold);
 
+  /*!
+   * \brief sets top-k gradient compression
+   * \param ratio fraction of the gradient entries with the largest absolute values to send
+   */
+  void SetTopKCompression(const float ratio);
+
   /*!
    * \brief encodes parameters of gc into a string
    */
@@ -99,6 +109,13 @@ class GradientCompression {
    */
   int64_t GetCompressedSize(const int64_t original_size);
 
+  /*!
+   * \brief returns the number of elements of the compressed gradients which are
+   * decompressed independently of the others. Compressed arrays can only be split
+   * at multiples of it.
+   */
+  int64_t GetCompressedBlockSize();
+
   /*!
   * \brief Issues quantize operation to be scheduled by the engine
   * Compresses `from` into `to` and accumulates the quantization error
@@ -132,6 +149,11 @@ class GradientCompression {
    * all negative gradients will be thresholded to -1*`threshold_`
    */
   float threshold_ = 0;
+
+  /*!
+   * \brief denotes the fraction of gradient entries sent by top-k compression
+   */
+  float ratio_ = 0;
 };
 }  // namespace kvstore
 }  // namespace mxnet
@@ -34,6 +34,10 @@ std::atomic<int> mxnet::kvstore::KVStoreDist::customer_id_{0};
 #if MXNET_USE_NCCL
 #include "./kvstore_nccl.h"
 #endif  // MXNET_USE_NCCL
+#if !defined(_WIN32) && !defined(ANDROID) && !defined(__ANDROID__)
+#include "./kvstore_shm.h"
+#define MXNET_USE_SHM_KVSTORE 1
+#endif
 
 namespace mxnet {
 
@@ -67,6 +71,13 @@ KVStore* KVStore::Create(const char *type_name) {
 #else
       LOG(FATAL) << "compile with USE_NCCL=1 to use " << tname;
       return nullptr;
+#endif
+    } else if (has("shm")) {
+#if MXNET_USE_SHM_KVSTORE
+      kv = new kvstore::KVStoreShm();
+#else
+      LOG(FATAL) << "the shm kvstore is not supported on this platform";
+      return nullptr;
 #endif
     } else {
       kv =  new kvstore::KVStoreLocal(use_device_comm);
@@ -27,11 +27,14 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <memory>
 #include <utility>
 #include "./kvstore_local.h"
 #include "mxnet/engine.h"
 #include "ps/ps.h"
 #include "./kvstore_dist_server.h"
+#include "./kvstore_dist_fusion.h"
+#include "./wire_dtype.h"
 namespace mxnet {
 namespace kvstore {
 
@@ -57,10 +60,27 @@ class KVStoreDist : public KVStoreLocal {
     }
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
     log_verbose_ = dmlc::GetEnv("MXNET_KVSTORE_DIST_ROW_SPARSE_VERBOSE", false);
+    const size_t fusion_threshold = dmlc::GetEnv("MXNET_KVSTORE_FUSION_THRESHOLD", 0);
+    if (IsWorkerNode() && fusion_threshold > 0) {
+      const size_t bucket_size = dmlc::GetEnv("MXNET_KVSTORE_FUSION_BUCKET_SIZE", 4 << 20);
+      const int timeout = dmlc::GetEnv("MXNET_KVSTORE_FUSION_TIMEOUT", 1000);
+      CHECK_GT(timeout, 0) << "MXNET_KVSTORE_FUSION_TIMEOUT must be positive";
+      fusion_.reset(new KVStoreDistFusion(ps_worker_, fusion_threshold, bucket_size, timeout));
+    }
+    const std::string wire_dtype = dmlc::GetEnv("MXNET_KVSTORE_WIRE_DTYPE", std::string());
+    if (wire_dtype == "float16") {
+      wire_type_ = RequestType::kFloat16WirePushPull;
+    } else if (wire_dtype == "bfloat16") {
+      wire_type_ = RequestType::kBFloat16WirePushPull;
+    } else {
+      CHECK(wire_dtype.empty() || wire_dtype == "float32")
+        << "Unknown MXNET_KVSTORE_WIRE_DTYPE " << wire_dtype;
+    }
   }
 
   virtual ~KVStoreDist() {
     Engine::Get()->WaitForAll();
+    fusion_.reset();
     if (IsWorkerNode()) {
       if (barrier_before_exit_) {
         Barrier();
@@ -244,14 +264,26 @@ class KVStoreDist : public KVStoreLocal {
           pskv.keys, vals, &pskv.lens, cmd, [vals, cb](){ delete vals; cb(); });
       };
 
-      CHECK_NOTNULL(Engine::Get())->PushAsync(
-          pull_from_servers,
-          pinned_ctx_,
-          {},
-          {recv_buf.var()},
-          FnProperty::kNormal,
-          priority,
-          "KVStoreDistDefaultStoragePull");
+      bool fused = false;
+      if (fusion_ && gradient_compression_->get_type() == CompressionType::kNone) {
+        const int num_bytes = mshadow::mshadow_sizeof(recv_buf.dtype());
+        PSKV& pskv = EncodeDefaultKey(key, recv_buf.shape().Size(), num_bytes);
+        fused = IsFusible(pskv);
+        if (fused) PullFused(recv_buf, pskv, priority);
+      }
+      if (!fused && gradient_compression_->get_type() == CompressionType::kNone &&
+          UseWireType(recv_buf.dtype())) {
+        PullWire(key, recv_buf, priority);
+      } else if (!fused) {
+        CHECK_NOTNULL(Engine::Get())->PushAsync(
+            pull_from_servers,
+            pinned_ctx_,
+            {},
+            {recv_buf.var()},
+            FnProperty::kNormal,
+            priority,
+            "KVStoreDistDefaultStoragePull");
+      }
 
       comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
     }
@@ -336,7 +368,14 @@ class KVStoreDist : public KVStoreLocal {
       if (storage_type == kDefaultStorage) {
         if (gradient_compression_->get_type() == CompressionType::kNone) {
           PSKV& pskv = EncodeDefaultKey(key, comm_buf.shape().Size(), num_bytes);
-          PushDefault(key, comm_buf, pskv, priority);
+          if (fusion_ && IsFusible(pskv)) {
+            PushFused(comm_buf, pskv, priority);
+          } else if (do_merge && UseWireType(dtype)) {
+            // initial values keep their full precision
+            PushWire(comm_buf, pskv, priority);
+          } else {
+            PushDefault(key, comm_buf, pskv, priority);
+          }
         } else {
           CHECK_EQ(dtype, mshadow::kFloat32) << "Gradient compression is only supported for "
                                              << "float32 type of parameters";
@@ -357,7 +396,7 @@ class KVStoreDist : public KVStoreLocal {
       } else if (storage_type == kRowSparseStorage) {
         CHECK(gradient_compression_->get_type() == CompressionType::kNone)
           << "Gradient compression for row sparse storage type is not supported";
-        PushRowSparse(key, comm_buf, priority);
+        PushRowSparse(key, comm_buf, priority, !do_merge);
       } else {
         LOG(FATAL) << "unknown storage type";
       }
@@ -422,10 +461,114 @@ class KVStoreDist : public KVStoreLocal {
         "KVStoreDistDefaultPush");
   }
 
-  // push row sparse gradient
-  void PushRowSparse(int key, const NDArray &send_buf, int priority) {
+  bool IsFusible(const PSKV& pskv) const {
+    return fusion_->Fusible(pskv.size, pskv.keys.size());
+  }
+
+  // push a small key in a message shared with other keys
+  void PushFused(const NDArray& send_buf, const PSKV& pskv, int priority) {
+    const ps::Key ps_key = pskv.keys[0];
+    const int len = pskv.lens[0];
+    fusion_->Schedule(true, ps_key, send_buf.dtype(), priority);
+    auto push_to_servers = [this, ps_key, len, send_buf, priority]
+                           (RunContext rctx, Engine::CallbackOnComplete cb) {
+      char* data = static_cast<char *>(send_buf.data().dptr_);
+      fusion_->Push(ps_key, send_buf.dtype(), data, len, priority, [cb]() { cb(); });
+    };
+    Engine::Get()->PushAsync(
+        push_to_servers,
+        pinned_ctx_,
+        {send_buf.var()},
+        {},
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistFusedPush");
+  }
+
+  // pull a small key in a message shared with other keys
+  void PullFused(const NDArray& recv_buf, const PSKV& pskv, int priority) {
+    const ps::Key ps_key = pskv.keys[0];
+    const int len = pskv.lens[0];
+    fusion_->Schedule(false, ps_key, recv_buf.dtype(), priority);
+    auto pull_from_servers = [this, ps_key, len, recv_buf, priority]
+                             (RunContext rctx, Engine::CallbackOnComplete cb) {
+      char* data = static_cast<char *>(recv_buf.data().dptr_);
+      fusion_->Pull(ps_key, recv_buf.dtype(), data, len, priority, [cb]() { cb(); });
+    };
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_from_servers,
+        pinned_ctx_,
+        {},
+        {recv_buf.var()},
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistFusedPull");
+  }
+
+  bool UseWireType(int dtype) const {
+    return wire_type_ != RequestType::kDefaultPushPull && dtype == mshadow::kFloat32;
+  }
+
+  // lens of the parts of a float32 value sent as a 16 bit type
+  static ps::SArray<int> WireLens(const PSKV& pskv) {
+    ps::SArray<int> lens;
+    for (int len : pskv.lens) lens.push_back(len / 2);
+    return lens;
+  }
+
+  // push float32 values cast to the 16 bit wire type
+  void PushWire(const NDArray& send_buf, const PSKV& pskv, int priority) {
+    auto push_to_servers = [this, pskv, send_buf](RunContext rctx,
+                                                  Engine::CallbackOnComplete cb) {
+      const size_t size = send_buf.shape().Size();
+      ps::SArray<char> vals(size * sizeof(uint16_t));
+      CastToWire(send_buf.data().dptr<float>(), vals.data(), size,
+                 wire_type_ == RequestType::kBFloat16WirePushPull);
+      const int cmd = GetCommandType(wire_type_, send_buf.dtype());
+      CHECK_NOTNULL(ps_worker_)->ZPush(pskv.keys, vals, WireLens(pskv), cmd, [cb]() { cb(); });
+    };
+    Engine::Get()->PushAsync(
+        push_to_servers,
+        pinned_ctx_,
+        {send_buf.var()},
+        {},
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistWirePush");
+  }
+
+  // pull float32 values sent as the 16 bit wire type
+  void PullWire(int key, const NDArray& recv_buf, int priority) {
+    auto pull_from_servers = [this, key, recv_buf](RunContext rctx,
+                                                   Engine::CallbackOnComplete cb) {
+      const size_t size = recv_buf.shape().Size();
+      PSKV& pskv = EncodeDefaultKey(key, size, sizeof(float));
+      auto vals = new ps::SArray<char>(size * sizeof(uint16_t));
+      auto lens = new ps::SArray<int>(WireLens(pskv));
+      const bool bfloat16 = wire_type_ == RequestType::kBFloat16WirePushPull;
+      const int cmd = GetCommandType(wire_type_, recv_buf.dtype());
+      CHECK_NOTNULL(ps_worker_)->ZPull(pskv.keys, vals, lens, cmd,
+                                       [vals, lens, recv_buf, size, bfloat16, cb]() {
+          CastFromWire(vals->data(), recv_buf.data().dptr<float>(), size, bfloat16);
+          delete vals;
+          delete lens;
+          cb();
+        });
+    };
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_from_servers,
+        pinned_ctx_,
+        {},
+        {recv_buf.var()},
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistWirePull");
+  }
+
+  // push row sparse gradient, or the initial value if init is true
+  void PushRowSparse(int key, const NDArray &send_buf, int priority, bool init = false) {
     using namespace rowsparse;
-    auto push_to_servers = [this, key, send_buf]
+    auto push_to_servers = [this, key, send_buf, init]
                            (RunContext rctx, Engine::CallbackOnComplete cb) {
       char* data = static_cast<char *>(send_buf.data().dptr_);
       const int64_t num_rows = send_buf.aux_shape(kIdx)[0];
@@ -442,6 +585,20 @@ class KVStoreDist : public KVStoreLocal {
       }
       ps::SArray<char> vals(data, size * num_bytes, false);
       const int cmd = GetCommandType(RequestType::kRowSparsePushPull, send_buf.dtype());
+      if (init && num_rows == 0) {
+        // servers creating rows on demand learn the row length from the offset
+        // of a key without data following each master key
+        ps::SArray<ps::Key> keys;
+        ps::SArray<int> lens;
+        for (const auto master_key : pskv.keys) {
+          keys.push_back(master_key);
+          keys.push_back(master_key + unit_len);
+          lens.push_back(0);
+          lens.push_back(0);
+        }
+        CHECK_NOTNULL(ps_worker_)->ZPush(keys, vals, lens, cmd, [cb]() { cb(); });
+        return;
+      }
       CHECK_NOTNULL(ps_worker_)->ZPush(pskv.keys, vals, pskv.lens, cmd, [cb]() { cb(); });
     };
     Engine::Get()->PushAsync(
@@ -616,19 +773,22 @@ class KVStoreDist : public KVStoreLocal {
         push_pskv.size = compr_size;
         pull_pskv.size = original_size;
       } else {
-        // partition it to all servers
+        // partition it to all servers, between blocks which are decompressed on their own
         push_pskv.size = 0;
         pull_pskv.size = 0;
+        const size_t block = gradient_compression_->GetCompressedBlockSize();
+        const size_t num_blocks = (compr_num_elem + block - 1) / block;
+        const int num_parts = std::min(static_cast<size_t>(num_servers), num_blocks);
 
-        for (int i = 0; i < num_servers; ++i) {
+        for (int i = 0; i < num_parts; ++i) {
           size_t part_compr, part_orig;
-          if (i == num_servers-1) {
+          if (i == num_parts-1) {
             part_compr = compr_num_elem - push_pskv.size;
             part_orig = original_num_elem - pull_pskv.size;
           } else {
-            part_compr =
-              static_cast<size_t> (round(static_cast<double>(compr_num_elem)/num_servers*(i+1))) -
-              static_cast<size_t> (round(static_cast<double>(compr_num_elem)/num_servers*(i)));
+            part_compr = block * (
+              static_cast<size_t> (round(static_cast<double>(num_blocks)/num_parts*(i+1))) -
+              static_cast<size_t> (round(static_cast<double>(num_blocks)/num_parts*(i))));
             part_orig = part_compr * gradient_compression_->GetCompressionFactor();
           }
 
@@ -751,6 +911,15 @@ class KVStoreDist : public KVStoreLocal {
    */
   std::unordered_map<int, NDArray> residual_;
   bool log_verbose_;
+  /**
+   * \brief packs pushes and pulls of small keys, nullptr if disabled
+   */
+  std::unique_ptr<KVStoreDistFusion> fusion_;
+  /**
+   * \brief request type of float32 values sent as 16 bit types,
+   *  kDefaultPushPull to send them as they are
+   */
+  RequestType wire_type_ = RequestType::kDefaultPushPull;
 };
 
 }  // namespace kvstore
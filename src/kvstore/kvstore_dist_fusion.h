@@ -0,0 +1,239 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Copyright (c) 2018 by Contributors
+ * @file   kvstore_dist_fusion.h
+ * @brief  packs pushes and pulls of small keys into one message per server
+ */
+#ifndef MXNET_KVSTORE_KVSTORE_DIST_FUSION_H_
+#define MXNET_KVSTORE_KVSTORE_DIST_FUSION_H_
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "ps/ps.h"
+#include "./kvstore_dist_server.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief collects the pushes and pulls of small keys to the same server into
+ *  buckets, each of them sent as one message.
+ *
+ * A bucket is sent when it holds bucket_bytes, when none of the requests still
+ * queued in the engine for it has the same or a higher priority than the
+ * request just added, or when its oldest request waited for timeout_us.
+ * Requests are added in the order the engine runs them, so the priorities of
+ * the engine decide which keys travel first.
+ */
+class KVStoreDistFusion {
+ public:
+  typedef std::function<void()> Callback;
+
+  KVStoreDistFusion(ps::KVWorker<char>* worker, size_t key_bytes,
+                    size_t bucket_bytes, int timeout_us)
+    : worker_(worker), key_bytes_(key_bytes), bucket_bytes_(bucket_bytes),
+      timeout_(timeout_us) {
+    timer_ = std::thread([this]() { FlushExpired(); });
+  }
+
+  ~KVStoreDistFusion() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    timer_.join();
+  }
+
+  /**
+   * \brief whether a value of num_bytes stored under the given ps keys is fused
+   */
+  bool Fusible(size_t num_bytes, size_t num_ps_keys) const {
+    return num_bytes < key_bytes_ && num_ps_keys == 1;
+  }
+
+  /**
+   * \brief announce a request which the engine will add later
+   */
+  void Schedule(bool push, ps::Key key, int dtype, int priority) {
+    std::lock_guard<std::mutex> lk(mu_);
+    buckets_[MakeBucketId(push, key, dtype)].scheduled.insert(priority);
+  }
+
+  /**
+   * \brief add a push of len bytes at data. cb is called once the server
+   *  received it, data must not change before.
+   */
+  void Push(ps::Key key, int dtype, char* data, int len, int priority, const Callback& cb) {
+    Add(true, key, dtype, data, len, priority, cb);
+  }
+
+  /**
+   * \brief add a pull of len bytes into data, cb is called once data is filled
+   */
+  void Pull(ps::Key key, int dtype, char* data, int len, int priority, const Callback& cb) {
+    Add(false, key, dtype, data, len, priority, cb);
+  }
+
+ private:
+  /*! \brief whether the bucket pushes, the server and the data type */
+  typedef std::tuple<bool, int, int> BucketId;
+
+  struct Request {
+    ps::Key key;
+    char* data;
+    int len;
+    Callback cb;
+  };
+
+  struct Bucket {
+    std::vector<Request> requests;
+    size_t bytes = 0;
+    /*! \brief priorities of the requests queued in the engine and not added yet */
+    std::multiset<int> scheduled;
+    std::chrono::steady_clock::time_point oldest;
+  };
+
+  static BucketId MakeBucketId(bool push, ps::Key key, int dtype) {
+    const auto& krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    int server = 0;
+    while (server + 1 < static_cast<int>(krs.size()) && key >= krs[server].end()) ++server;
+    return std::make_tuple(push, server, dtype);
+  }
+
+  void Add(bool push, ps::Key key, int dtype, char* data, int len, int priority,
+           const Callback& cb) {
+    std::vector<Request> full, ready;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      Bucket& bucket = buckets_[MakeBucketId(push, key, dtype)];
+      auto it = bucket.scheduled.find(priority);
+      if (it != bucket.scheduled.end()) bucket.scheduled.erase(it);
+      // a key appears at most once per message
+      for (const auto& r : bucket.requests) {
+        if (r.key == key) {
+          full = Take(&bucket);
+          break;
+        }
+      }
+      if (bucket.requests.empty()) bucket.oldest = std::chrono::steady_clock::now();
+      bucket.requests.push_back(Request{key, data, len, cb});
+      bucket.bytes += len;
+      if (bucket.bytes >= bucket_bytes_ || bucket.scheduled.empty() ||
+          *bucket.scheduled.rbegin() < priority) {
+        ready = Take(&bucket);
+      }
+    }
+    Send(push, dtype, std::move(full));
+    Send(push, dtype, std::move(ready));
+  }
+
+  static std::vector<Request> Take(Bucket* bucket) {
+    std::vector<Request> requests;
+    requests.swap(bucket->requests);
+    bucket->bytes = 0;
+    return requests;
+  }
+
+  void Send(bool push, int dtype, std::vector<Request>&& requests) {
+    if (requests.empty()) return;
+    // ps-lite expects increasing keys
+    std::sort(requests.begin(), requests.end(),
+              [](const Request& a, const Request& b) { return a.key < b.key; });
+    ps::SArray<ps::Key> keys;
+    ps::SArray<int> lens;
+    size_t total = 0;
+    for (const auto& r : requests) {
+      keys.push_back(r.key);
+      lens.push_back(r.len);
+      total += r.len;
+    }
+    const int cmd = GetCommandType(RequestType::kFusedPushPull, dtype);
+    auto shared = std::make_shared<std::vector<Request> >(std::move(requests));
+    if (push) {
+      ps::SArray<char> vals(total);
+      size_t offset = 0;
+      for (const auto& r : *shared) {
+        std::memcpy(vals.data() + offset, r.data, r.len);
+        offset += r.len;
+      }
+      worker_->ZPush(keys, vals, lens, cmd, [shared]() {
+          for (const auto& r : *shared) r.cb();
+        });
+    } else {
+      auto vals = new ps::SArray<char>(total);
+      auto pull_lens = new ps::SArray<int>(lens);
+      worker_->ZPull(keys, vals, pull_lens, cmd, [shared, vals, pull_lens]() {
+          size_t offset = 0;
+          for (const auto& r : *shared) {
+            std::memcpy(r.data, vals->data() + offset, r.len);
+            offset += r.len;
+          }
+          delete vals;
+          delete pull_lens;
+          for (const auto& r : *shared) r.cb();
+        });
+    }
+  }
+
+  void FlushExpired() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!stop_) {
+      cond_.wait_for(lk, timeout_);
+      const auto now = std::chrono::steady_clock::now();
+      std::vector<std::pair<BucketId, std::vector<Request> > > expired;
+      for (auto& kv : buckets_) {
+        if (!kv.second.requests.empty() && now - kv.second.oldest >= timeout_) {
+          expired.emplace_back(kv.first, Take(&kv.second));
+        }
+      }
+      lk.unlock();
+      for (auto& e : expired) {
+        Send(std::get<0>(e.first), std::get<2>(e.first), std::move(e.second));
+      }
+      lk.lock();
+    }
+  }
+
+  ps::KVWorker<char>* worker_;
+  size_t key_bytes_;
+  size_t bucket_bytes_;
+  std::chrono::microseconds timeout_;
+  std::map<BucketId, Bucket> buckets_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  bool stop_ = false;
+  std::thread timer_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KVSTORE_DIST_FUSION_H_
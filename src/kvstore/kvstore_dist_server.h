@@ -24,6 +24,11 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <map>
 #include <queue>
 #include <string>
 #include <mutex>
@@ -31,11 +36,18 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 #include "ps/ps.h"
+#include "dmlc/io.h"
 #include "mxnet/kvstore.h"
 #include "../operator/tensor/elemwise_binary_op-inl.h"
 #include "../operator/tensor/init_op.h"
+#include "./row_sparse_hash_store.h"
+#include "./wire_dtype.h"
 
 namespace mxnet {
 namespace kvstore {
@@ -43,10 +55,12 @@ namespace kvstore {
 // maintain same order in frontend.
 enum class CommandType {
   kController, kSetMultiPrecision, kStopServer, kSyncMode, kSetGradientCompression,
+  kSaveSnapshot, kWaitSnapshot,
 };
 
 enum class RequestType {
-  kDefaultPushPull, kRowSparsePushPull, kCompressedPushPull
+  kDefaultPushPull, kRowSparsePushPull, kCompressedPushPull, kFusedPushPull,
+  kFloat16WirePushPull, kBFloat16WirePushPull
 };
 
 struct DataHandleType {
@@ -148,6 +162,119 @@ class Executor {
   std::condition_variable cond_;
 };
 
+/**
+ * \brief runs functions on a pool of threads. Functions pushed to the same
+ *  shard run on the same thread in the order they were pushed.
+ */
+class ShardedExecutor {
+ public:
+  explicit ShardedExecutor(size_t num_shards) {
+    CHECK_GT(num_shards, 0U);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards_.emplace_back(new Shard());
+      Shard* shard = shards_.back().get();
+      shard->thread = std::thread([this, shard]() { Run(shard); });
+    }
+  }
+
+  ~ShardedExecutor() {
+    for (auto& shard : shards_) {
+      {
+        std::lock_guard<std::mutex> lk(shard->mu);
+        shard->stop = true;
+      }
+      shard->cond.notify_one();
+    }
+    for (auto& shard : shards_) shard->thread.join();
+  }
+
+  size_t num_shards() const {
+    return shards_.size();
+  }
+
+  /**
+   * \brief queue a function on a shard without waiting for it. threadsafe
+   */
+  void Push(size_t shard_id, Executor::Func func) {
+    {
+      std::lock_guard<std::mutex> lk(pending_mu_);
+      ++pending_;
+    }
+    Shard* shard = shards_[shard_id % shards_.size()].get();
+    {
+      std::lock_guard<std::mutex> lk(shard->mu);
+      shard->queue.push(std::move(func));
+    }
+    shard->cond.notify_one();
+  }
+
+  /**
+   * \brief block until all pushed functions finished
+   */
+  void WaitAll() {
+    std::unique_lock<std::mutex> lk(pending_mu_);
+    pending_cond_.wait(lk, [this]{return pending_ == 0;});
+  }
+
+ private:
+  struct Shard {
+    std::queue<Executor::Func> queue;
+    std::mutex mu;
+    std::condition_variable cond;
+    bool stop = false;
+    std::thread thread;
+  };
+
+  void Run(Shard* shard) {
+    while (true) {
+      Executor::Func func;
+      {
+        std::unique_lock<std::mutex> lk(shard->mu);
+        shard->cond.wait(lk, [shard]{return shard->stop || !shard->queue.empty();});
+        if (shard->queue.empty()) return;
+        func = std::move(shard->queue.front());
+        shard->queue.pop();
+      }
+      func();
+      std::lock_guard<std::mutex> lk(pending_mu_);
+      if (--pending_ == 0) pending_cond_.notify_all();
+    }
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  size_t pending_ = 0;
+  std::mutex pending_mu_;
+  std::condition_variable pending_cond_;
+};
+
+/**
+ * \brief map from keys to values which may be looked up and inserted from
+ *  several threads. As with std::unordered_map, references to the values stay valid.
+ */
+template<typename V>
+class KeyValueMap {
+ public:
+  typedef typename std::unordered_map<int, V>::iterator iterator;
+
+  V& operator[](int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    return map_[key];
+  }
+  /**
+   * \brief iteration is not threadsafe
+   */
+  iterator begin() {
+    return map_.begin();
+  }
+  iterator end() {
+    return map_.end();
+  }
+
+ private:
+  std::unordered_map<int, V> map_;
+  std::mutex mu_;
+};
+
 class KVStoreDistServer {
  public:
   KVStoreDistServer() {
@@ -160,10 +287,20 @@ class KVStoreDistServer {
     sync_mode_ = false;
     gradient_compression_ = std::make_shared<GradientCompression>();
     log_verbose_ = dmlc::GetEnv("MXNET_KVSTORE_DIST_ROW_SPARSE_VERBOSE", false);
+    const int num_threads = dmlc::GetEnv("MXNET_KVSTORE_SERVER_UPDATE_THREADS", 0);
+    if (num_threads > 0) update_exec_.reset(new ShardedExecutor(num_threads));
+    sparse_store_ = dmlc::GetEnv("MXNET_KVSTORE_SERVER_SPARSE_STORE", false);
+    sparse_store_init_ = RowInitializer::Parse(
+        dmlc::GetEnv("MXNET_KVSTORE_SERVER_SPARSE_STORE_INIT", std::string("zeros")));
+    sparse_store_max_rows_ = dmlc::GetEnv("MXNET_KVSTORE_SERVER_SPARSE_STORE_MAX_ROWS", 0);
+    staleness_ = dmlc::GetEnv("MXNET_KVSTORE_STALENESS", -1);
+    restore_prefix_ = dmlc::GetEnv("MXNET_KVSTORE_SERVER_RESTORE", std::string());
   }
 
   ~KVStoreDistServer() {
     delete ps_server_;
+    update_exec_.reset();
+    if (snapshot_thread_.joinable()) snapshot_thread_.join();
   }
 
   void set_controller(const KVStore::Controller& controller) {
@@ -184,6 +321,14 @@ class KVStoreDistServer {
   }
 
  private:
+  struct FusedRequest {
+    ps::SArray<ps::Key> keys;
+    /*! \brief number of keys not answered yet */
+    size_t num_pending;
+    /*! \brief the pulled value of each key */
+    std::vector<ps::SArray<char> > vals;
+  };
+
   struct UpdateBuf {
     std::vector<ps::KVMeta> request;
     NDArray merged;
@@ -191,14 +336,63 @@ class KVStoreDistServer {
     NDArray temp_array;
   };
 
+  /**
+   * \brief row_sparse gradients pushed for a key of the sparse store, summed by row
+   */
+  struct SparseUpdateBuf {
+    std::vector<ps::KVMeta> request;
+    std::vector<int64_t> rows;
+    std::vector<float> grads;
+    /*! \brief position of each row in rows */
+    std::unordered_map<int64_t, size_t> pos;
+  };
+
+  /**
+   * \brief pull waiting for the slowest worker in bounded staleness mode
+   */
+  struct PendingPull {
+    DataHandleType type;
+    ps::KVMeta req_meta;
+    ps::KVPairs<char> req_data;
+    /*! \brief the number of pushes of every worker needed to answer it */
+    int clock;
+    std::chrono::steady_clock::time_point since;
+  };
+
+  /**
+   * \brief number of pushes of a key by each worker, and the pulls waiting for them
+   */
+  struct WorkerClock {
+    std::unordered_map<int, int> clocks;
+    std::vector<PendingPull> pulls;
+  };
+
+  /**
+   * \brief time the pulls of a worker waited in bounded staleness mode
+   */
+  struct BlockedStats {
+    size_t pulls = 0;
+    double seconds = 0;
+    double max_seconds = 0;
+  };
+
   void CommandHandle(const ps::SimpleData& recved, ps::SimpleApp* app) {
+    // commands change the state shared by all keys
+    if (update_exec_) update_exec_->WaitAll();
     CommandType recved_type = static_cast<CommandType>(recved.head);
     if (recved_type == CommandType::kStopServer) {
+      if (staleness_ >= 0 && !sync_mode_) LogBlockedStats();
       exec_.Stop();
     } else if (recved_type == CommandType::kSyncMode) {
       sync_mode_ = true;
+      LOG_IF(WARNING, staleness_ >= 0) << "MXNET_KVSTORE_STALENESS is ignored in sync mode";
     } else if (recved_type == CommandType::kSetGradientCompression) {
       gradient_compression_->DecodeParams(recved.body);
+    } else if (recved_type == CommandType::kSaveSnapshot) {
+      SaveSnapshot(recved.body);
+    } else if (recved_type == CommandType::kWaitSnapshot) {
+      // replies once the last snapshot is written
+      if (snapshot_thread_.joinable()) snapshot_thread_.join();
     } else if (recved_type == CommandType::kSetMultiPrecision) {
       // uses value 1 for message id from frontend
       if (!multi_precision_) {
@@ -258,10 +452,155 @@ class KVStoreDistServer {
     }
   }
 
+  static std::string SnapshotFile(const std::string& prefix) {
+    return prefix + "-server-" + std::to_string(ps::MyRank()) + ".params";
+  }
+
+  /**
+   * \brief save the values of this server to a file in the background. The values
+   *  are copied first, so that updates only wait for the copies and not for the disk.
+   */
+  void SaveSnapshot(const std::string& prefix) {
+    std::vector<std::string> names;
+    std::vector<NDArray> copies;
+    for (const auto& kv : store_) {
+      if (kv.second.is_none()) continue;
+      // the float32 values of multi precision mode
+      const NDArray& stored = multi_precision_ && kv.second.dtype() != mshadow::kFloat32 ?
+                              store_realt_[kv.first] : kv.second;
+      names.push_back(std::to_string(kv.first));
+      copies.push_back(stored.Copy(Context()));
+    }
+    for (const auto& kv : sparse_stores_) {
+      if (!kv.second) continue;
+      names.push_back(std::to_string(kv.first));
+      copies.push_back(SparseStoreRows(*kv.second));
+    }
+    // one snapshot at a time
+    if (snapshot_thread_.joinable()) snapshot_thread_.join();
+    const std::string file = SnapshotFile(prefix);
+    snapshot_thread_ = std::thread([file, names, copies]() {
+        // a failed snapshot must not take the server down with it
+        try {
+          for (const auto& copy : copies) copy.WaitToRead();
+          // complete files only, unless the file system has no rename
+          const bool local = file.find("://") == std::string::npos;
+          const std::string tmp = local ? file + ".tmp" : file;
+          {
+            std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(tmp.c_str(), "w"));
+            NDArray::Save(fo.get(), copies, names);
+          }
+          if (local) {
+            CHECK_EQ(std::rename(tmp.c_str(), file.c_str()), 0) << "Failed to rename " << tmp;
+          }
+          LOG(INFO) << "Saved " << copies.size() << " values to " << file;
+        } catch (const std::exception& e) {
+          LOG(ERROR) << "Failed to save the snapshot " << file << ": " << e.what();
+        }
+      });
+  }
+
+  /**
+   * \brief the rows of a sparse store as a row_sparse array, of which the number
+   *  of rows is one past the largest row stored
+   */
+  static NDArray SparseStoreRows(const RowSparseHashStore& table) {
+    std::vector<int64_t> ids;
+    std::vector<float> values;
+    table.Dump(&ids, &values);
+    const size_t row_len = table.row_len();
+    const TShape shape = mshadow::Shape2(ids.empty() ? 1 : ids.back() + 1, row_len);
+    NDArray rows(kRowSparseStorage, shape, Context(), true, mshadow::kFloat32);
+    rows.CheckAndAlloc({mshadow::Shape1(ids.size())});
+    std::copy(ids.begin(), ids.end(), rows.aux_data(rowsparse::kIdx).dptr<int64_t>());
+    std::copy(values.begin(), values.end(), rows.data().dptr<float>());
+    return rows;
+  }
+
+  /**
+   * \brief put the rows of the key saved in the snapshot, if any, into a sparse
+   *  store being initialized
+   */
+  void RestoreRows(int key, RowSparseHashStore* table) {
+    const NDArray* restored = RestoredValue(key);
+    if (restored == nullptr) return;
+    CHECK_EQ(restored->storage_type(), kRowSparseStorage)
+      << "The value of key " << key << " in the snapshot was not saved with "
+      << "MXNET_KVSTORE_SERVER_SPARSE_STORE";
+    CHECK_EQ(restored->dtype(), mshadow::kFloat32);
+    const size_t row_len = table->row_len();
+    CHECK_EQ(restored->shape()[1], row_len)
+      << "The rows of key " << key << " in the snapshot have another length";
+    const size_t num_rows = restored->aux_shape(rowsparse::kIdx)[0];
+    const int64_t* ids = restored->aux_data(rowsparse::kIdx).dptr<int64_t>();
+    const float* values = restored->data().dptr<float>();
+    for (size_t i = 0; i < num_rows; ++i) {
+      std::memcpy(table->Row(ids[i]), values + i * row_len, row_len * sizeof(float));
+    }
+    table->EvictCold();
+  }
+
+  /**
+   * \brief the value of the key saved in the snapshot of MXNET_KVSTORE_SERVER_RESTORE,
+   *  nullptr if there is none
+   */
+  const NDArray* RestoredValue(int key) {
+    if (restore_prefix_.empty()) return nullptr;
+    std::call_once(restore_once_, [this]() {
+        const std::string file = SnapshotFile(restore_prefix_);
+        std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(file.c_str(), "r"));
+        std::vector<NDArray> data;
+        std::vector<std::string> names;
+        NDArray::Load(fi.get(), &data, &names);
+        CHECK_EQ(data.size(), names.size()) << file << " misses the keys";
+        for (size_t i = 0; i < data.size(); ++i) restored_[std::stoi(names[i])] = data[i];
+        LOG(INFO) << "Restoring " << data.size() << " values from " << file;
+      });
+    auto it = restored_.find(key);
+    return it == restored_.end() ? nullptr : &it->second;
+  }
+
+  /**
+   * \brief overwrite a value being initialized with the restored one, if any
+   */
+  void Restore(int key, NDArray* stored) {
+    const NDArray* restored = RestoredValue(key);
+    if (restored == nullptr) return;
+    CHECK_EQ(restored->shape(), stored->shape())
+      << "The value of key " << key << " in the snapshot has another shape, "
+      << "was it saved with other servers, MXNET_KVSTORE_BIGARRAY_BOUND "
+      << "or MXNET_KVSTORE_SERVER_SPARSE_STORE?";
+    CHECK_EQ(restored->storage_type(), stored->storage_type());
+    CopyFromTo(*restored, stored);
+  }
+
   void DataHandleEx(const ps::KVMeta& req_meta,
                     const ps::KVPairs<char>& req_data,
                     ps::KVServer<char>* server) {
     DataHandleType type = DepairDataHandleType(req_meta.cmd);
+    if (type.requestType == RequestType::kFusedPushPull) {
+      DataHandleFused(type, req_meta, req_data, server);
+    } else if (update_exec_) {
+      // requests of a key are handled in order by the thread of its shard,
+      // the copies of req_data share the received buffers
+      const int key = RequestKey(type, req_meta, req_data);
+      update_exec_->Push(key, [this, type, req_meta, req_data, server]() {
+          DataHandle(type, req_meta, req_data, server);
+        });
+    } else {
+      DataHandle(type, req_meta, req_data, server);
+    }
+  }
+
+  void DataHandle(const DataHandleType type,
+                  const ps::KVMeta& req_meta,
+                  const ps::KVPairs<char>& req_data,
+                  ps::KVServer<char>* server) {
+    // the pushes of keys not initialized yet are not counted
+    const bool bounded = staleness_ >= 0 && !sync_mode_;
+    if (bounded && !req_meta.push && !PullReady(type, req_meta, req_data)) return;
+    const bool tick = bounded && req_meta.push &&
+                      Initialized(type, RequestKey(type, req_meta, req_data));
     switch (type.requestType) {
       case RequestType::kRowSparsePushPull:
         DataHandleRowSparse(type, req_meta, req_data, server);
@@ -272,7 +611,214 @@ class KVStoreDistServer {
       case RequestType::kDefaultPushPull:
         DataHandleDefault(type, req_meta, req_data, server);
         break;
+      case RequestType::kFusedPushPull:
+        DataHandleFused(type, req_meta, req_data, server);
+        break;
+      case RequestType::kFloat16WirePushPull:
+      case RequestType::kBFloat16WirePushPull:
+        DataHandleWire(type, req_meta, req_data, server);
+        break;
+    }
+    if (tick) Tick(RequestKey(type, req_meta, req_data), req_meta.sender, server);
+  }
+
+  /**
+   * \brief the key whose value a request reads or writes
+   */
+  int RequestKey(const DataHandleType type, const ps::KVMeta& req_meta,
+                 const ps::KVPairs<char>& req_data) {
+    // compressed pushes start with a key holding the original size
+    const bool compressed_push = type.requestType == RequestType::kCompressedPushPull &&
+                                 req_meta.push;
+    return DecodeKey(req_data.keys[compressed_push ? 1 : 0]);
+  }
+
+  bool Initialized(const DataHandleType type, int key) {
+    if (sparse_store_ && type.requestType == RequestType::kRowSparsePushPull) {
+      return sparse_stores_[key] != nullptr;
+    }
+    return !store_[key].is_none();
+  }
+
+  /**
+   * \brief the number of pushes of the key by the slowest worker
+   */
+  int MinClock(const WorkerClock& clock) {
+    if (clock.clocks.size() < static_cast<size_t>(ps::NumWorkers())) return 0;
+    int min_clock = INT_MAX;
+    for (const auto& kv : clock.clocks) min_clock = std::min(min_clock, kv.second);
+    return min_clock;
+  }
+
+  /**
+   * \brief whether a pull may be answered in bounded staleness mode, that is
+   *  whether every worker pushed the key at least as often as the puller, minus
+   *  the staleness. Otherwise the pull is kept until they did.
+   */
+  bool PullReady(const DataHandleType type, const ps::KVMeta& req_meta,
+                 const ps::KVPairs<char>& req_data) {
+    WorkerClock& clock = clocks_[RequestKey(type, req_meta, req_data)];
+    const int needed = clock.clocks[req_meta.sender] - staleness_;
+    if (MinClock(clock) >= needed) return true;
+    if (log_verbose_) {
+      LOG(INFO) << "pull of " << req_data.keys[0] << " by " << req_meta.sender
+                << " waits for clock " << needed;
+    }
+    clock.pulls.push_back(PendingPull{type, req_meta, req_data, needed,
+                                      std::chrono::steady_clock::now()});
+    return false;
+  }
+
+  /**
+   * \brief count a push of the key by sender, and answer the pulls it unblocks
+   */
+  void Tick(int key, int sender, ps::KVServer<char>* server) {
+    WorkerClock& clock = clocks_[key];
+    ++clock.clocks[sender];
+    const int min_clock = MinClock(clock);
+    auto ready = std::partition(clock.pulls.begin(), clock.pulls.end(),
+                                [min_clock](const PendingPull& p) { return p.clock > min_clock; });
+    std::vector<PendingPull> pulls(std::make_move_iterator(ready),
+                                   std::make_move_iterator(clock.pulls.end()));
+    clock.pulls.erase(ready, clock.pulls.end());
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& pull : pulls) {
+      const double seconds = std::chrono::duration<double>(now - pull.since).count();
+      {
+        std::lock_guard<std::mutex> lk(blocked_mu_);
+        BlockedStats& stats = blocked_stats_[pull.req_meta.sender];
+        ++stats.pulls;
+        stats.seconds += seconds;
+        stats.max_seconds = std::max(stats.max_seconds, seconds);
+      }
+      DataHandle(pull.type, pull.req_meta, pull.req_data, server);
+    }
+  }
+
+  void LogBlockedStats() {
+    std::lock_guard<std::mutex> lk(blocked_mu_);
+    for (const auto& kv : blocked_stats_) {
+      LOG(INFO) << "server " << ps::MyRank() << ": " << kv.second.pulls << " pulls of node "
+                << kv.first << " waited for slower workers, " << kv.second.seconds
+                << " seconds in total, " << kv.second.max_seconds << " seconds at most";
+    }
+  }
+
+  /**
+   * \brief widen the 16 bit values of a push to float32 and handle it like a
+   *  default request. The values of pulls are narrowed in \ref Response.
+   */
+  void DataHandleWire(const DataHandleType type, const ps::KVMeta& req_meta,
+                      const ps::KVPairs<char>& req_data,
+                      ps::KVServer<char>* server) {
+    CHECK_EQ(type.dtype, mshadow::kFloat32)
+      << "Only float32 values are sent as 16 bit types";
+    const DataHandleType default_type{RequestType::kDefaultPushPull, type.dtype};
+    if (!req_meta.push) {
+      DataHandleDefault(default_type, req_meta, req_data, server);
+      return;
+    }
+    const size_t num = req_data.vals.size() / sizeof(uint16_t);
+    ps::KVPairs<char> widened;
+    widened.keys = req_data.keys;
+    for (int len : req_data.lens) widened.lens.push_back(len * 2);
+    widened.vals.resize(num * sizeof(float));
+    CastFromWire(req_data.vals.data(), reinterpret_cast<float*>(widened.vals.data()), num,
+                 type.requestType == RequestType::kBFloat16WirePushPull);
+    DataHandleDefault(default_type, req_meta, widened, server);
+  }
+
+  /**
+   * \brief split a request for several small keys, packed by the worker, into
+   *  one request per key. It is answered once all of its keys are answered.
+   */
+  void DataHandleFused(const DataHandleType type, const ps::KVMeta& req_meta,
+                       const ps::KVPairs<char>& req_data,
+                       ps::KVServer<char>* server) {
+    const size_t num_keys = req_data.keys.size();
+    CHECK_GT(num_keys, 0U);
+    if (req_meta.push) CHECK_EQ(req_data.lens.size(), num_keys);
+    {
+      std::lock_guard<std::mutex> lk(fused_mu_);
+      FusedRequest& fused = fused_requests_[FusedRequestId(req_meta)];
+      fused.keys = req_data.keys;
+      fused.num_pending = num_keys;
+      fused.vals.resize(num_keys);
+    }
+    const DataHandleType key_type{RequestType::kDefaultPushPull, type.dtype};
+    size_t offset = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+      ps::KVPairs<char> key_data;
+      key_data.keys = req_data.keys.segment(i, i + 1);
+      if (req_meta.push) {
+        key_data.lens = req_data.lens.segment(i, i + 1);
+        key_data.vals = req_data.vals.segment(offset, offset + req_data.lens[i]);
+        offset += req_data.lens[i];
+      }
+      if (update_exec_) {
+        update_exec_->Push(DecodeKey(key_data.keys[0]),
+                           [this, key_type, req_meta, key_data, server]() {
+            DataHandle(key_type, req_meta, key_data, server);
+          });
+      } else {
+        DataHandle(key_type, req_meta, key_data, server);
+      }
+    }
+  }
+
+  static std::tuple<int, int, int> FusedRequestId(const ps::KVMeta& req_meta) {
+    return std::make_tuple(req_meta.sender, req_meta.customer_id, req_meta.timestamp);
+  }
+
+  /**
+   * \brief respond to a request, or to one key of a fused request. The pulled
+   *  values of requests sent as 16 bit types are narrowed to them.
+   */
+  void Response(ps::KVServer<char>* server, const ps::KVMeta& req_meta,
+                const ps::KVPairs<char>& res = ps::KVPairs<char>()) {
+    const RequestType request_type = DepairDataHandleType(req_meta.cmd).requestType;
+    if (!req_meta.push && (request_type == RequestType::kFloat16WirePushPull ||
+                           request_type == RequestType::kBFloat16WirePushPull)) {
+      const size_t num = res.vals.size() / sizeof(float);
+      ps::KVPairs<char> narrowed;
+      narrowed.keys = res.keys;
+      for (int len : res.lens) narrowed.lens.push_back(len / 2);
+      narrowed.vals.resize(num * sizeof(uint16_t));
+      CastToWire(reinterpret_cast<const float*>(res.vals.data()), narrowed.vals.data(), num,
+                 request_type == RequestType::kBFloat16WirePushPull);
+      server->Response(req_meta, narrowed);
+      return;
+    }
+    if (request_type != RequestType::kFusedPushPull) {
+      server->Response(req_meta, res);
+      return;
+    }
+    std::lock_guard<std::mutex> lk(fused_mu_);
+    auto it = fused_requests_.find(FusedRequestId(req_meta));
+    CHECK(it != fused_requests_.end()) << "Unknown fused request from " << req_meta.sender;
+    FusedRequest& fused = it->second;
+    if (!req_meta.push) {
+      CHECK_EQ(res.keys.size(), 1U);
+      const ps::Key* pos = std::lower_bound(fused.keys.begin(), fused.keys.end(), res.keys[0]);
+      CHECK(pos != fused.keys.end() && *pos == res.keys[0]);
+      fused.vals[pos - fused.keys.begin()] = res.vals;
+    }
+    if (--fused.num_pending > 0) return;
+    ps::KVPairs<char> response;
+    if (!req_meta.push) {
+      size_t total = 0;
+      for (const auto& vals : fused.vals) total += vals.size();
+      response.keys = fused.keys;
+      response.vals.resize(total);
+      size_t offset = 0;
+      for (const auto& vals : fused.vals) {
+        response.lens.push_back(vals.size());
+        std::copy(vals.begin(), vals.end(), response.vals.begin() + offset);
+        offset += vals.size();
+      }
     }
+    server->Response(req_meta, response);
+    fused_requests_.erase(it);
   }
 
   inline bool has_multi_precision_copy(const DataHandleType type) {
@@ -300,7 +846,7 @@ class KVStoreDistServer {
         LOG(INFO) << "sent response to " << update_buf->request.size() << " workers";
       }
       for (const auto& req : update_buf->request) {
-        server->Response(req);
+        Response(server, req);
       }
       update_buf->request.clear();
       if (has_multi_precision_copy(type)) CopyFromTo(stored, store_[key]);
@@ -354,7 +900,7 @@ class KVStoreDistServer {
       std::vector<int> lens(req_data.keys.size(), 0);
       response.keys = req_data.keys;
       response.lens.CopyFrom(lens.begin(), lens.end());
-      server->Response(req_meta, response);
+      Response(server, req_meta, response);
       return;
     }
     const NDArray& stored = store_[master_key];
@@ -382,7 +928,7 @@ class KVStoreDistServer {
     std::vector<int> lens(req_data.keys.size(), unit_len);
     lens[0] = 0;
     response.lens.CopyFrom(lens.begin(), lens.end());
-    server->Response(req_meta, response);
+    Response(server, req_meta, response);
   }
 
   void InitRowSparseStored(const DataHandleType type,
@@ -426,17 +972,22 @@ class KVStoreDistServer {
       on_complete();
     }, recved.ctx(), {recved.var()}, {stored.var()},
     FnProperty::kNormal, 0, PROFILER_MESSAGE_FUNCNAME);
+    Restore(master_key, &stored);
     if (has_multi_precision_copy(type)) {
       CopyFromTo(stored, store_[master_key]);
       store_[master_key].WaitToRead();
     }
     stored.WaitToRead();
-    server->Response(req_meta);
+    Response(server, req_meta);
   }
 
   void DataHandleRowSparse(const DataHandleType type, const ps::KVMeta& req_meta,
                            const ps::KVPairs<char>& req_data,
                            ps::KVServer<char>* server) {
+    if (sparse_store_) {
+      DataHandleRowSparseHash(type, req_meta, req_data, server);
+      return;
+    }
     int master_key = DecodeKey(req_data.keys[0]);
     auto num_rows = req_data.keys.size() - 1;
     auto& stored = store_[master_key];
@@ -446,7 +997,7 @@ class KVStoreDistServer {
       if (stored.is_none()) {
         if (log_verbose_) LOG(INFO) << "initial push: " << master_key;
         // initialization
-        CHECK_GT(num_rows, 0) << "init with empty data is not supported";
+        CHECK(num_rows > 0 && req_data.lens[1] > 0) << "init with empty data is not supported";
         InitRowSparseStored(type, master_key, num_rows, req_meta, req_data, server);
         return;
       } else {
@@ -472,7 +1023,7 @@ class KVStoreDistServer {
             updates.request.push_back(req_meta);
             ApplyUpdates(type, master_key, &updates, server);
           } else {
-            server->Response(req_meta);
+            Response(server, req_meta);
           }
         } else {
           auto unit_len = req_data.lens[1] / mshadow::mshadow_sizeof(type.dtype);
@@ -517,6 +1068,129 @@ class KVStoreDistServer {
     }
   }
 
+  /**
+   * \brief handles the row_sparse requests when the rows are stored in hash tables.
+   *  Rows never pushed are created by the initializer when they are first pulled,
+   *  so memory grows with the rows used instead of the shape of the value.
+   */
+  void DataHandleRowSparseHash(const DataHandleType type, const ps::KVMeta& req_meta,
+                               const ps::KVPairs<char>& req_data,
+                               ps::KVServer<char>* server) {
+    CHECK_EQ(type.dtype, mshadow::kFloat32)
+      << "MXNET_KVSTORE_SERVER_SPARSE_STORE only supports float32 values";
+    const int master_key = DecodeKey(req_data.keys[0]);
+    const size_t num_rows = req_data.keys.size() - 1;
+    auto& table = sparse_stores_[master_key];
+    auto row_id = [&req_data](size_t i) {
+      return static_cast<int64_t>(req_data.keys[i] - req_data.keys[0]);
+    };
+    if (!req_meta.push) {
+      CHECK(table) << "init " << master_key << " first";
+      if (log_verbose_) LOG(INFO) << "pull: " << master_key;
+      const size_t row_len = table->row_len();
+      const size_t row_bytes = row_len * sizeof(float);
+      ps::KVPairs<char> response;
+      response.keys = req_data.keys;
+      response.vals.resize(num_rows * row_bytes);
+      table->Tick();
+      #pragma omp parallel for
+      for (int64_t i = 1; i <= static_cast<int64_t>(num_rows); ++i) {
+        std::memcpy(response.vals.data() + (i - 1) * row_bytes, table->Row(row_id(i)),
+                    row_bytes);
+      }
+      std::vector<int> lens(req_data.keys.size(), num_rows ? row_len : 0);
+      lens[0] = 0;
+      response.lens.CopyFrom(lens.begin(), lens.end());
+      Response(server, req_meta, response);
+      // pulls create rows as well
+      table->EvictCold();
+      return;
+    }
+    CHECK_GT(req_data.lens.size(), 0) << "req_data.lens cannot be empty";
+    CHECK_EQ(req_data.lens[0], 0);
+    if (!table) {
+      if (log_verbose_) LOG(INFO) << "initial push: " << master_key;
+      // an init without rows carries the row length as the offset of a key without data
+      CHECK_GT(num_rows, 0) << "init of " << master_key << " misses the row length";
+      const bool meta = num_rows == 1 && req_data.lens[1] == 0;
+      const size_t row_len = meta ? row_id(1) : req_data.lens[1] / sizeof(float);
+      CHECK_GT(row_len, 0);
+      // seeded by the ps key, which differs between the servers holding parts of the value
+      table.reset(new RowSparseHashStore(row_len, sparse_store_init_, req_data.keys[0],
+                                         sparse_store_max_rows_));
+      if (!meta) {
+        CHECK_EQ(req_data.vals.size(), num_rows * row_len * sizeof(float));
+        const float* vals = reinterpret_cast<const float*>(req_data.vals.data());
+        for (size_t i = 1; i <= num_rows; ++i) {
+          std::memcpy(table->Row(row_id(i)), vals + (i - 1) * row_len, row_len * sizeof(float));
+        }
+      }
+      RestoreRows(master_key, table.get());
+      Response(server, req_meta);
+      return;
+    }
+    if (log_verbose_) LOG(INFO) << "push: " << master_key << " " << req_data.keys;
+    const size_t row_len = table->row_len();
+    CHECK_EQ(req_data.vals.size(), num_rows * row_len * sizeof(float));
+    const float* vals = reinterpret_cast<const float*>(req_data.vals.data());
+    auto& updates = sparse_update_buf_[master_key];
+    for (size_t i = 1; i <= num_rows; ++i) {
+      const float* grad = vals + (i - 1) * row_len;
+      auto it = updates.pos.find(row_id(i));
+      if (it == updates.pos.end()) {
+        updates.pos[row_id(i)] = updates.rows.size();
+        updates.rows.push_back(row_id(i));
+        updates.grads.insert(updates.grads.end(), grad, grad + row_len);
+      } else {
+        float* merged = updates.grads.data() + it->second * row_len;
+        for (size_t j = 0; j < row_len; ++j) merged[j] += grad[j];
+      }
+    }
+    updates.request.push_back(req_meta);
+    if (sync_mode_ && updates.request.size() < static_cast<size_t>(ps::NumWorkers())) return;
+    UpdateRowSparseHash(master_key, table.get(), updates.rows, updates.grads.data());
+    for (const auto& req : updates.request) {
+      Response(server, req);
+    }
+    updates = SparseUpdateBuf();
+  }
+
+  /**
+   * \brief applies the summed gradients of the given rows. The updater sees the
+   *  rows as a dense array of shape (rows.size(), row_len), hence optimizers
+   *  keeping states are rejected by KVStore.set_optimizer.
+   */
+  void UpdateRowSparseHash(int key, RowSparseHashStore* table,
+                           const std::vector<int64_t>& rows, float* grads) {
+    table->Tick();
+    if (rows.empty()) return;
+    const size_t row_len = table->row_len();
+    const size_t row_bytes = row_len * sizeof(float);
+    TShape shape = mshadow::Shape2(rows.size(), row_len);
+    NDArray update(TBlob(grads, shape, cpu::kDevMask), 0);
+    NDArray weight(shape, Context(), false, mshadow::kFloat32);
+    float* data = weight.data().dptr<float>();
+    #pragma omp parallel for
+    for (int64_t i = 0; i < static_cast<int64_t>(rows.size()); ++i) {
+      std::memcpy(data + i * row_len, table->Row(rows[i]), row_bytes);
+    }
+    if (updater_) {
+      exec_.Exec([this, key, &update, &weight](){
+        CHECK(updater_);
+        updater_(key, update, &weight);
+      });
+    } else {
+      CHECK(sync_mode_) << "Updater needs to be set for async mode";
+      CopyFromTo(update, &weight);
+    }
+    weight.WaitToRead();
+    #pragma omp parallel for
+    for (int64_t i = 0; i < static_cast<int64_t>(rows.size()); ++i) {
+      std::memcpy(table->Row(rows[i]), data + i * row_len, row_bytes);
+    }
+    table->EvictCold();
+  }
+
   void DefaultStorageResponse(const DataHandleType type,
                               const int key,
                               const ps::KVMeta& req_meta,
@@ -534,7 +1208,7 @@ class KVStoreDistServer {
     response.lens = {len};
     // TODO(mli) try to remove this CopyFrom
     response.vals.CopyFrom(static_cast<const char*>(stored.data().dptr_), len);
-    server->Response(req_meta, response);
+    Response(server, req_meta, response);
   }
 
   void DataHandleCompressed(const DataHandleType type,
@@ -572,7 +1246,7 @@ class KVStoreDistServer {
       if (stored.is_none()) {
         stored = NDArray(dshape, Context());
         gradient_compression_->Dequantize(recved, &stored, 0);
-        server->Response(req_meta);
+        Response(server, req_meta);
         stored.WaitToRead();
       } else if (sync_mode_) {
         // synced push
@@ -595,7 +1269,7 @@ class KVStoreDistServer {
           CHECK(updater_);
           updater_(key, decomp_buf, &stored);
         });
-        server->Response(req_meta);
+        Response(server, req_meta);
         stored.WaitToRead();
       }
     } else {       // pull
@@ -633,7 +1307,8 @@ class KVStoreDistServer {
         stored = NDArray(dshape, Context(), false,
                          has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
         CopyFromTo(recved, &stored, 0);
-        server->Response(req_meta);
+        Restore(key, &stored);
+        Response(server, req_meta);
         if (has_multi_precision_copy(type)) {
           auto& stored_dtype = store_[key];
           stored_dtype = NDArray(dshape, Context(), false, type.dtype);
@@ -693,23 +1368,69 @@ class KVStoreDistServer {
   /**
    * \brief store_ contains the value at kvstore for each key
    */
-  std::unordered_map<int, NDArray> store_;
-  std::unordered_map<int, NDArray> store_realt_;
+  KeyValueMap<NDArray> store_;
+  KeyValueMap<NDArray> store_realt_;
 
   /**
    * \brief merge_buf_ is a buffer used if sync_mode is true. It represents
    * values from different workers being merged. The store will be updated
    * to this value when values from all workers are pushed into this buffer.
    */
-  std::unordered_map<int, UpdateBuf> update_buf_;
+  KeyValueMap<UpdateBuf> update_buf_;
 
   /**
    * \brief decomp_buf_ is a buffer into which compressed values are
    * decompressed before merging to the store. used when compress_!='none'
    */
-  std::unordered_map<int, NDArray> decomp_buf_;
+  KeyValueMap<NDArray> decomp_buf_;
+
+  /**
+   * \brief whether the rows of row_sparse values are kept in hash tables
+   *  instead of dense arrays, set by MXNET_KVSTORE_SERVER_SPARSE_STORE
+   */
+  bool sparse_store_;
+  RowInitializer sparse_store_init_;
+  size_t sparse_store_max_rows_;
+  KeyValueMap<std::unique_ptr<RowSparseHashStore> > sparse_stores_;
+  KeyValueMap<SparseUpdateBuf> sparse_update_buf_;
+
+  /**
+   * \brief how many pushes of a key a worker may be ahead of the slowest one
+   *  when pulling it in async mode, set by MXNET_KVSTORE_STALENESS. Negative
+   *  for no bound.
+   */
+  int staleness_;
+  KeyValueMap<WorkerClock> clocks_;
 
+  /**
+   * \brief writes the last snapshot
+   */
+  std::thread snapshot_thread_;
+  /**
+   * \brief values loaded from the snapshot of MXNET_KVSTORE_SERVER_RESTORE,
+   *  which replace the initial values pushed by the workers
+   */
+  std::string restore_prefix_;
+  std::unordered_map<int, NDArray> restored_;
+  std::once_flag restore_once_;
+  std::unordered_map<int, BlockedStats> blocked_stats_;
+  std::mutex blocked_mu_;
+
+  /**
+   * \brief runs the updater on the thread calling \ref Run, which is necessary for python
+   */
   Executor exec_;
+  /**
+   * \brief handles the requests of disjoint sets of keys on separate threads,
+   *  nullptr to handle all requests on the thread receiving them
+   */
+  std::unique_ptr<ShardedExecutor> update_exec_;
+
+  /**
+   * \brief fused requests waiting for some of their keys, by sender, customer and timestamp
+   */
+  std::map<std::tuple<int, int, int>, FusedRequest> fused_requests_;
+  std::mutex fused_mu_;
   ps::KVServer<char>* ps_server_;
 
   // whether to LOG verbose information
@@ -165,7 +165,7 @@ class KVStoreLocal : public KVStore {
     GroupKVPairsPush(keys, values, &uniq_keys, &grouped_vals);
     for (size_t i = 0; i < uniq_keys.size(); ++i) {
       int key = uniq_keys[i];
-      const NDArray& merged = comm_->Reduce(key, grouped_vals[i], priority);
+      const NDArray& merged = ReduceImpl(key, grouped_vals[i], priority);
       NDArray& local = local_[key];
       if (updater_ != nullptr) {
         CHECK(!local.is_none()) << "key " << key << " has not been inited";
@@ -196,6 +196,14 @@ class KVStoreLocal : public KVStore {
     }
   }
 
+  /**
+   * \brief sums the values pushed to a key
+   */
+  virtual const NDArray& ReduceImpl(int key, const std::vector<NDArray>& values,
+                                    int priority) {
+    return comm_->Reduce(key, values, priority);
+  }
+
   virtual void PullImpl(const std::vector<int>& keys,
                         const std::vector<NDArray*>& values,
                         int priority) {
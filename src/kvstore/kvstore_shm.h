@@ -0,0 +1,333 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Copyright (c) 2018 by Contributors
+ * @file   kvstore_shm.h
+ * @brief  allreduce across the processes of one host through shared memory
+ */
+#ifndef MXNET_KVSTORE_KVSTORE_SHM_H_
+#define MXNET_KVSTORE_KVSTORE_SHM_H_
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "./comm.h"
+#include "./kvstore_local.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief whether a process is running, zombies excluded
+ */
+inline bool ProcessAlive(int pid) {
+  if (kill(pid, 0) != 0 && errno != EPERM) return false;
+  // a process which exited stays a zombie until its parent waits for it
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  FILE* fp = fopen(path, "r");
+  if (fp == nullptr) return true;
+  char state = 'R';
+  const int parsed = fscanf(fp, "%*d (%*[^)]) %c", &state);
+  fclose(fp);
+  return parsed != 1 || (state != 'Z' && state != 'X');
+}
+
+/**
+ * \brief barrier of the processes mapping it
+ */
+struct ShmBarrier {
+  std::atomic<int> count{0};
+  std::atomic<int> generation{0};
+
+  /**
+   * \brief wait for all processes, failing when one of them died or after timeout
+   *  seconds, unless timeout is 0
+   * \param pids pids of the processes, 0 for those not attached yet
+   */
+  void Wait(int num_procs, const std::atomic<int>* pids, int timeout) {
+    const int gen = generation.load();
+    if (count.fetch_add(1) + 1 == num_procs) {
+      count.store(0);
+      ++generation;
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    auto last_check = start;
+    for (int spin = 0; generation.load() == gen; ++spin) {
+      if (spin < 1000) continue;
+      std::this_thread::yield();
+      const auto now = std::chrono::steady_clock::now();
+      if (now - last_check < std::chrono::milliseconds(100)) continue;
+      last_check = now;
+      for (int r = 0; r < num_procs; ++r) {
+        const int pid = pids[r].load();
+        CHECK(pid <= 0 || ProcessAlive(pid))
+          << "Process " << r << " of the shm kvstore exited";
+      }
+      CHECK(timeout <= 0 || now - start < std::chrono::seconds(timeout))
+        << "Timed out after " << timeout << " seconds waiting for the processes of the "
+        << "shm kvstore";
+    }
+  }
+};
+
+/**
+ * \brief the segment all processes of a shm kvstore map under a known name
+ */
+struct ShmControl {
+  static const uint64_t kMagic = 0x6d786b7673686d31ULL;
+  static const int kMaxProcs = 1024;
+
+  std::atomic<uint64_t> magic{0};
+  /*! \brief pid of the process which created the segment */
+  int creator = -1;
+  /*! \brief pids of the processes, by rank */
+  std::atomic<int> pids[kMaxProcs];
+  /*! \brief synchronizes the calls of the frontend, such as init */
+  ShmBarrier host_barrier;
+  /*! \brief synchronizes the allreduces run by the engine */
+  ShmBarrier engine_barrier;
+  /*! \brief shared memory handles exchanged when a key is initialized */
+  std::pair<int, int> handles[kMaxProcs];
+};
+
+/**
+ * \brief kvstore of the processes of one host, which sum their gradients
+ *  through shared memory instead of servers.
+ *
+ * Each process keeps a replica of the weights, like the nccl kvstore. A key
+ * has a buffer in shared memory per process, which all processes map. A push
+ * copies the gradient into the buffer of the process, then each process sums
+ * a chunk of the value over all buffers and finally copies the chunks summed
+ * by the others into its buffer. The processes are given by
+ * MXNET_KVSTORE_SHM_RANK and MXNET_KVSTORE_SHM_NUM_PROCS, and meet in shared
+ * memory named after MXNET_KVSTORE_SHM_NAME.
+ */
+class KVStoreShm : public KVStoreLocal {
+ public:
+  KVStoreShm() : KVStoreLocal(false) {
+    rank_ = dmlc::GetEnv("MXNET_KVSTORE_SHM_RANK", -1);
+    num_procs_ = dmlc::GetEnv("MXNET_KVSTORE_SHM_NUM_PROCS", 0);
+    CHECK(num_procs_ > 0 && rank_ >= 0 && rank_ < num_procs_)
+      << "Set MXNET_KVSTORE_SHM_RANK and MXNET_KVSTORE_SHM_NUM_PROCS to use the shm kvstore";
+    CHECK_LE(num_procs_, ShmControl::kMaxProcs);
+    timeout_ = dmlc::GetEnv("MXNET_KVSTORE_SHM_TIMEOUT", 0);
+    Attach("/mx_kv_" + dmlc::GetEnv("MXNET_KVSTORE_SHM_NAME", std::string("default")));
+    sync_var_ = Engine::Get()->NewVariable();
+  }
+
+  virtual ~KVStoreShm() {
+    Engine::Get()->WaitForAll();
+    buffers_.clear();
+    Engine::Get()->DeleteVariable([](RunContext ctx) {}, Context::CPU(), sync_var_);
+    Engine::Get()->WaitForAll();
+    munmap(control_, sizeof(ShmControl));
+  }
+
+  int get_rank() const override {
+    return rank_;
+  }
+
+  int get_group_size() const override {
+    return num_procs_;
+  }
+
+  void Barrier() override {
+    control_->host_barrier.Wait(num_procs_, control_->pids, timeout_);
+  }
+
+  void SetGradientCompression(const std::vector<std::pair<std::string, std::string> >
+                              & kwargs) override {
+    LOG(FATAL) << "Gradient compression is not supported by the shm kvstore";
+  }
+
+ private:
+  /**
+   * \brief buffers of a key in shared memory, by rank
+   */
+  struct Buffer {
+    std::vector<NDArray> procs;
+  };
+
+  void Attach(const std::string& name) {
+    const size_t size = sizeof(ShmControl);
+    void* ptr = nullptr;
+    if (rank_ == 0) {
+      // left by a job which crashed
+      shm_unlink(name.c_str());
+      int fid = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+      CHECK_NE(fid, -1) << "Failed to create " << name << ": " << strerror(errno);
+      CHECK_EQ(ftruncate(fid, size), 0);
+      ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fid, 0);
+      CHECK_NE(ptr, MAP_FAILED) << "Failed to map " << name << ": " << strerror(errno);
+      close(fid);
+      control_ = new (ptr) ShmControl();
+      for (auto& pid : control_->pids) pid.store(0);
+      control_->creator = getpid();
+      control_->magic.store(ShmControl::kMagic);
+    } else {
+      // wait for the first process to create the segment
+      const auto start = std::chrono::steady_clock::now();
+      while (true) {
+        CHECK(timeout_ <= 0 ||
+              std::chrono::steady_clock::now() - start < std::chrono::seconds(timeout_))
+          << "Timed out after " << timeout_ << " seconds waiting for process 0 to create "
+          << name;
+        int fid = shm_open(name.c_str(), O_RDWR, 0666);
+        if (fid == -1) {
+          CHECK_EQ(errno, ENOENT) << "Failed to open " << name << ": " << strerror(errno);
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          continue;
+        }
+        struct stat st;
+        const bool sized = fstat(fid, &st) == 0 && st.st_size >= static_cast<off_t>(size);
+        if (sized) {
+          ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fid, 0);
+          CHECK_NE(ptr, MAP_FAILED) << "Failed to map " << name << ": " << strerror(errno);
+        }
+        close(fid);
+        if (sized) {
+          control_ = static_cast<ShmControl*>(ptr);
+          if (control_->magic.load() == ShmControl::kMagic && kill(control_->creator, 0) == 0) {
+            break;
+          }
+          munmap(ptr, size);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    control_->pids[rank_].store(getpid());
+    Barrier();
+    // the segment stays mapped, and no name is left behind
+    if (rank_ == 0) shm_unlink(name.c_str());
+  }
+
+  void InitImpl(const std::vector<int>& keys,
+                const std::vector<NDArray>& values) override {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const int key = keys[i];
+      const NDArray& value = values[i];
+      CHECK(local_.find(key) == local_.end())
+          << "duplicate init of key " << key;
+      CHECK_EQ(value.storage_type(), kDefaultStorage)
+          << "The shm kvstore only supports dense values";
+      comm_->Init(key, value.storage_type(), value.shape(), value.dtype());
+      NDArray own(value.shape(), Context::CPUShared(0), false, value.dtype());
+      // the buffer of the first process holds the initial value
+      if (rank_ == 0) CopyFromTo(value, &own);
+      own.WaitToRead();
+      const Storage::Handle handle = own.storage_handle();
+      // the segment is freed by the last process unmapping it
+      for (int r = 1; r < num_procs_; ++r) Storage::Get()->SharedIncrementRefCount(handle);
+      control_->handles[rank_] = std::make_pair(handle.shared_pid, handle.shared_id);
+      Barrier();
+      Buffer& buf = buffers_[key];
+      for (int r = 0; r < num_procs_; ++r) {
+        const auto& h = control_->handles[r];
+        buf.procs.push_back(r == rank_ ? own :
+                            NDArray(h.first, h.second, value.shape(), value.dtype()));
+      }
+      local_[key] = buf.procs[0].Copy(pinned_ctx_);
+      local_[key].WaitToRead();
+      // the handles and the initial value are overwritten afterwards
+      Barrier();
+    }
+  }
+
+  const NDArray& ReduceImpl(int key, const std::vector<NDArray>& values,
+                            int priority) override {
+    CHECK_EQ(values[0].storage_type(), kDefaultStorage)
+        << "The shm kvstore only supports dense values";
+    const NDArray& merged = comm_->Reduce(key, values, priority);
+    Buffer& buf = buffers_[key];
+    NDArray& own = buf.procs[rank_];
+    CopyFromTo(merged, &own, priority);
+    // all allreduces write sync_var_, so that they run in the order of the
+    // pushes, which is the same in all processes
+    std::vector<NDArray> procs = buf.procs;
+    Engine::Get()->PushAsync(
+      [this, procs](RunContext rctx, Engine::CallbackOnComplete on_complete) {
+        AllReduce(procs);
+        on_complete();
+      }, Context::CPU(), {}, {own.var(), sync_var_},
+      FnProperty::kCPUPrioritized, priority, "KVStoreShmAllReduce");
+    return own;
+  }
+
+  /**
+   * \brief sums the buffers of all processes into the buffer of this one
+   */
+  void AllReduce(const std::vector<NDArray>& procs) {
+    const size_t total = procs[0].shape().Size();
+    auto chunk = [this, total](int r) {
+      return std::make_pair(total * r / num_procs_, total * (r + 1) / num_procs_);
+    };
+    CommCPU* comm = static_cast<CommCPU*>(comm_);
+    MSHADOW_TYPE_SWITCH(procs[0].dtype(), DType, {
+      std::vector<DType*> dptr;
+      for (const auto& p : procs) dptr.push_back(p.data().dptr<DType>());
+      // all gradients are copied in
+      control_->engine_barrier.Wait(num_procs_, control_->pids, timeout_);
+      const auto mine = chunk(rank_);
+      std::vector<DType*> reduce = {dptr[rank_] + mine.first};
+      for (int r = 0; r < num_procs_; ++r) {
+        if (r != rank_) reduce.push_back(dptr[r] + mine.first);
+      }
+      comm->ReduceSumCPUImpl(reduce, mine.second - mine.first);
+      // all chunks are summed
+      control_->engine_barrier.Wait(num_procs_, control_->pids, timeout_);
+      for (int r = 0; r < num_procs_; ++r) {
+        if (r == rank_) continue;
+        const auto theirs = chunk(r);
+        std::memcpy(dptr[rank_] + theirs.first, dptr[r] + theirs.first,
+                    (theirs.second - theirs.first) * sizeof(DType));
+      }
+      // no buffer is overwritten by the next push before all processes copied from it
+      control_->engine_barrier.Wait(num_procs_, control_->pids, timeout_);
+    });
+  }
+
+  int rank_;
+  int num_procs_;
+  /*! \brief seconds the barriers wait for the other processes, 0 for no limit */
+  int timeout_;
+  ShmControl* control_ = nullptr;
+  std::unordered_map<int, Buffer> buffers_;
+  /*! \brief written by all allreduces */
+  Engine::VarHandle sync_var_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KVSTORE_SHM_H_
@@ -23,6 +23,7 @@
  */
 
 #include "./kvstore_utils.h"
+#include "./unique.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -35,9 +36,9 @@ void UniqueImpl<cpu>(const Resource& rsc, mshadow::Stream<cpu> *s,
   CHECK_EQ(out.storage_type(), kRowSparseStorage) << "row_sparse NDArray is expected";
   MSHADOW_IDX_TYPE_SWITCH(out.dtype(), IType, {
     IType *dptr = out.data().dptr<IType>();
-    common::ParallelSort(dptr, dptr + num_elements,
-                         engine::OpenMP::Get()->GetRecommendedOMPThreadCount());
-    const size_t num_selected_out = std::unique(dptr, dptr + num_elements) - dptr;
+    // the row ids pulled usually repeat a lot, so most of them are dropped before sorting
+    const size_t num_selected_out = HashUnique(dptr, num_elements, true,
+        engine::OpenMP::Get()->GetRecommendedOMPThreadCount());
     // set the shape of data/aux_data according to the number of unique values
     out.set_aux_shape(rowsparse::kIdx, mshadow::Shape1(num_selected_out));
   });
@@ -0,0 +1,234 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Copyright (c) 2018 by Contributors
+ * @file   row_sparse_hash_store.h
+ * @brief  rows of a row_sparse value stored by a server in a hash table
+ */
+#ifndef MXNET_KVSTORE_ROW_SPARSE_HASH_STORE_H_
+#define MXNET_KVSTORE_ROW_SPARSE_HASH_STORE_H_
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief initial value of the rows created by a RowSparseHashStore.
+ *  Parsed from `zeros`, `uniform:<scale>` for U(-scale, scale) or
+ *  `normal:<sigma>` for N(0, sigma).
+ */
+struct RowInitializer {
+  enum Type { kZeros, kUniform, kNormal };
+  Type type = kZeros;
+  float scale = 0;
+
+  static RowInitializer Parse(const std::string& s) {
+    RowInitializer init;
+    const size_t colon = s.find(':');
+    const std::string name = s.substr(0, colon);
+    if (name == "zeros") {
+      init.type = kZeros;
+    } else if (name == "uniform" || name == "normal") {
+      CHECK_NE(colon, std::string::npos) << "Missing scale of row initializer " << s;
+      init.type = name == "uniform" ? kUniform : kNormal;
+      init.scale = std::stof(s.substr(colon + 1));
+    } else {
+      LOG(FATAL) << "Unknown row initializer " << s;
+    }
+    return init;
+  }
+
+  /**
+   * \brief fills a row. The values only depend on seed, so that a row evicted
+   *  and created again, or created on another server, gets the same values.
+   */
+  void operator()(uint64_t seed, float* row, size_t len) const {
+    if (type == kZeros) {
+      std::fill(row, row + len, 0.0f);
+      return;
+    }
+    for (size_t i = 0; i < len; ++i) {
+      const double u = Uniform(seed, 2 * i);
+      if (type == kUniform) {
+        row[i] = static_cast<float>((2 * u - 1) * scale);
+      } else {
+        // Box-Muller
+        const double v = Uniform(seed, 2 * i + 1);
+        row[i] = static_cast<float>(std::sqrt(-2 * std::log(1 - u)) *
+                                    std::cos(2 * M_PI * v) * scale);
+      }
+    }
+  }
+
+ private:
+  /*! \brief the i-th number in [0, 1) of the sequence of seed, by splitmix64 */
+  static double Uniform(uint64_t seed, uint64_t i) {
+    uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / (1ULL << 53));
+  }
+};
+
+/**
+ * \brief float32 rows of a row_sparse value, indexed by row id. Rows are
+ *  created by the initializer the first time they are used, so that memory
+ *  grows with the number of rows used rather than with the number of rows
+ *  of the value. If max_rows is positive, the rows used least recently are
+ *  evicted when there are more.
+ */
+class RowSparseHashStore {
+ public:
+  RowSparseHashStore(size_t row_len, const RowInitializer& init, uint64_t seed,
+                     size_t max_rows)
+    : row_len_(row_len), init_(init), seed_(seed), max_rows_(max_rows),
+      shards_(new Shard[kNumShards]) {}
+
+  size_t row_len() const {
+    return row_len_;
+  }
+
+  /**
+   * \brief number of rows stored
+   */
+  size_t size() const {
+    return size_.load();
+  }
+
+  /**
+   * \brief returns the row, created if it does not exist. Threadsafe, the row
+   *  stays valid until the next call of \ref EvictCold.
+   */
+  float* Row(int64_t id) {
+    Shard& shard = shards_[static_cast<uint64_t>(id) % kNumShards];
+    std::lock_guard<std::mutex> lk(shard.mu);
+    Entry& entry = shard.rows[id];
+    if (!entry.data) {
+      entry.data.reset(new float[row_len_]);
+      init_(seed_ ^ (static_cast<uint64_t>(id) * 0xff51afd7ed558ccdULL), entry.data.get(),
+            row_len_);
+      ++size_;
+    }
+    entry.last_use = clock_.load(std::memory_order_relaxed);
+    return entry.data.get();
+  }
+
+  /**
+   * \brief advance the clock of the row uses, called once per request
+   */
+  void Tick() {
+    ++clock_;
+  }
+
+  /**
+   * \brief the ids of the rows stored in ascending order, and their values one
+   *  after another. Must not run concurrently with \ref Row.
+   */
+  void Dump(std::vector<int64_t>* ids, std::vector<float>* values) const {
+    ids->clear();
+    for (size_t s = 0; s < kNumShards; ++s) {
+      for (const auto& kv : shards_[s].rows) ids->push_back(kv.first);
+    }
+    std::sort(ids->begin(), ids->end());
+    values->resize(ids->size() * row_len_);
+    for (size_t i = 0; i < ids->size(); ++i) {
+      const int64_t id = (*ids)[i];
+      const float* row = shards_[static_cast<uint64_t>(id) % kNumShards].rows.at(id).data.get();
+      std::copy(row, row + row_len_, values->data() + i * row_len_);
+    }
+  }
+
+  /**
+   * \brief evict the rows used least recently until at most max_rows remain.
+   *  Must not run concurrently with \ref Row.
+   */
+  void EvictCold() {
+    if (max_rows_ == 0 || size_ <= max_rows_) return;
+    std::vector<uint64_t> uses;
+    uses.reserve(size_);
+    for (size_t s = 0; s < kNumShards; ++s) {
+      for (const auto& kv : shards_[s].rows) uses.push_back(kv.second.last_use);
+    }
+    // rows used before the cutoff are evicted, and some of those used at the cutoff
+    const size_t num_evict = uses.size() - max_rows_;
+    std::nth_element(uses.begin(), uses.begin() + (num_evict - 1), uses.end());
+    const uint64_t cutoff = uses[num_evict - 1];
+    size_t evicted = 0;
+    for (size_t s = 0; s < kNumShards && evicted < num_evict; ++s) {
+      auto& rows = shards_[s].rows;
+      for (auto it = rows.begin(); it != rows.end() && evicted < num_evict;) {
+        if (it->second.last_use < cutoff) {
+          it = rows.erase(it);
+          ++evicted;
+        } else {
+          ++it;
+        }
+      }
+    }
+    for (size_t s = 0; s < kNumShards && evicted < num_evict; ++s) {
+      auto& rows = shards_[s].rows;
+      for (auto it = rows.begin(); it != rows.end() && evicted < num_evict;) {
+        if (it->second.last_use == cutoff) {
+          it = rows.erase(it);
+          ++evicted;
+        } else {
+          ++it;
+        }
+      }
+    }
+    size_ -= evicted;
+  }
+
+ private:
+  static const size_t kNumShards = 64;
+
+  struct Entry {
+    std::unique_ptr<float[]> data;
+    uint64_t last_use = 0;
+  };
+
+  struct Shard {
+    std::mutex mu;
+    std::unordered_map<int64_t, Entry> rows;
+  };
+
+  const size_t row_len_;
+  const RowInitializer init_;
+  const uint64_t seed_;
+  const size_t max_rows_;
+  std::unique_ptr<Shard[]> shards_;
+  std::atomic<size_t> size_{0};
+  std::atomic<uint64_t> clock_{0};
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_ROW_SPARSE_HASH_STORE_H_
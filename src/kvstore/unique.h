@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file unique.h
+ * \brief unique values of the row ids pulled from kvstore on cpu
+ */
+#ifndef MXNET_KVSTORE_UNIQUE_H_
+#define MXNET_KVSTORE_UNIQUE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief set of integers by open addressing with linear probing, which
+ *  grows to keep the load at most one half
+ */
+template<typename IType>
+class UniqueSet {
+ public:
+  explicit UniqueSet(size_t capacity) {
+    size_t n = 16;
+    while (n < 2 * capacity) n *= 2;
+    Reset(n);
+  }
+
+  void Insert(IType v) {
+    if (2 * (size_ + 1) > keys_.size()) Grow();
+    size_t i = Hash(v) & mask_;
+    while (used_[i]) {
+      if (keys_[i] == v) return;
+      i = (i + 1) & mask_;
+    }
+    used_[i] = 1;
+    keys_[i] = v;
+    ++size_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  template<typename F>
+  void ForEach(F f) const {
+    for (size_t i = 0; i < keys_.size(); ++i) {
+      if (used_[i]) f(keys_[i]);
+    }
+  }
+
+  /*!
+   * \brief mixes the bits of v, the low ones index the table
+   */
+  static uint64_t Hash(IType v) {
+    uint64_t z = static_cast<uint64_t>(v) * 0x9e3779b97f4a7c15ULL;
+    return z ^ (z >> 29);
+  }
+
+ private:
+  void Reset(size_t n) {
+    keys_.assign(n, IType(0));
+    used_.assign(n, 0);
+    mask_ = n - 1;
+    size_ = 0;
+  }
+
+  void Grow() {
+    std::vector<IType> keys;
+    std::vector<uint8_t> used;
+    keys.swap(keys_);
+    used.swap(used_);
+    Reset(2 * keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (used[i]) Insert(keys[i]);
+    }
+  }
+
+  std::vector<IType> keys_;
+  std::vector<uint8_t> used_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+};
+
+/*!
+ * \brief unique values of data by sorting, the way kvstore always did.
+ *  Writes them sorted to the front of data and returns their number.
+ */
+template<typename IType>
+size_t SortUnique(IType* data, size_t n, int num_threads) {
+  common::ParallelSort(data, data + n, std::max(num_threads, 1));
+  return std::unique(data, data + n) - data;
+}
+
+/*!
+ * \brief unique values of data by hashing. Each thread puts the values of
+ *  its part of data in its own set, then each thread merges the values of
+ *  one range of hashes from all sets, so that only the unique values are
+ *  ever sorted. Writes them to the front of data and returns their number.
+ *
+ *  If a sample or the parts of data hardly have duplicates, sorting everything
+ *  is faster than hashing it, and data is unique'd by \ref SortUnique instead.
+ * \param sorted whether the unique values must be in ascending order
+ */
+template<typename IType>
+size_t HashUnique(IType* data, size_t n, bool sorted, int num_threads) {
+  // below a few thousand values per thread, the threads cost more than they save
+  const size_t kMinPerThread = 4096;
+  const int nthreads = static_cast<int>(std::max<size_t>(1,
+      std::min<size_t>(std::max(num_threads, 1), n / kMinPerThread)));
+  // a sample which hardly repeats is not worth hashing
+  const size_t kSampleSize = 4096;
+  if (n > 2 * kSampleSize) {
+    UniqueSet<IType> sample(kSampleSize);
+    for (size_t i = 0; i < kSampleSize; ++i) sample.Insert(data[i * (n / kSampleSize)]);
+    if (4 * sample.size() > 3 * kSampleSize) return SortUnique(data, n, num_threads);
+  }
+  // per thread, the unique values of its part by the range of hashes they fall in
+  std::vector<std::vector<std::vector<IType>>> parts(nthreads,
+      std::vector<std::vector<IType>>(nthreads));
+  std::vector<size_t> num_local(nthreads);
+  #pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+  for (int t = 0; t < nthreads; ++t) {
+    const size_t begin = n * t / nthreads;
+    const size_t end = n * (t + 1) / nthreads;
+    UniqueSet<IType> set(1024);
+    for (size_t i = begin; i < end; ++i) set.Insert(data[i]);
+    std::vector<std::vector<IType>>& mine = parts[t];
+    set.ForEach([&mine, nthreads](IType v) {
+      // the high bits, as the low ones index the sets
+      mine[(UniqueSet<IType>::Hash(v) >> 40) % nthreads].push_back(v);
+    });
+    num_local[t] = set.size();
+  }
+  size_t total_local = 0;
+  for (size_t c : num_local) total_local += c;
+  // data is not written yet
+  if (2 * total_local > n) return SortUnique(data, n, num_threads);
+
+  std::vector<std::vector<IType>> merged(nthreads);
+  #pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+  for (int p = 0; p < nthreads; ++p) {
+    size_t count = 0;
+    for (int t = 0; t < nthreads; ++t) count += parts[t][p].size();
+    UniqueSet<IType> set(count);
+    for (int t = 0; t < nthreads; ++t) {
+      for (IType v : parts[t][p]) set.Insert(v);
+      std::vector<IType>().swap(parts[t][p]);
+    }
+    merged[p].reserve(set.size());
+    set.ForEach([&merged, p](IType v) { merged[p].push_back(v); });
+  }
+  std::vector<size_t> offsets(nthreads + 1, 0);
+  for (int p = 0; p < nthreads; ++p) offsets[p + 1] = offsets[p] + merged[p].size();
+  #pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+  for (int p = 0; p < nthreads; ++p) {
+    std::copy(merged[p].begin(), merged[p].end(), data + offsets[p]);
+  }
+  const size_t num_unique = offsets[nthreads];
+  if (sorted) common::ParallelSort(data, data + num_unique, std::max(num_threads, 1));
+  return num_unique;
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_UNIQUE_H_
@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file wire_dtype.h
+ * \brief casts between float32 and the 16 bit types sent over the network by dist kvstore
+ */
+#ifndef MXNET_KVSTORE_WIRE_DTYPE_H_
+#define MXNET_KVSTORE_WIRE_DTYPE_H_
+
+#include <mshadow/base.h>
+#include <cstdint>
+#include <cstring>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief float32 to IEEE half precision, rounding to nearest even
+ */
+inline void FloatToFloat16(const float* in, uint16_t* out, size_t n) {
+  size_t i = 0;
+#if defined(__F16C__)
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+  }
+#endif
+  for (; i < n; ++i) out[i] = mshadow::half::half_t(in[i]).half_;
+}
+
+inline void Float16ToFloat(const uint16_t* in, float* out, size_t n) {
+  size_t i = 0;
+#if defined(__F16C__)
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+  }
+#endif
+  for (; i < n; ++i) {
+    mshadow::half::half_t h;
+    h.half_ = in[i];
+    out[i] = static_cast<float>(h);
+  }
+}
+
+/*!
+ * \brief float32 to bfloat16, the upper half of a float32, rounding to nearest even.
+ *  The loops are branch free so that compilers vectorize them.
+ */
+inline void FloatToBFloat16(const float* in, uint16_t* out, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t bits;
+    std::memcpy(&bits, in + i, sizeof(bits));
+    const uint32_t rounded = bits + 0x7fff + ((bits >> 16) & 1);
+    // keep NaNs quiet instead of rounding them to infinity
+    const bool nan = (bits & 0x7fffffff) > 0x7f800000;
+    out[i] = static_cast<uint16_t>(nan ? (bits >> 16) | 0x40 : rounded >> 16);
+  }
+}
+
+inline void BFloat16ToFloat(const uint16_t* in, float* out, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    const uint32_t bits = static_cast<uint32_t>(in[i]) << 16;
+    std::memcpy(out + i, &bits, sizeof(bits));
+  }
+}
+
+/*!
+ * \brief casts n float32 values to the 16 bit wire type
+ * \param bfloat16 whether the wire type is bfloat16 or float16
+ */
+inline void CastToWire(const float* in, char* out, size_t n, bool bfloat16) {
+  uint16_t* wire = reinterpret_cast<uint16_t*>(out);
+  if (bfloat16) {
+    FloatToBFloat16(in, wire, n);
+  } else {
+    FloatToFloat16(in, wire, n);
+  }
+}
+
+/*!
+ * \brief casts n values of the 16 bit wire type to float32
+ */
+inline void CastFromWire(const char* in, float* out, size_t n, bool bfloat16) {
+  const uint16_t* wire = reinterpret_cast<const uint16_t*>(in);
+  if (bfloat16) {
+    BFloat16ToFloat(wire, out, n);
+  } else {
+    Float16ToFloat(wire, out, n);
+  }
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_WIRE_DTYPE_H_
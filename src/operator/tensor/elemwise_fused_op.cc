@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file elemwise_fused_op.cc
+ * \brief CPU implementation of chains of fused elementwise operators
+ */
+#include "./elemwise_fused_op.h"
+
+namespace mxnet {
+namespace op {
+
+inline bool FusedElemwiseStorageType(const nnvm::NodeAttrs& attrs,
+                                     const int dev_mask,
+                                     DispatchMode* dispatch_mode,
+                                     std::vector<int> *in_attrs,
+                                     std::vector<int> *out_attrs) {
+  CHECK_EQ(out_attrs->size(), 1U);
+  return ElemwiseStorageAttr<false, false, false>(attrs, dev_mask, dispatch_mode,
+                                                  in_attrs, out_attrs);
+}
+
+NNVM_REGISTER_OP(_FusedElemwise)
+.describe(R"doc(Chain of elementwise operators evaluated in a single pass over memory.
+
+Created by the elementwise fusion pass of the executors on CPU.
+The ``program`` lists the fused operators, separated by ``;``. Each of them is
+the operator name followed by the registers it reads and its scalar. Registers
+``0`` to ``num_inputs - 1`` are the inputs, register ``num_inputs + i`` is the
+result of the i-th operator and the result of the last one is the output, e.g.
+``elemwise_add 0 1;relu 2;_mul_scalar 3 0.5``.
+
+)doc" ADD_FILELINE)
+.set_attr_parser(FusedElemwiseParamParser)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(nnvm::get<FusedElemwiseParam>(attrs.parsed).num_inputs);
+  })
+.set_num_outputs(1)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    const int num_inputs = nnvm::get<FusedElemwiseParam>(attrs.parsed).num_inputs;
+    std::vector<std::string> ret;
+    for (int i = 0; i < num_inputs; ++i) {
+      ret.push_back(std::string("arg") + std::to_string(i));
+    }
+    return ret;
+  })
+.set_attr<std::string>("key_var_num_args", "num_inputs")
+.set_attr<nnvm::FInferShape>("FInferShape", ElemwiseShape<-1, 1>)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<-1, 1>)
+.set_attr<FInferStorageType>("FInferStorageType", FusedElemwiseStorageType)
+.set_attr<nnvm::FInplaceOption>("FInplaceOption",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::pair<int, int> >{{0, 0}};
+  })
+.set_attr<FCompute>("FCompute<cpu>", FusedElemwiseCompute<cpu>)
+.add_argument("args", "NDArray-or-Symbol[]", "Inputs of the fused operators")
+.add_argument("program", "string", "The fused operators");
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,251 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file elemwise_fused_op.h
+ * \brief Chains of elementwise operators evaluated in a single pass over memory.
+ */
+#ifndef MXNET_OPERATOR_TENSOR_ELEMWISE_FUSED_OP_H_
+#define MXNET_OPERATOR_TENSOR_ELEMWISE_FUSED_OP_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/operator_util.h>
+#include <mxnet/op_attr_types.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../mshadow_op.h"
+#include "../elemwise_op_common.h"
+#include "../../engine/openmp.h"
+
+namespace mxnet {
+namespace op {
+
+namespace fused_elemwise {
+enum FusedElemwiseOpType {
+  // binary
+  kAdd, kSub, kMul, kDiv, kMaximum, kMinimum,
+  // with a scalar
+  kPlusScalar, kMinusScalar, kRMinusScalar, kMulScalar, kDivScalar, kRDivScalar,
+  kMaximumScalar, kMinimumScalar, kPowerScalar, kRPowerScalar,
+  // unary
+  kRelu, kSigmoid, kTanh, kSoftReLU, kSoftSign, kExp, kLog, kSqrt, kSquare, kAbs, kNegative
+};
+/*! \brief maximum number of operators fused into one node */
+const int kMaxSteps = 16;
+/*! \brief number of elements evaluated by all steps before moving to the next block */
+const int kBlockSize = 256;
+}  // namespace fused_elemwise
+
+/*! \brief type and number of register operands of a fusible operator */
+struct FusedElemwiseOpInfo {
+  fused_elemwise::FusedElemwiseOpType type;
+  int num_args;
+  bool has_scalar;
+};
+
+/*!
+ * \brief Fusible operators by the name they have in the program of a fused node.
+ *  Activation is named by its act_type.
+ */
+inline const std::unordered_map<std::string, FusedElemwiseOpInfo>& FusedElemwiseOps() {
+  using namespace fused_elemwise;
+  static const std::unordered_map<std::string, FusedElemwiseOpInfo> ops = {
+    {"elemwise_add", {kAdd, 2, false}},
+    {"elemwise_sub", {kSub, 2, false}},
+    {"elemwise_mul", {kMul, 2, false}},
+    {"elemwise_div", {kDiv, 2, false}},
+    {"_maximum", {kMaximum, 2, false}},
+    {"_minimum", {kMinimum, 2, false}},
+    {"_plus_scalar", {kPlusScalar, 1, true}},
+    {"_minus_scalar", {kMinusScalar, 1, true}},
+    {"_rminus_scalar", {kRMinusScalar, 1, true}},
+    {"_mul_scalar", {kMulScalar, 1, true}},
+    {"_div_scalar", {kDivScalar, 1, true}},
+    {"_rdiv_scalar", {kRDivScalar, 1, true}},
+    {"_maximum_scalar", {kMaximumScalar, 1, true}},
+    {"_minimum_scalar", {kMinimumScalar, 1, true}},
+    {"_power_scalar", {kPowerScalar, 1, true}},
+    {"_rpower_scalar", {kRPowerScalar, 1, true}},
+    {"relu", {kRelu, 1, false}},
+    {"sigmoid", {kSigmoid, 1, false}},
+    {"tanh", {kTanh, 1, false}},
+    {"softrelu", {kSoftReLU, 1, false}},
+    {"softsign", {kSoftSign, 1, false}},
+    {"exp", {kExp, 1, false}},
+    {"log", {kLog, 1, false}},
+    {"sqrt", {kSqrt, 1, false}},
+    {"square", {kSquare, 1, false}},
+    {"abs", {kAbs, 1, false}},
+    {"negative", {kNegative, 1, false}},
+  };
+  return ops;
+}
+
+/*! \brief one operator of a fused node, reading registers lhs and rhs */
+struct FusedElemwiseStep {
+  fused_elemwise::FusedElemwiseOpType type;
+  int lhs;
+  int rhs;
+  double scalar;
+};
+
+/*!
+ * \brief Parsed program of a fused node.
+ *  Registers [0, num_inputs) are the inputs, register num_inputs + i is the
+ *  result of step i. The result of the last step is the output.
+ */
+struct FusedElemwiseParam {
+  int num_inputs;
+  std::vector<FusedElemwiseStep> steps;
+};
+
+/*!
+ * \brief Parse the "program" attribute, steps separated by ';', each of them
+ *  the operator name followed by its registers and scalar, e.g.
+ *  "elemwise_add 0 1;relu 2;_mul_scalar 3 0.5".
+ */
+inline void FusedElemwiseParamParser(nnvm::NodeAttrs* attrs) {
+  FusedElemwiseParam param;
+  auto num_inputs = attrs->dict.find("num_inputs");
+  auto program = attrs->dict.find("program");
+  CHECK(num_inputs != attrs->dict.end() && program != attrs->dict.end())
+      << "_FusedElemwise requires the num_inputs and program attributes";
+  param.num_inputs = std::stoi(num_inputs->second);
+  CHECK_GT(param.num_inputs, 0);
+  std::istringstream steps(program->second);
+  for (std::string line; std::getline(steps, line, ';');) {
+    std::istringstream is(line);
+    std::string name;
+    is >> name;
+    auto it = FusedElemwiseOps().find(name);
+    CHECK(it != FusedElemwiseOps().end()) << "Operator " << name << " cannot be fused";
+    FusedElemwiseStep step{it->second.type, -1, -1, 0};
+    is >> step.lhs;
+    if (it->second.num_args == 2) is >> step.rhs;
+    if (it->second.has_scalar) is >> step.scalar;
+    CHECK(!is.fail()) << "Invalid step \"" << line << "\" of _FusedElemwise " << attrs->name;
+    const int num_registers = param.num_inputs + static_cast<int>(param.steps.size());
+    CHECK(step.lhs >= 0 && step.lhs < num_registers && step.rhs < num_registers)
+        << "Step \"" << line << "\" reads an undefined register";
+    param.steps.push_back(step);
+  }
+  CHECK(!param.steps.empty()) << "_FusedElemwise " << attrs->name << " has no steps";
+  CHECK_LE(param.steps.size(), static_cast<size_t>(fused_elemwise::kMaxSteps));
+  attrs->parsed = std::move(param);
+}
+
+/*! \brief Apply one step to len elements, with the numerics of the unfused operators. */
+template<typename DType>
+inline void FusedElemwiseStepRun(const FusedElemwiseStep& step, const DType* a,
+                                 const DType* b, DType* out, int len) {
+  using namespace fused_elemwise;
+  const DType s = static_cast<DType>(step.scalar);
+#define MXNET_FUSED_ELEMWISE_LOOP(expr)  \
+  for (int i = 0; i < len; ++i) out[i] = (expr); \
+  break
+  switch (step.type) {
+    case kAdd: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::plus::Map(a[i], b[i]));
+    case kSub: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::minus::Map(a[i], b[i]));
+    case kMul: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::mul::Map(a[i], b[i]));
+    case kDiv: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::div::Map(a[i], b[i]));
+    case kMaximum: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::maximum::Map(a[i], b[i]));
+    case kMinimum: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::minimum::Map(a[i], b[i]));
+    case kPlusScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::plus::Map(a[i], s));
+    case kMinusScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::minus::Map(a[i], s));
+    case kRMinusScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::rminus::Map(a[i], s));
+    case kMulScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::mul::Map(a[i], s));
+    case kDivScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::div::Map(a[i], s));
+    case kRDivScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::rdiv::Map(a[i], s));
+    case kMaximumScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::maximum::Map(a[i], s));
+    case kMinimumScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::minimum::Map(a[i], s));
+    case kPowerScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::power::Map(a[i], s));
+    case kRPowerScalar: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::rpower::Map(a[i], s));
+    case kRelu: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::relu::Map(a[i]));
+    case kSigmoid: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::sigmoid::Map(a[i]));
+    case kTanh: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::tanh::Map(a[i]));
+    case kSoftReLU: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::softrelu::Map(a[i]));
+    case kSoftSign: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::softsign::Map(a[i]));
+    case kExp: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::exp::Map(a[i]));
+    case kLog: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::log::Map(a[i]));
+    case kSqrt: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::square_root::Map(a[i]));
+    case kSquare: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::square::Map(a[i]));
+    case kAbs: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::abs::Map(a[i]));
+    case kNegative: MXNET_FUSED_ELEMWISE_LOOP(mshadow_op::negation::Map(a[i]));
+    default:
+      LOG(FATAL) << "Unknown fused elementwise operator " << step.type;
+  }
+#undef MXNET_FUSED_ELEMWISE_LOOP
+}
+
+/*!
+ * \brief Run all steps on one block of elements before moving to the next, so
+ *  intermediate results stay in cache and only the output is written to memory.
+ */
+template<typename DType>
+inline void FusedElemwiseRun(const FusedElemwiseParam& param,
+                             const std::vector<const DType*>& inputs,
+                             DType* out, int64_t size, OpReqType req) {
+  using namespace fused_elemwise;
+  const int num_blocks = static_cast<int>((size + kBlockSize - 1) / kBlockSize);
+  const int num_steps = static_cast<int>(param.steps.size());
+  #pragma omp parallel for num_threads(engine::OpenMP::Get()->GetRecommendedOMPThreadCount())
+  for (int block = 0; block < num_blocks; ++block) {
+    DType buf[kMaxSteps][kBlockSize];
+    const int64_t start = static_cast<int64_t>(block) * kBlockSize;
+    const int len = static_cast<int>(std::min<int64_t>(kBlockSize, size - start));
+    auto reg = [&](int r) -> const DType* {
+      return r < param.num_inputs ? inputs[r] + start : buf[r - param.num_inputs];
+    };
+    for (int s = 0; s < num_steps; ++s) {
+      const FusedElemwiseStep& step = param.steps[s];
+      DType* dst = s + 1 == num_steps && req != kAddTo ? out + start : buf[s];
+      FusedElemwiseStepRun(step, reg(step.lhs), step.rhs >= 0 ? reg(step.rhs) : nullptr,
+                           dst, len);
+    }
+    if (req == kAddTo) {
+      for (int i = 0; i < len; ++i) out[start + i] += buf[num_steps - 1][i];
+    }
+  }
+}
+
+template<typename xpu>
+void FusedElemwiseCompute(const nnvm::NodeAttrs& attrs,
+                          const OpContext& ctx,
+                          const std::vector<TBlob>& inputs,
+                          const std::vector<OpReqType>& req,
+                          const std::vector<TBlob>& outputs) {
+  const FusedElemwiseParam& param = nnvm::get<FusedElemwiseParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), static_cast<size_t>(param.num_inputs));
+  CHECK_EQ(outputs.size(), 1U);
+  if (req[0] == kNullOp) return;
+  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+    std::vector<const DType*> in_ptrs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) in_ptrs[i] = inputs[i].dptr<DType>();
+    FusedElemwiseRun(param, in_ptrs, outputs[0].dptr<DType>(),
+                     static_cast<int64_t>(outputs[0].Size()), req[0]);
+  });
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_TENSOR_ELEMWISE_FUSED_OP_H_
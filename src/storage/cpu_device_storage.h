@@ -26,6 +26,10 @@
 #define MXNET_STORAGE_CPU_DEVICE_STORAGE_H_
 
 #include <dmlc/logging.h>
+#if defined(__linux__)
+#include <unistd.h>
+#endif  // defined(__linux__)
+#include <cstdio>
 #include <cstdlib>
 #include <new>
 #include "mxnet/base.h"
@@ -49,6 +53,17 @@ class CPUDeviceStorage {
    * \param ptr Pointer to deallocate.
    */
   inline static void Free(void* ptr);
+  /*!
+   * \brief Physical memory of the host.
+   * \param free Bytes of available memory, including the reclaimable page cache.
+   * \param total Bytes of total memory.
+   * \return Whether the memory usage is known on this platform.
+   */
+  inline static bool MemoryInfo(size_t* free, size_t* total);
+  /*!
+   * \brief Page size of the host.
+   */
+  inline static size_t PageSize();
 
  private:
   /*!
@@ -83,6 +98,37 @@ inline void CPUDeviceStorage::Free(void* ptr) {
 #endif
 }
 
+inline bool CPUDeviceStorage::MemoryInfo(size_t* free, size_t* total) {
+#if defined(__linux__)
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  *total = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * page_size;
+  // MemFree, as reported by _SC_AVPHYS_PAGES, leaves out the page cache
+  FILE* meminfo = fopen("/proc/meminfo", "r");
+  if (meminfo == nullptr) return false;
+  char line[256];
+  size_t available_kb = 0;
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), meminfo) != nullptr) {
+    found = sscanf(line, "MemAvailable: %zu kB", &available_kb) == 1;
+  }
+  fclose(meminfo);
+  // kernels before 3.14 do not report MemAvailable
+  *free = found ? available_kb << 10 :
+          static_cast<size_t>(sysconf(_SC_AVPHYS_PAGES)) * page_size;
+  return true;
+#else
+  return false;
+#endif  // defined(__linux__)
+}
+
+inline size_t CPUDeviceStorage::PageSize() {
+#if defined(__linux__)
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return 4096;
+#endif  // defined(__linux__)
+}
+
 }  // namespace storage
 }  // namespace mxnet
 
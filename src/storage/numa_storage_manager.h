@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file numa_storage_manager.h
+ * \brief Storage manager placing memory on a NUMA node.
+ */
+#ifndef MXNET_STORAGE_NUMA_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_NUMA_STORAGE_MANAGER_H_
+
+#include <mxnet/base.h>
+#include <mxnet/storage.h>
+#include <memory>
+#include "./storage_manager.h"
+#include "../common/numa.h"
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager binding the memory of another storage manager to a NUMA node.
+ *  Only large blocks are bound explicitly; the pages of small blocks are placed by
+ *  the first touch, which happens on the workers bound to the same node.
+ */
+class NUMAStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param manager storage manager doing the allocation, owned by this manager.
+   * \param node id of the NUMA node to place the memory on.
+   */
+  NUMAStorageManager(StorageManager* manager, int node)
+    : manager_(manager), node_(node) {}
+  /*!
+   * \brief Default destructor.
+   */
+  ~NUMAStorageManager() = default;
+
+  void Alloc(Storage::Handle* handle) override {
+    manager_->Alloc(handle);
+    if (handle->size >= kMinBindSize) {
+      common::BindMemoryToNumaNode(handle->dptr, handle->size, node_);
+    }
+  }
+
+  void Free(Storage::Handle handle) override {
+    manager_->Free(handle);
+  }
+
+  void DirectFree(Storage::Handle handle) override {
+    manager_->DirectFree(handle);
+  }
+
+  void ReleaseAll() override {
+    manager_->ReleaseAll();
+  }
+
+ private:
+  // smallest block bound explicitly
+  static constexpr size_t kMinBindSize = 1 << 20;
+  // storage manager doing the allocation
+  std::unique_ptr<StorageManager> manager_;
+  // NUMA node of the memory
+  int node_;
+  DISALLOW_COPY_AND_ASSIGN(NUMAStorageManager);
+};  // class NUMAStorageManager
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_NUMA_STORAGE_MANAGER_H_
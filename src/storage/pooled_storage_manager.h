@@ -30,114 +30,236 @@
 #endif  // MXNET_USE_CUDA
 #include <mxnet/base.h>
 #include <mxnet/storage.h>
+#include <map>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <mutex>
 #include <new>
 #include "./storage_manager.h"
+#include "./cpu_device_storage.h"
 #include "../common/cuda_utils.h"
 
 
 namespace mxnet {
 namespace storage {
 
-#if MXNET_USE_CUDA
 /*!
- * \brief Storage manager with a memory pool on gpu.
+ * \brief Storage manager with a memory pool.
+ *
+ *  Freed blocks are kept in a free list sorted by size. In rounding mode, requests
+ *  are rounded up to a power of two below 2^cutoff bytes and to a multiple of the
+ *  linear granularity above it, and are served by the smallest cached block that
+ *  fits. Otherwise only blocks of the exact requested size are reused.
+ *
+ * \tparam DeviceStorage raw allocator of the device. It provides the static functions
+ *  Alloc(size), Free(ptr) and MemoryInfo(&free, &total); the latter returns false
+ *  when the device cannot report its memory usage. They are called with the device
+ *  mutex of the storage held.
  */
-class GPUPooledStorageManager final : public StorageManager {
+template <class DeviceStorage>
+class PooledStorageManager final : public StorageManager {
  public:
   /*!
-   * \brief Default constructor.
+   * \brief Constructor.
+   * \param dev_type device type, selects the storage mutex to lock.
+   * \param env_prefix prefix of the environment variables configuring the pool.
+   * \param round whether to round request sizes and reuse best-fit blocks.
+   * \param cut_off default log2 of the size above which block sizes grow linearly.
+   * \param linear_granularity bytes the block sizes above the cutoff are multiples of.
+   * \param padding extra bytes allocated with every block.
+   * \param reserve default percentage of device memory to keep free, 0 to never
+   *  query the memory of the device.
    */
-  GPUPooledStorageManager() {
-    reserve_ = dmlc::GetEnv("MXNET_GPU_MEM_POOL_RESERVE", 5);
+  PooledStorageManager(Context::DeviceType dev_type, const std::string& env_prefix,
+                       bool round, int cut_off, size_t linear_granularity, size_t padding = 0,
+                       int reserve = 5)
+    : dev_type_(dev_type), round_(round), padding_(padding),
+      linear_granularity_(linear_granularity) {
+    reserve_ = dmlc::GetEnv((env_prefix + "_RESERVE").c_str(), reserve);
+    max_memory_ = dmlc::GetEnv((env_prefix + "_LIMIT").c_str(), static_cast<size_t>(0)) << 20;
+    cut_off_ = dmlc::GetEnv((env_prefix + "_ROUND_LINEAR_CUTOFF").c_str(), cut_off);
+    CHECK(cut_off_ > 0 && cut_off_ < 48)
+      << env_prefix << "_ROUND_LINEAR_CUTOFF must be in range (0, 48)";
+    CHECK_GT(linear_granularity_, 0U) << "The linear granularity of the pool must be positive";
   }
   /*!
    * \brief Default destructor.
    */
-  ~GPUPooledStorageManager() {
-    ReleaseAll();
+  ~PooledStorageManager() {
+    ReleaseAllNoLock();
   }
 
   void Alloc(Storage::Handle* handle) override;
   void Free(Storage::Handle handle) override;
 
   void DirectFree(Storage::Handle handle) override {
-    std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(Context::kGPU));
-    DirectFreeNoLock(handle);
+    std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(dev_type_));
+    DirectFreeNoLock(handle.dptr, TakeBlockSize(handle));
+  }
+
+  void ReleaseAll() override {
+    std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(dev_type_));
+    ReleaseAllNoLock();
+  }
+  /*!
+   * \brief Bytes allocated from the device, including the blocks held in the pool.
+   */
+  size_t used_memory() const {
+    return used_memory_;
   }
 
  private:
-  void DirectFreeNoLock(Storage::Handle handle) {
-    cudaError_t err = cudaFree(handle.dptr);
-    size_t size = handle.size + NDEV;
-    // ignore unloading error, as memory has already been recycled
-    if (err != cudaSuccess && err != cudaErrorCudartUnloading) {
-      LOG(FATAL) << "CUDA: " << cudaGetErrorString(err);
+  /*!
+   * \brief Block size for a request of the given number of bytes.
+   */
+  size_t RoundAllocSize(size_t size) const {
+    size += padding_;
+    if (!round_) return size;
+    if (size >= static_cast<size_t>(1) << cut_off_) {
+      return (size + linear_granularity_ - 1) / linear_granularity_ * linear_granularity_;
     }
+    size_t rounded = kMinAllocSize;
+    while (rounded < size) rounded <<= 1;
+    return rounded;
+  }
+  /*!
+   * \brief Size of the block behind a handle, forgetting any best-fit record of it.
+   */
+  size_t TakeBlockSize(const Storage::Handle& handle) {
+    if (!fitted_blocks_.empty()) {
+      auto it = fitted_blocks_.find(handle.dptr);
+      if (it != fitted_blocks_.end()) {
+        size_t size = it->second;
+        fitted_blocks_.erase(it);
+        return size;
+      }
+    }
+    return RoundAllocSize(handle.size);
+  }
+  /*!
+   * \brief Whether cached blocks should be returned to the device before allocating.
+   */
+  bool UnderMemoryPressure(size_t size) const {
+    if (max_memory_ != 0 && used_memory_ + size > max_memory_) return true;
+    size_t free, total;
+    if (reserve_ > 0 && DeviceStorage::MemoryInfo(&free, &total)) {
+      if (free <= total * reserve_ / 100 || size > free - total * reserve_ / 100)
+        return true;
+    }
+    return false;
+  }
+
+  void DirectFreeNoLock(void* dptr, size_t size) {
+    DeviceStorage::Free(dptr);
     used_memory_ -= size;
   }
 
- private:
-  void ReleaseAll();
-  // used memory
+  void ReleaseAllNoLock();
+  // smallest block size when rounding
+  static constexpr size_t kMinAllocSize = 64;
+  // a cached block is reused for requests of at least 1/kMaxFitRatio of its size
+  static constexpr size_t kMaxFitRatio = 2;
+  // device type of the pool
+  Context::DeviceType dev_type_;
+  // whether request sizes are rounded
+  bool round_;
+  // extra bytes allocated with every block
+  size_t padding_;
+  // used memory, including the blocks held in the pool
   size_t used_memory_ = 0;
+  // maximum memory allocated from the device before releasing the pool, 0 for no limit
+  size_t max_memory_;
   // percentage of reserved memory
   int reserve_;
-  // number of devices
-  const int NDEV = 32;
-  // memory pool
-  std::unordered_map<size_t, std::vector<void*>> memory_pool_;
-  DISALLOW_COPY_AND_ASSIGN(GPUPooledStorageManager);
-};  // class GPUPooledStorageManager
-
-void GPUPooledStorageManager::Alloc(Storage::Handle* handle) {
-  std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(Context::kGPU));
-  size_t size = handle->size + NDEV;
-  auto&& reuse_it = memory_pool_.find(size);
-  if (reuse_it == memory_pool_.end() || reuse_it->second.size() == 0) {
-    size_t free, total;
-    cudaMemGetInfo(&free, &total);
-    if (free <= total * reserve_ / 100 || size > free - total * reserve_ / 100)
-      ReleaseAll();
+  // bytes the block sizes above the cutoff are multiples of
+  size_t linear_granularity_;
+  // log2 of the size above which block sizes grow linearly
+  int cut_off_;
+  // memory pool, sorted by block size
+  std::map<size_t, std::vector<void*>> memory_pool_;
+  // blocks in use that are larger than the rounded size of their request
+  std::unordered_map<void*, size_t> fitted_blocks_;
+  DISALLOW_COPY_AND_ASSIGN(PooledStorageManager);
+};  // class PooledStorageManager
 
-    void* ret = nullptr;
-    cudaError_t e = cudaMalloc(&ret, size);
-    if (e != cudaSuccess && e != cudaErrorCudartUnloading) {
-      LOG(FATAL) << "cudaMalloc failed: " << cudaGetErrorString(e);
-    }
+template <class DeviceStorage>
+void PooledStorageManager<DeviceStorage>::Alloc(Storage::Handle* handle) {
+  std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(dev_type_));
+  size_t size = RoundAllocSize(handle->size);
+  auto reuse_it = round_ ? memory_pool_.lower_bound(size) : memory_pool_.find(size);
+  if (reuse_it != memory_pool_.end() && reuse_it->first > size * kMaxFitRatio) {
+    reuse_it = memory_pool_.end();
+  }
+  if (reuse_it == memory_pool_.end()) {
+    // nothing to release from an empty pool
+    if (!memory_pool_.empty() && UnderMemoryPressure(size)) ReleaseAllNoLock();
+    handle->dptr = DeviceStorage::Alloc(size);
     used_memory_ += size;
-    handle->dptr = ret;
   } else {
     auto&& reuse_pool = reuse_it->second;
-    auto ret = reuse_pool.back();
+    handle->dptr = reuse_pool.back();
     reuse_pool.pop_back();
-    handle->dptr = ret;
+    if (reuse_it->first != size) fitted_blocks_[handle->dptr] = reuse_it->first;
+    if (reuse_pool.empty()) memory_pool_.erase(reuse_it);
   }
 }
 
-void GPUPooledStorageManager::Free(Storage::Handle handle) {
-  std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(Context::kGPU));
-  size_t size = handle.size + NDEV;
-  auto&& reuse_pool = memory_pool_[size];
-  reuse_pool.push_back(handle.dptr);
+template <class DeviceStorage>
+void PooledStorageManager<DeviceStorage>::Free(Storage::Handle handle) {
+  std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(dev_type_));
+  memory_pool_[TakeBlockSize(handle)].push_back(handle.dptr);
 }
 
-void GPUPooledStorageManager::ReleaseAll() {
+template <class DeviceStorage>
+void PooledStorageManager<DeviceStorage>::ReleaseAllNoLock() {
   for (auto&& i : memory_pool_) {
     for (auto&& j : i.second) {
-      Storage::Handle handle;
-      handle.dptr = j;
-      handle.size = i.first - NDEV;
-      DirectFreeNoLock(handle);
+      DirectFreeNoLock(j, i.first);
     }
   }
   memory_pool_.clear();
 }
 
+#if MXNET_USE_CUDA
+/*!
+ * \brief Raw gpu allocation for the gpu memory pool.
+ */
+class GPUPoolDeviceStorage {
+ public:
+  inline static void* Alloc(size_t size) {
+    void* ret = nullptr;
+    cudaError_t e = cudaMalloc(&ret, size);
+    if (e != cudaSuccess && e != cudaErrorCudartUnloading) {
+      LOG(FATAL) << "cudaMalloc failed: " << cudaGetErrorString(e);
+    }
+    return ret;
+  }
+
+  inline static void Free(void* ptr) {
+    cudaError_t err = cudaFree(ptr);
+    // ignore unloading error, as memory has already been recycled
+    if (err != cudaSuccess && err != cudaErrorCudartUnloading) {
+      LOG(FATAL) << "CUDA: " << cudaGetErrorString(err);
+    }
+  }
+
+  inline static bool MemoryInfo(size_t* free, size_t* total) {
+    return cudaMemGetInfo(free, total) == cudaSuccess;
+  }
+};  // class GPUPoolDeviceStorage
+
+/*!
+ * \brief Storage manager with a memory pool on gpu.
+ */
+typedef PooledStorageManager<GPUPoolDeviceStorage> GPUPooledStorageManager;
 #endif  // MXNET_USE_CUDA
 
+/*!
+ * \brief Storage manager with a memory pool on cpu.
+ */
+typedef PooledStorageManager<CPUDeviceStorage> CPUPooledStorageManager;
+
 }  // namespace storage
 }  // namespace mxnet
 
@@ -21,12 +21,14 @@
  * Copyright (c) 2015 by Contributors
  */
 #include <mxnet/storage.h>
+#include <string>
 #include "./storage_manager.h"
 #include "./naive_storage_manager.h"
 #include "./pooled_storage_manager.h"
 #include "./cpu_shared_storage_manager.h"
 #include "./cpu_device_storage.h"
 #include "./pinned_memory_storage.h"
+#include "./numa_storage_manager.h"
 #include "../common/lazy_alloc_array.h"
 #include "../profiler/storage_profiler.h"
 
@@ -39,11 +41,19 @@ class StorageImpl : public Storage {
   void Free(Handle handle) override;
   void DirectFree(Handle handle) override;
   void SharedIncrementRefCount(Handle handle) override;
+  void ReleaseAll(Context ctx) override;
   StorageImpl() {}
   virtual ~StorageImpl() = default;
 
  private:
   static constexpr size_t kMaxNumberOfDevices = Context::kMaxDevType + 1;
+  // index of the storage manager of a context, cpu contexts have one per NUMA node if bound
+  static int ManagerIndex(const Context& ctx) {
+    if (ctx.dev_type == Context::kCPU && common::NumaBindingEnabled()) {
+      return common::NumaNodeOfContext(ctx);
+    }
+    return ctx.real_dev_id();
+  }
 #if MXNET_USE_CUDA
   static int num_gpu_device;
 #endif  // MXNET_USE_CUDA
@@ -84,11 +94,27 @@ void StorageImpl::Alloc(Storage::Handle* handle) {
   // space already recycled, ignore request
   auto&& device = storage_managers_.at(handle->ctx.dev_type);
   std::shared_ptr<storage::StorageManager> manager = device.Get(
-      handle->ctx.real_dev_id(), [handle]() {
+      ManagerIndex(handle->ctx), [handle]() {
         storage::StorageManager *ptr = nullptr;
         switch (handle->ctx.dev_type) {
           case Context::kCPU: {
-            ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
+            std::string pool_type = dmlc::GetEnv("MXNET_CPU_MEM_POOL_TYPE", std::string("Naive"));
+            if (pool_type == "Pooled") {
+              // page multiples above the cutoff, no reserve unless asked for
+              ptr = new storage::CPUPooledStorageManager(Context::kCPU, "MXNET_CPU_MEM_POOL",
+                                                         true, 20,
+                                                         storage::CPUDeviceStorage::PageSize(),
+                                                         0, 0);
+            } else if (pool_type == "Naive") {
+              ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
+            } else {
+              LOG(FATAL) << "Unknown CPU memory pool type " << pool_type
+                         << ", expected Naive or Pooled";
+            }
+            if (common::NumaBindingEnabled()) {
+              const int node = common::NumaNodeOfContext(handle->ctx);
+              ptr = new storage::NUMAStorageManager(ptr, common::NumaNodes()[node].id);
+            }
             break;
           }
           case Context::kCPUShared: {
@@ -118,7 +144,15 @@ void StorageImpl::Alloc(Storage::Handle* handle) {
 #if MXNET_USE_CUDA
             CUDA_CALL(cudaGetDeviceCount(&num_gpu_device));
             CHECK_GT(num_gpu_device, 0) << "GPU usage requires at least 1 GPU";
-            ptr = new storage::GPUPooledStorageManager();
+            std::string pool_type = dmlc::GetEnv("MXNET_GPU_MEM_POOL_TYPE", std::string("Naive"));
+            if (pool_type != "Naive" && pool_type != "Round") {
+              LOG(FATAL) << "Unknown GPU memory pool type " << pool_type
+                         << ", expected Naive or Round";
+            }
+            const size_t granularity = dmlc::GetEnv("MXNET_GPU_MEM_POOL_ROUND_LINEAR_GRANULARITY",
+                                                    static_cast<size_t>(1) << 24);
+            ptr = new storage::GPUPooledStorageManager(Context::kGPU, "MXNET_GPU_MEM_POOL",
+                                                       pool_type == "Round", 24, granularity, 32);
 #else
             LOG(FATAL) << "Compile with USE_CUDA=1 to enable GPU usage";
 #endif  // MXNET_USE_CUDA
@@ -138,7 +172,7 @@ void StorageImpl::Free(Storage::Handle handle) {
   const Context &ctx = handle.ctx;
   auto&& device = storage_managers_.at(ctx.dev_type);
   std::shared_ptr<storage::StorageManager> manager = device.Get(
-      ctx.real_dev_id(), []() {
+      ManagerIndex(ctx), []() {
         LOG(FATAL) <<  "Cannot Free space to a device you have not allocated";
         return nullptr;
       });
@@ -151,7 +185,7 @@ void StorageImpl::DirectFree(Storage::Handle handle) {
   const Context &ctx = handle.ctx;
   auto&& device = storage_managers_.at(ctx.dev_type);
   std::shared_ptr<storage::StorageManager> manager = device.Get(
-      ctx.real_dev_id(), []() {
+      ManagerIndex(ctx), []() {
         LOG(FATAL) <<  "Cannot Free space to a device you have not allocated";
         return nullptr;
       });
@@ -174,6 +208,16 @@ void StorageImpl::SharedIncrementRefCount(Storage::Handle handle) {
 #endif  // defined(ANDROID) || defined(__ANDROID__)
 }
 
+void StorageImpl::ReleaseAll(Context ctx) {
+  auto&& device = storage_managers_.at(ctx.dev_type);
+  const int dev_id = ManagerIndex(ctx);
+  device.ForEach([this, ctx, dev_id](size_t i, storage::StorageManager *manager) {
+      if (static_cast<int>(i) != dev_id) return;
+      this->ActivateDevice(ctx);
+      manager->ReleaseAll();
+    });
+}
+
 std::shared_ptr<Storage> Storage::_GetSharedRef() {
 #ifdef __MXNET_JS__
   // dummy code needed for emscripten code to pass
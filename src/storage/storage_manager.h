@@ -55,6 +55,10 @@ class StorageManager {
    * \param size Size of the storage.
    */
   virtual void DirectFree(Storage::Handle handle) = 0;
+  /*!
+   * \brief Release all memory held in the pool, if any, back to the device.
+   */
+  virtual void ReleaseAll() {}
   /*!
    * \brief Destructor.
    */
@@ -29,9 +29,12 @@
 #include <gtest/gtest.h>
 #include <mxnet/engine.h>
 #include <dmlc/timer.h>
+#include <dmlc/parameter.h>
 #include <cstdio>
 #include <thread>
 #include <chrono>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "../src/engine/engine_impl.h"
@@ -124,7 +127,7 @@ double EvaluateWorloads(const std::vector<Workload>& workloads,
 TEST(Engine, RandSumExpr) {
   std::vector<Workload> workloads;
   int num_repeat = 5;
-  const int num_engine = 4;
+  const int num_engine = 5;
 
   std::vector<double> t(num_engine, 0.0);
   std::vector<mxnet::Engine*> engine(num_engine);
@@ -133,6 +136,7 @@ TEST(Engine, RandSumExpr) {
   engine[1] = mxnet::engine::CreateNaiveEngine();
   engine[2] = mxnet::engine::CreateThreadedEnginePooled();
   engine[3] = mxnet::engine::CreateThreadedEnginePerDevice();
+  engine[4] = mxnet::engine::CreateThreadedEngineWorkStealing();
 
   for (int repeat = 0; repeat < num_repeat; ++repeat) {
     srand(time(NULL) + repeat);
@@ -155,6 +159,80 @@ TEST(Engine, RandSumExpr) {
   LOG(INFO) << "NaiveEngine\t\t"  << t[1] << " sec";
   LOG(INFO) << "ThreadedEnginePooled\t" << t[2] << " sec";
   LOG(INFO) << "ThreadedEnginePerDevice\t" << t[3] << " sec";
+  LOG(INFO) << "ThreadedEngineWorkStealing\t" << t[4] << " sec";
+}
+
+/**
+ * push num_ops trivial operators, each mutating one of num_var variables,
+ * and return the number of operators executed per second
+ */
+double PushTrivialOps(mxnet::Engine* engine, int num_ops, int num_var) {
+  using namespace mxnet;
+  std::vector<Engine::VarHandle> vars;
+  for (int i = 0; i < num_var; ++i) {
+    vars.push_back(engine->NewVariable());
+  }
+  std::atomic<int> count{0};
+  double t = dmlc::GetTime();
+  for (int i = 0; i < num_ops; ++i) {
+    engine->PushAsync([&count](RunContext ctx, Engine::CallbackOnComplete cb) {
+        ++count;
+        cb();
+      }, Context::CPU(), {}, {vars[i % num_var]});
+  }
+  engine->WaitForAll();
+  t = dmlc::GetTime() - t;
+  EXPECT_EQ(count.load(), num_ops);
+  for (auto var : vars) {
+    engine->DeleteVariable([](RunContext) {}, Context::CPU(), var);
+  }
+  engine->WaitForAll();
+  return num_ops / t;
+}
+
+TEST(Engine, PushAsyncThroughput) {
+  const int num_ops = mxnet::test::performance_run ? 2000000 : 20000;
+  const int num_var = 64;
+  const std::vector<std::pair<std::string, mxnet::Engine*>> engines = {
+    {"NaiveEngine", mxnet::engine::CreateNaiveEngine()},
+    {"ThreadedEnginePooled", mxnet::engine::CreateThreadedEnginePooled()},
+    {"ThreadedEnginePerDevice", mxnet::engine::CreateThreadedEnginePerDevice()},
+    {"ThreadedEngineWorkStealing", mxnet::engine::CreateThreadedEngineWorkStealing()}
+  };
+  for (const auto& engine : engines) {
+    LOG(INFO) << engine.first << "\t" << PushTrivialOps(engine.second, num_ops, num_var)
+              << " ops/sec";
+  }
+}
+
+/**
+ * many short operators reading a few hot variables, executed by several
+ * worker threads, must give the same result as the naive engine
+ */
+TEST(Engine, ReadHeavyStress) {
+  const int num_repeat = mxnet::test::performance_run ? 20 : 3;
+  const int num_var = 8;
+  const int nthreads = dmlc::GetEnv("MXNET_CPU_WORKER_NTHREADS", 1);
+  dmlc::SetEnv("MXNET_CPU_WORKER_NTHREADS", 8);
+  std::vector<mxnet::Engine*> engines = {
+    mxnet::engine::CreateNaiveEngine(),
+    mxnet::engine::CreateThreadedEnginePooled(),
+    mxnet::engine::CreateThreadedEnginePerDevice(),
+    mxnet::engine::CreateThreadedEngineWorkStealing()
+  };
+  dmlc::SetEnv("MXNET_CPU_WORKER_NTHREADS", nthreads);
+  std::vector<Workload> workloads;
+  for (int repeat = 0; repeat < num_repeat; ++repeat) {
+    GenerateWorkload(20000, num_var, 2, num_var, 0, 1, &workloads);
+    std::vector<std::vector<double>> data(engines.size());
+    for (size_t i = 0; i < engines.size(); ++i) {
+      data[i].resize(num_var, 1.0);
+      EvaluateWorloads(workloads, engines[i], &data[i]);
+    }
+    for (size_t i = 1; i < engines.size(); ++i) {
+      for (int j = 0; j < num_var; ++j) EXPECT_EQ(data[0][j], data[i][j]);
+    }
+  }
 }
 
 void Foo(mxnet::RunContext, int i) { printf("The fox says %d\n", i); }
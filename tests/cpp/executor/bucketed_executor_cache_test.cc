@@ -0,0 +1,182 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file bucketed_executor_cache_test.cc
+ * \brief Unit tests of the bucketed executor cache
+ */
+#include <gtest/gtest.h>
+#include <dmlc/memory_io.h>
+#include <mxnet/c_predict_api.h>
+#include <mxnet/executor.h>
+#include <nnvm/pass_functions.h>
+#include <nnvm/symbolic.h>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "../../src/executor/bucketed_executor_cache.h"
+
+namespace {
+
+nnvm::Symbol FullyConnected(int num_hidden) {
+  nnvm::Symbol data = nnvm::Symbol::CreateVariable("data");
+  nnvm::NodeAttrs attrs;
+  attrs.op = nnvm::Op::Get("FullyConnected");
+  attrs.name = "fc";
+  attrs.dict["num_hidden"] = std::to_string(num_hidden);
+  attrs.op->attr_parser(&attrs);
+  nnvm::Symbol fc = nnvm::Symbol::CreateFunctor(attrs);
+  std::vector<const nnvm::Symbol*> args = {&data};
+  fc.Compose(nnvm::array_view<const nnvm::Symbol*>(args), {}, "fc");
+  return fc;
+}
+
+std::unordered_map<std::string, mxnet::TShape> DataShape(int batch_size) {
+  return {{"data", mxnet::TShape({batch_size, 8})}};
+}
+
+/*!
+ * \brief json and parameters of a fully connected layer of 4 outputs, with weights 0.5
+ *  and biases 1, so that an input of 8 values v gives outputs 4 * v + 1
+ */
+void PredictorModel(std::string* json, std::string* params) {
+  nnvm::Graph g;
+  g.outputs = FullyConnected(4).outputs;
+  *json = nnvm::pass::SaveJSON(g);
+  mxnet::NDArray weight(mxnet::TShape({4, 8}), mxnet::Context::CPU());
+  mxnet::NDArray bias(mxnet::TShape({4}), mxnet::Context::CPU());
+  weight = 0.5f;
+  bias = 1.0f;
+  dmlc::MemoryStringStream fo(params);
+  mxnet::NDArray::Save(&fo, {weight, bias}, {"arg:fc_weight", "arg:fc_bias"});
+}
+
+}  // namespace
+
+TEST(BucketedExecutorCache, HitMissEvict) {
+  using mxnet::Context;
+  nnvm::Symbol fc = FullyConnected(4);
+  const size_t num_args = fc.ListInputNames(nnvm::Symbol::kReadOnlyArgs).size();
+  mxnet::exec::BucketedExecutorCache cache(
+      fc, Context::CPU(), {},
+      std::vector<Context>(num_args, Context::CPU()),
+      std::vector<Context>(num_args, Context::CPU()),
+      {}, {{"data", mshadow::kFloat32}}, {},
+      std::vector<mxnet::OpReqType>(num_args, mxnet::kNullOp),
+      {"fc_weight", "fc_bias"}, 2);
+
+  auto root = cache.Get(DataShape(16));
+  EXPECT_EQ(cache.Get(DataShape(16)), root);
+  EXPECT_EQ(cache.hits(), 1U);
+  EXPECT_EQ(cache.misses(), 1U);
+
+  auto bucket = cache.Get(DataShape(4));
+  EXPECT_NE(bucket, root);
+  EXPECT_EQ(cache.size(), 2U);
+  // parameters are shared with the root
+  EXPECT_EQ(bucket->in_arg_map().at("fc_weight").var(),
+            root->in_arg_map().at("fc_weight").var());
+  bucket->Forward(false);
+  EXPECT_EQ(bucket->outputs()[0].shape(), mxnet::TShape({4, 4}));
+
+  // the root is pinned, so the least recently used bucket is evicted
+  cache.Get(DataShape(8));
+  EXPECT_EQ(cache.size(), 2U);
+  EXPECT_EQ(cache.evictions(), 1U);
+  EXPECT_EQ(cache.Get(DataShape(16)), root);
+  EXPECT_NE(cache.Get(DataShape(4)), bucket);
+  EXPECT_EQ(cache.misses(), 4U);
+  EXPECT_EQ(cache.hits(), 2U);
+  mxnet::NDArray::WaitAll();
+}
+
+TEST(BucketedExecutorCache, PredictorReshape) {
+  std::string json, params;
+  PredictorModel(&json, &params);
+  const char* keys[] = {"data"};
+  const mx_uint indptr[] = {0, 2};
+  const mx_uint large[] = {8, 8};
+  const mx_uint small[] = {2, 8};
+  const std::vector<mx_float> ones(64, 1.0f);
+  for (const char* cache_size : {"0", "2"}) {
+    setenv("MXNET_PREDICTOR_EXEC_CACHE_SIZE", cache_size, 1);
+    PredictorHandle pred, reshaped, restored;
+    ASSERT_EQ(MXPredCreate(json.c_str(), params.data(), params.size(), 1, 0,
+                           1, keys, indptr, large, &pred), 0);
+    ASSERT_EQ(MXPredReshape(1, keys, indptr, small, pred, &reshaped), 0);
+    ASSERT_EQ(MXPredReshape(1, keys, indptr, large, reshaped, &restored), 0);
+    for (auto p : {std::make_pair(reshaped, 2), std::make_pair(restored, 8)}) {
+      std::vector<mx_float> out(p.second * 4);
+      ASSERT_EQ(MXPredSetInput(p.first, "data", ones.data(), p.second * 8), 0);
+      ASSERT_EQ(MXPredForward(p.first), 0);
+      ASSERT_EQ(MXPredGetOutput(p.first, 0, out.data(), out.size()), 0);
+      for (mx_float v : out) EXPECT_FLOAT_EQ(v, 5.0f) << "cache size " << cache_size;
+    }
+    MXPredFree(restored);
+    MXPredFree(reshaped);
+    MXPredFree(pred);
+  }
+  unsetenv("MXNET_PREDICTOR_EXEC_CACHE_SIZE");
+}
+
+TEST(BucketedExecutorCache, PredictorInterleaved) {
+  std::string json, params;
+  PredictorModel(&json, &params);
+  const char* keys[] = {"data"};
+  const mx_uint indptr[] = {0, 2};
+  const mx_uint large[] = {8, 8};
+  const mx_uint small[] = {2, 8};
+  setenv("MXNET_PREDICTOR_EXEC_CACHE_SIZE", "2", 1);
+  // same_exec has the executor of pred, small_exec another one sharing its memory
+  PredictorHandle pred, small_exec, same_exec;
+  ASSERT_EQ(MXPredCreate(json.c_str(), params.data(), params.size(), 1, 0,
+                         1, keys, indptr, large, &pred), 0);
+  ASSERT_EQ(MXPredReshape(1, keys, indptr, small, pred, &small_exec), 0);
+  ASSERT_EQ(MXPredReshape(1, keys, indptr, large, small_exec, &same_exec), 0);
+  const std::vector<std::pair<PredictorHandle, int> > preds = {
+    {pred, 8}, {small_exec, 2}, {same_exec, 8}};
+  // all inputs are set before any forward, and all forwards run before any output is read
+  for (size_t i = 0; i < preds.size(); ++i) {
+    const std::vector<mx_float> data(preds[i].second * 8, static_cast<mx_float>(i + 1));
+    ASSERT_EQ(MXPredSetInput(preds[i].first, "data", data.data(), data.size()), 0);
+  }
+  for (const auto& p : preds) ASSERT_EQ(MXPredForward(p.first), 0);
+  for (size_t i = 0; i < preds.size(); ++i) {
+    std::vector<mx_float> out(preds[i].second * 4);
+    ASSERT_EQ(MXPredGetOutput(preds[i].first, 0, out.data(), out.size()), 0);
+    for (mx_float v : out) EXPECT_FLOAT_EQ(v, 4.0f * (i + 1) + 1) << "predictor " << i;
+  }
+  // a forward of one predictor leaves the outputs of the others alone
+  const std::vector<mx_float> zeros(64, 0.0f);
+  ASSERT_EQ(MXPredSetInput(same_exec, "data", zeros.data(), zeros.size()), 0);
+  ASSERT_EQ(MXPredForward(same_exec), 0);
+  std::vector<mx_float> out(32);
+  ASSERT_EQ(MXPredGetOutput(pred, 0, out.data(), out.size()), 0);
+  for (mx_float v : out) EXPECT_FLOAT_EQ(v, 5.0f);
+  ASSERT_EQ(MXPredGetOutput(same_exec, 0, out.data(), out.size()), 0);
+  for (mx_float v : out) EXPECT_FLOAT_EQ(v, 1.0f);
+  MXPredFree(same_exec);
+  MXPredFree(small_exec);
+  MXPredFree(pred);
+  unsetenv("MXNET_PREDICTOR_EXEC_CACHE_SIZE");
+}
@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file bulk_segment_cost_test.cc
+ * \brief Unit tests of the operator cost profile used for bulk segmentation
+ */
+#include <gtest/gtest.h>
+#include <nnvm/graph.h>
+#include <nnvm/op.h>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../../src/executor/bulk_segment_cost.h"
+
+namespace {
+
+nnvm::NodePtr Variable(const std::string& name) {
+  nnvm::NodePtr node = nnvm::Node::Create();
+  node->attrs.name = name;
+  return node;
+}
+
+nnvm::NodePtr Unary(const std::string& op, const nnvm::NodePtr& input) {
+  nnvm::NodePtr node = nnvm::Node::Create();
+  node->attrs.op = nnvm::Op::Get(op);
+  node->attrs.name = op + "_" + input->attrs.name;
+  node->inputs.push_back(nnvm::NodeEntry{input, 0, 0});
+  return node;
+}
+
+/*!
+ * \brief x -> sin -> cos -> tanh -> exp and y -> sqrt, numbered
+ *  x 0, sin 1, cos 2, tanh 3, exp 4, y 5, sqrt 6
+ */
+nnvm::Graph TwoBranches() {
+  nnvm::NodePtr chain = Variable("x");
+  for (const char* op : {"sin", "cos", "tanh", "exp"}) chain = Unary(op, chain);
+  nnvm::Graph g;
+  g.outputs = {nnvm::NodeEntry{chain, 0, 0}, nnvm::NodeEntry{Unary("sqrt", Variable("y")), 0, 0}};
+  return g;
+}
+
+}  // namespace
+
+TEST(BulkSegmentCost, ParseProfile) {
+  std::istringstream is(
+      "\n"
+      "Profile Statistics.\n"
+      "\tNote that counter items are counter values and not time units.\n"
+      "operator\n"
+      "=================\n"
+      "Name                          Total Count        Time (ms)    Min Time (ms)"
+      "    Max Time (ms)    Avg Time (ms)\n"
+      "----                          -----------        ---------    -------------"
+      "    -------------    -------------\n"
+      "Convolution                             4           8.0000           1.0000"
+      "           3.0000           2.0000\n"
+      "Convolutionin: [(1,2)] (k=3)            4           0.0000           0.0000"
+      "           0.0000           0.0000\n"
+      "Activation                              2           0.1000           0.0500"
+      "           0.0500           0.0500\n"
+      "\n"
+      "Device Storage\n"
+      "=================\n"
+      "Memory: cpu/0                           2           0.0000           0.0000"
+      "           0.0000           0.0000\n");
+  auto costs = mxnet::exec::ParseOpCostProfile(is);
+  ASSERT_EQ(costs.size(), 2U);
+  // attributes are merged, times are in microseconds
+  EXPECT_DOUBLE_EQ(costs.at("Convolution"), 1000);
+  EXPECT_DOUBLE_EQ(costs.at("Activation"), 50);
+}
+
+TEST(BulkSegmentCost, CutByBudget) {
+  nnvm::Graph g = TwoBranches();
+  const auto& idx = g.indexed_graph();
+  ASSERT_EQ(idx[4].source->op()->name, "exp");
+  ASSERT_EQ(idx[6].source->op()->name, "sqrt");
+  std::unordered_map<std::string, double> profile = {
+    {"sin", 40}, {"cos", 40}, {"tanh", 40}, {"exp", 40}, {"sqrt", 40}};
+  mxnet::exec::BulkSegmentCutter cutter(idx, 15, &profile, 100, 10);
+  EXPECT_FALSE(cutter.CutBefore(1, 1));
+  EXPECT_FALSE(cutter.CutBefore(1, 2));
+  // 120 exceeds the budget
+  EXPECT_TRUE(cutter.CutBefore(1, 3));
+  // a new segment starts from zero
+  EXPECT_FALSE(cutter.CutBefore(4, 4));
+}
+
+TEST(BulkSegmentCost, CutBeforeIndependentBranch) {
+  nnvm::Graph g = TwoBranches();
+  const auto& idx = g.indexed_graph();
+  const double budget = 100;
+  const double fraction = mxnet::exec::BulkSegmentCutter::kParallelFraction;
+  // sqrt does not depend on the segment, which is long enough to run next to it
+  std::unordered_map<std::string, double> long_profile = {{"exp", budget * fraction}};
+  mxnet::exec::BulkSegmentCutter cut(idx, 15, &long_profile, budget, 0);
+  EXPECT_FALSE(cut.CutBefore(4, 4));
+  EXPECT_TRUE(cut.CutBefore(4, 6));
+  // a shorter segment is not worth it
+  std::unordered_map<std::string, double> short_profile = {{"exp", budget * fraction / 2}};
+  mxnet::exec::BulkSegmentCutter kept(idx, 15, &short_profile, budget, 0);
+  EXPECT_FALSE(kept.CutBefore(4, 4));
+  EXPECT_FALSE(kept.CutBefore(4, 6));
+  // a node depending on the segment never starts a branch
+  std::unordered_map<std::string, double> chain_profile = {{"sin", budget * fraction}};
+  mxnet::exec::BulkSegmentCutter chain(idx, 15, &chain_profile, budget, 0);
+  EXPECT_FALSE(chain.CutBefore(1, 1));
+  EXPECT_FALSE(chain.CutBefore(1, 2));
+}
+
+TEST(BulkSegmentCost, DefaultCost) {
+  nnvm::Graph g = TwoBranches();
+  const auto& idx = g.indexed_graph();
+  // operators missing from the profile cost 25, so that 4 of them fill a segment
+  std::unordered_map<std::string, double> profile = {{"Convolution", 1000}};
+  mxnet::exec::BulkSegmentCutter cutter(idx, 15, &profile, 100, 25);
+  for (size_t nid = 1; nid <= 4; ++nid) EXPECT_FALSE(cutter.CutBefore(1, nid)) << nid;
+  EXPECT_TRUE(cutter.CutBefore(1, 6));
+  // without a profile, segments are cut by their number of nodes
+  mxnet::exec::BulkSegmentCutter nodes(idx, 2, nullptr, 100, 25);
+  EXPECT_FALSE(nodes.CutBefore(1, 3));
+  EXPECT_TRUE(nodes.CutBefore(1, 4));
+}
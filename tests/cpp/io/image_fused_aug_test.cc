@@ -0,0 +1,207 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file image_fused_aug_test.cc
+ * \brief Tests and timing of the one pass crop, resize, mirror and normalization of images
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/test_util.h"
+#include "../include/test_perf.h"
+#include "../../src/io/image_fused_aug.h"
+
+using namespace mxnet::io;
+
+namespace {
+
+/*! \brief interleaved BGR image of random pixels */
+struct Image {
+  Image(int rows, int cols, int channels) : rows(rows), cols(cols), channels(channels),
+      pixels(static_cast<size_t>(rows) * cols * channels) {
+    std::mt19937 rnd(rows * cols);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (auto& p : pixels) p = static_cast<uint8_t>(dist(rnd));
+  }
+  uint8_t at(int i, int j, int c) const {
+    return pixels[(static_cast<size_t>(i) * cols + j) * channels + c];
+  }
+  int rows, cols, channels;
+  std::vector<uint8_t> pixels;
+};
+
+ImageNormalization Normalization() {
+  ImageNormalization norm;
+  for (int k = 0; k < 4; ++k) {
+    norm.mean[k] = 100.0f + k;
+    norm.mult[k] = 1.0f / (50.0f + k);
+    norm.bias[k] = 0.5f;
+  }
+  return norm;
+}
+
+/*!
+ * \brief the crop, mirror and normalization done one after another, as by
+ *  the augmenter and the parser
+ */
+std::vector<float> CropReference(const Image& img, int y, int x, int height, int width,
+                                 bool mirror, const ImageNormalization& norm) {
+  std::vector<float> out(static_cast<size_t>(img.channels) * height * width);
+  for (int k = 0; k < img.channels; ++k) {
+    const int c = img.channels == 1 ? 0 : 2 - k;
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        const float v = (img.at(y + i, x + j, c) - norm.mean[k]) * norm.mult[k] + norm.bias[k];
+        const int col = mirror ? width - 1 - j : j;
+        out[(static_cast<size_t>(k) * height + i) * width + col] = v;
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(ImageCropNormalizer, CropWithoutResize) {
+  const Image img(40, 50, 3);
+  const ImageNormalization norm = Normalization();
+  ImageCropNormalizer fused;
+  for (bool mirror : {false, true}) {
+    const ImageCropPlan plan = {0, 0, img.rows, img.cols, img.rows, img.cols, 3, 5, 32, 32};
+    std::vector<float> out(3 * 32 * 32);
+    fused.Run<3>(img.pixels.data(), img.cols * 3, plan, mirror, norm, out.data());
+    const std::vector<float> expected = CropReference(img, 3, 5, 32, 32, mirror, norm);
+    for (size_t i = 0; i < out.size(); ++i) EXPECT_NEAR(out[i], expected[i], 1e-5f);
+  }
+}
+
+TEST(ImageCropNormalizer, RegionOfInterestWithoutResize) {
+  const Image img(30, 20, 1);
+  const ImageNormalization norm = Normalization();
+  // the region of interest and the window offset add up
+  const ImageCropPlan plan = {4, 2, 20, 16, 20, 16, 1, 3, 12, 10};
+  std::vector<uint8_t> out(12 * 10);
+  ImageCropNormalizer fused;
+  fused.Run<1>(img.pixels.data(), img.cols, plan, false, norm, out.data());
+  for (int i = 0; i < 12; ++i) {
+    for (int j = 0; j < 10; ++j) EXPECT_EQ(out[i * 10 + j], img.at(5 + i, 5 + j, 0));
+  }
+}
+
+TEST(ImageCropNormalizer, BilinearResizeOfGradient) {
+  // pixels are their column, so the resize interpolates the columns
+  const int rows = 10, cols = 40;
+  std::vector<uint8_t> pixels(rows * cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) pixels[i * cols + j] = static_cast<uint8_t>(j);
+  }
+  ImageNormalization norm = {};
+  for (int k = 0; k < 4; ++k) norm.mult[k] = 1.0f;
+  // upscaled to 80 columns, of which 60 are cropped at 10
+  const ImageCropPlan plan = {0, 0, rows, cols, rows * 2, cols * 2, 0, 10, rows * 2, 60};
+  std::vector<float> out(rows * 2 * 60);
+  ImageCropNormalizer fused;
+  for (bool mirror : {false, true}) {
+    fused.Run<1>(pixels.data(), cols, plan, mirror, norm, out.data());
+    for (int i = 0; i < rows * 2; ++i) {
+      for (int j = 0; j < 60; ++j) {
+        const int col = mirror ? 59 - j : j;
+        const float expected = std::min(std::max((col + 10 + 0.5f) * 0.5f - 0.5f, 0.0f),
+                                        static_cast<float>(cols - 1));
+        EXPECT_NEAR(out[i * 60 + j], expected, 1e-4f);
+      }
+    }
+  }
+}
+
+TEST(ImageCropNormalizer, MeanImage) {
+  const Image img(16, 16, 3);
+  ImageNormalization norm = Normalization();
+  std::vector<float> mean_img(3 * 8 * 8);
+  for (size_t i = 0; i < mean_img.size(); ++i) mean_img[i] = static_cast<float>(i % 7);
+  norm.mean_img = mean_img.data();
+  const ImageCropPlan plan = {0, 0, 16, 16, 16, 16, 4, 4, 8, 8};
+  std::vector<float> out(3 * 8 * 8);
+  ImageCropNormalizer fused;
+  for (bool mirror : {false, true}) {
+    fused.Run<3>(img.pixels.data(), 16 * 3, plan, mirror, norm, out.data());
+    for (int k = 0; k < 3; ++k) {
+      for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 8; ++j) {
+          // the mean image is subtracted before mirroring
+          const float v = (img.at(4 + i, 4 + j, 2 - k) - mean_img[(k * 8 + i) * 8 + j])
+                          * norm.mult[k] + norm.bias[k];
+          const int col = mirror ? 7 - j : j;
+          EXPECT_NEAR(out[(k * 8 + i) * 8 + col], v, 1e-5f);
+        }
+      }
+    }
+  }
+}
+
+TEST(ImageCropNormalizer, TimingResizeCrop) {
+  // a 500x375 image, resized to a shorter edge of 256 and cropped to 224x224
+  const Image img(375, 500, 3);
+  const int resized_rows = 256, resized_cols = 256 * 500 / 375;
+  const ImageCropPlan plan = {0, 0, img.rows, img.cols, resized_rows, resized_cols,
+                              16, 50, 224, 224};
+  const ImageNormalization norm = Normalization();
+  const int num_images = mxnet::test::performance_run ? 1000 : 20;
+  std::vector<float> out(3 * 224 * 224);
+
+  // the passes one after another, as by the augmenter and the parser: resize
+  // into an intermediate image, then crop, mirror, normalize and transpose it
+  const size_t plane = static_cast<size_t>(resized_rows) * resized_cols;
+  std::vector<uint8_t> resized(plane * 3);
+  ImageNormalization identity = {};
+  const ImageCropPlan resize_plan = {0, 0, img.rows, img.cols, resized_rows, resized_cols,
+                                     0, 0, resized_rows, resized_cols};
+  ImageCropNormalizer resizer;
+  uint64_t start = mxnet::test::perf::getMicroTickCount();
+  for (int n = 0; n < num_images; ++n) {
+    resizer.Run<3>(img.pixels.data(), img.cols * 3, resize_plan, false, identity,
+                   resized.data());
+    for (int k = 0; k < 3; ++k) {
+      for (int i = 0; i < 224; ++i) {
+        const uint8_t* row = &resized[k * plane + (16 + i) * resized_cols + 50];
+        for (int j = 0; j < 224; ++j) {
+          out[(k * 224 + i) * 224 + 223 - j] =
+            (row[j] - norm.mean[k]) * norm.mult[k] + norm.bias[k];
+        }
+      }
+    }
+  }
+  const uint64_t separate_us = mxnet::test::perf::getMicroTickCount() - start;
+
+  ImageCropNormalizer fused;
+  start = mxnet::test::perf::getMicroTickCount();
+  for (int n = 0; n < num_images; ++n) {
+    fused.Run<3>(img.pixels.data(), img.cols * 3, plan, true, norm, out.data());
+  }
+  const uint64_t fused_us = mxnet::test::perf::getMicroTickCount() - start;
+  std::cout << "500x375 to 3x224x224, images/sec per core: separate passes "
+            << num_images * 1e6 / std::max<uint64_t>(separate_us, 1)
+            << ", fused " << num_images * 1e6 / std::max<uint64_t>(fused_us, 1)
+            << std::endl;
+}
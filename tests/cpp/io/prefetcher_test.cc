@@ -0,0 +1,194 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file prefetcher_test.cc
+ * \brief Tests and timing of the batches written by a batch loader into the prefetcher
+ */
+#include <gtest/gtest.h>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/test_util.h"
+#include "../include/test_perf.h"
+#include "../../src/io/iter_batchloader.h"
+#include "../../src/io/iter_prefetcher.h"
+
+using namespace mxnet;
+using namespace mxnet::io;
+
+namespace {
+
+/*!
+ * \brief instances whose data and label are their index
+ */
+class IndexIter : public IIterator<DataInst> {
+ public:
+  IndexIter(unsigned num_inst, size_t dim) : num_inst_(num_inst), data_(dim), label_(1) {
+    inst_.data.emplace_back(data_.data(), mshadow::Shape1(dim), cpu::kDevMask);
+    inst_.data.emplace_back(label_.data(), mshadow::Shape1(1), cpu::kDevMask);
+  }
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {}
+  void BeforeFirst() override {
+    pos_ = 0;
+  }
+  bool Next() override {
+    if (pos_ == num_inst_) return false;
+    inst_.index = pos_;
+    std::fill(data_.begin(), data_.end(), static_cast<float>(pos_));
+    label_[0] = static_cast<float>(pos_);
+    ++pos_;
+    return true;
+  }
+  const DataInst& Value() const override {
+    return inst_;
+  }
+
+ private:
+  unsigned num_inst_;
+  unsigned pos_ = 0;
+  std::vector<float> data_;
+  std::vector<float> label_;
+  DataInst inst_;
+};
+
+/*!
+ * \brief batch loader which records the arrays it wrote its batches into
+ */
+class RecordingLoader : public BatchLoader {
+ public:
+  explicit RecordingLoader(IIterator<DataInst>* base) : BatchLoader(base) {}
+  bool Next() override {
+    if (!BatchLoader::Next()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const TBlob& blob : Value().data) written_.insert(blob.dptr_);
+    return true;
+  }
+  bool Wrote(const void* dptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_.count(dptr) != 0;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::set<const void*> written_;
+};
+
+std::vector<std::pair<std::string, std::string> > Kwargs(int batch_size,
+                                                         const std::string& ctx = "") {
+  std::vector<std::pair<std::string, std::string> > kwargs = {
+    {"batch_size", std::to_string(batch_size)}, {"round_batch", "0"}, {"prefetch_buffer", "2"}};
+  if (!ctx.empty()) kwargs.emplace_back("ctx", ctx);
+  return kwargs;
+}
+
+}  // namespace
+
+TEST(PrefetcherIter, BatchesOverEpochs) {
+  const unsigned num_inst = 50;
+  const int batch_size = 8;
+  const size_t dim = 3;
+  PrefetcherIter iter(new BatchLoader(new IndexIter(num_inst, dim)));
+  iter.Init(Kwargs(batch_size));
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    iter.BeforeFirst();
+    unsigned next = 0;
+    while (iter.Next()) {
+      const DataBatch& batch = iter.Value();
+      const float* data = batch.data[0].data().dptr<float>();
+      const float* label = batch.data[1].data().dptr<float>();
+      const int num = batch_size - batch.num_batch_padd;
+      for (int i = 0; i < num; ++i, ++next) {
+        EXPECT_EQ(batch.index[i], next);
+        EXPECT_EQ(label[i], next);
+        for (size_t j = 0; j < dim; ++j) EXPECT_EQ(data[i * dim + j], next);
+      }
+    }
+    EXPECT_EQ(next, num_inst);
+  }
+}
+
+TEST(PrefetcherIter, LoaderWritesIntoBatch) {
+  const int batch_size = 4;
+  RecordingLoader* loader = new RecordingLoader(new IndexIter(40, 2));
+  PrefetcherIter iter(loader);
+  iter.Init(Kwargs(batch_size));
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    iter.BeforeFirst();
+    unsigned next = 0;
+    while (iter.Next()) {
+      const DataBatch& batch = iter.Value();
+      // only the very first batch, which gives the shapes, is copied from the loader
+      if (epoch != 0 || next != 0) {
+        for (const NDArray& arr : batch.data) EXPECT_TRUE(loader->Wrote(arr.data().dptr_));
+      }
+      const float* label = batch.data[1].data().dptr<float>();
+      for (int i = 0; i < batch_size; ++i, ++next) EXPECT_EQ(label[i], next);
+    }
+    EXPECT_EQ(next, 40U);
+  }
+}
+
+TEST(PrefetcherIter, SharedContext) {
+  PrefetcherIter iter(new BatchLoader(new IndexIter(20, 4)));
+  iter.Init(Kwargs(5, "cpu_shared"));
+  unsigned next = 0;
+  while (iter.Next()) {
+    const DataBatch& batch = iter.Value();
+    EXPECT_EQ(batch.data[0].ctx().dev_type, Context::kCPUShared);
+    const float* label = batch.data[1].data().dptr<float>();
+    for (int i = 0; i < 5; ++i, ++next) EXPECT_EQ(label[i], next);
+  }
+  EXPECT_EQ(next, 20U);
+}
+
+TEST(PrefetcherIter, TimingLargeBatches) {
+  std::vector<int> batch_sizes;
+  if (mxnet::test::performance_run) {
+    batch_sizes = {32, 256, 1024};
+  } else {
+    batch_sizes = {32};
+  }
+  // an image of 3x224x224 per instance
+  const size_t dim = 3 * 224 * 224;
+  for (int batch_size : batch_sizes) {
+    const unsigned num_inst = 8 * batch_size;
+    // the loader alone, which the prefetcher adds no copy to
+    BatchLoader loader(new IndexIter(num_inst, dim));
+    loader.Init(Kwargs(batch_size));
+    uint64_t start = mxnet::test::perf::getMicroTickCount();
+    int num_batches = 0;
+    while (loader.Next()) ++num_batches;
+    const uint64_t loader_us = mxnet::test::perf::getMicroTickCount() - start;
+
+    PrefetcherIter iter(new BatchLoader(new IndexIter(num_inst, dim)));
+    iter.Init(Kwargs(batch_size));
+    start = mxnet::test::perf::getMicroTickCount();
+    while (iter.Next()) iter.Value().data[0].WaitToRead();
+    const uint64_t prefetcher_us = mxnet::test::perf::getMicroTickCount() - start;
+    std::cout << "batch size: " << batch_size
+              << ", loader: " << loader_us / num_batches << " us per batch"
+              << ", prefetcher: " << prefetcher_us / num_batches << " us per batch"
+              << std::endl;
+  }
+}
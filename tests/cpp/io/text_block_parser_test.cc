@@ -0,0 +1,212 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file text_block_parser_test.cc
+ * \brief Tests and timing of the parallel parsing of LibSVM and CSV text
+ */
+#include <gtest/gtest.h>
+#include <dmlc/data.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../include/test_util.h"
+#include "../include/test_perf.h"
+#include "../../src/io/text_block_parser.h"
+
+using namespace mxnet::io;
+
+namespace {
+
+TextRows Parse(TextFormat format, const std::string& text) {
+  TextRows rows;
+  ParseTextRows(format, text.data(), text.data() + text.size(), &rows);
+  return rows;
+}
+
+/*! \brief writes rows of LibSVM text whose labels are their index, returns its size */
+size_t WriteLibSVM(const std::string& path, int num_rows, int num_features) {
+  std::ofstream fo(path);
+  std::mt19937 rnd(num_rows);
+  std::uniform_int_distribution<int> gap(1, 50);
+  std::uniform_real_distribution<float> value(-1, 1);
+  for (int i = 0; i < num_rows; ++i) {
+    fo << i;
+    for (int j = 0, col = 0; j < num_features; ++j) {
+      col += gap(rnd);
+      fo << ' ' << col << ':' << value(rnd);
+    }
+    fo << '\n';
+  }
+  return static_cast<size_t>(fo.tellp());
+}
+
+/*! \brief labels of all the rows taken n at a time */
+std::vector<float> TakeLabels(TextBlockReader* reader, size_t n) {
+  std::vector<float> labels;
+  std::vector<TextBlockReader::Span> spans;
+  while (reader->Take(n, &spans) != 0) {
+    for (const auto& span : spans) {
+      for (size_t r = span.begin; r < span.end; ++r) labels.push_back(span.rows->label[r]);
+    }
+    spans.clear();
+  }
+  return labels;
+}
+
+}  // namespace
+
+TEST(TextBlockParser, LibSVMLines) {
+  const TextRows rows = Parse(kLibSVMText,
+                              "1 0:0.5 2:1.2\r\n"
+                              "-2\n"
+                              "\n"
+                              "# a comment\n"
+                              "3:0.25 qid:7 1 4:-1e-2 # end\n"
+                              "  4\t5:3");
+  ASSERT_EQ(rows.Size(), 4U);
+  EXPECT_EQ(rows.label, std::vector<float>({1, -2, 3, 4}));
+  EXPECT_EQ(rows.offset, std::vector<int64_t>({0, 2, 2, 4, 5}));
+  EXPECT_EQ(rows.index, std::vector<int64_t>({0, 2, 1, 4, 5}));
+  // a feature without a value is 1
+  EXPECT_EQ(rows.value, std::vector<float>({0.5f, 1.2f, 1, -0.01f, 3}));
+}
+
+TEST(TextBlockParser, LibSVMInvalidFeatures) {
+  EXPECT_THROW(Parse(kLibSVMText, "1 -1:0.6"), dmlc::Error);
+  EXPECT_THROW(Parse(kLibSVMText, "1 2.5:0.6"), dmlc::Error);
+  EXPECT_THROW(Parse(kLibSVMText, "1 2:x"), dmlc::Error);
+  EXPECT_THROW(Parse(kLibSVMText, "1 inf:1"), dmlc::Error);
+  EXPECT_THROW(Parse(kLibSVMText, "a 2:1"), dmlc::Error);
+}
+
+TEST(TextBlockParser, CSVLines) {
+  const TextRows rows = Parse(kCSVText, "1,2.5,-3\r\n4, ,6e2\n\n7,8,9");
+  ASSERT_EQ(rows.Size(), 3U);
+  EXPECT_EQ(rows.offset, std::vector<int64_t>({0, 3, 6, 9}));
+  // an empty field is 0
+  EXPECT_EQ(rows.value, std::vector<float>({1, 2.5f, -3, 4, 0, 600, 7, 8, 9}));
+  EXPECT_THROW(Parse(kCSVText, "1,2 3"), dmlc::Error);
+  const TextRows special = Parse(kCSVText, "nan,-inf,Infinity\n");
+  ASSERT_EQ(special.Size(), 1U);
+  EXPECT_TRUE(std::isnan(special.value[0]));
+  EXPECT_EQ(special.value[1], -HUGE_VALF);
+  EXPECT_EQ(special.value[2], HUGE_VALF);
+}
+
+TEST(TextBlockParser, Numbers) {
+  const char* texts[] = {"0", "-0.5", "+12.25", "3e4", "1.5E-3", "123456789012345678901234",
+                         ".5", "7."};
+  for (const char* text : texts) {
+    const char* p = text;
+    const char* end = text + std::strlen(text);
+    double v;
+    ASSERT_TRUE(text::ParseNumber(&p, end, &v)) << text;
+    EXPECT_EQ(p, end) << text;
+    EXPECT_DOUBLE_EQ(v, std::strtod(text, nullptr)) << text;
+  }
+  const char* p = "-.e5";
+  double v;
+  EXPECT_FALSE(text::ParseNumber(&p, p + 4, &v));
+  // the special values of strtod
+  const char* specials[] = {"nan", "-NaN", "inf", "+Inf", "-infinity", "INFINITY"};
+  for (const char* text : specials) {
+    p = text;
+    const char* end = text + std::strlen(text);
+    ASSERT_TRUE(text::ParseNumber(&p, end, &v)) << text;
+    EXPECT_EQ(p, end) << text;
+    const double expected = std::strtod(text, nullptr);
+    if (std::isnan(expected)) {
+      EXPECT_TRUE(std::isnan(v)) << text;
+    } else {
+      EXPECT_EQ(v, expected) << text;
+    }
+  }
+  p = "info";
+  EXPECT_TRUE(text::ParseNumber(&p, p + 4, &v));
+  EXPECT_EQ(*p, 'o');
+  p = "na";
+  EXPECT_FALSE(text::ParseNumber(&p, p + 2, &v));
+}
+
+TEST(TextBlockReader, TakeAcrossPiecesAndEpochs) {
+  const std::string path = "text_block_reader_test.libsvm";
+  const int num_rows = 1000;
+  WriteLibSVM(path, num_rows, 3);
+  for (int nthread : {1, 3, 8}) {
+    // chunks of a few rows, so that batches span chunks
+    TextBlockReader reader(path, 0, 1, kLibSVMText, nthread, 200);
+    for (int epoch = 0; epoch < 2; ++epoch) {
+      reader.BeforeFirst();
+      const std::vector<float> labels = TakeLabels(&reader, 7);
+      ASSERT_EQ(labels.size(), static_cast<size_t>(num_rows));
+      for (int i = 0; i < num_rows; ++i) EXPECT_EQ(labels[i], i);
+    }
+  }
+  // the parts cover all the rows once
+  std::vector<float> labels;
+  for (unsigned part = 0; part < 3; ++part) {
+    TextBlockReader reader(path, part, 3, kLibSVMText, 2);
+    reader.BeforeFirst();
+    const std::vector<float> part_labels = TakeLabels(&reader, 16);
+    labels.insert(labels.end(), part_labels.begin(), part_labels.end());
+  }
+  ASSERT_EQ(labels.size(), static_cast<size_t>(num_rows));
+  for (int i = 0; i < num_rows; ++i) EXPECT_EQ(labels[i], i);
+  std::remove(path.c_str());
+}
+
+TEST(TextBlockReader, TimingLibSVM) {
+  const std::string path = "text_block_reader_timing.libsvm";
+  const int num_rows = mxnet::test::performance_run ? 500000 : 20000;
+  const double mbytes = WriteLibSVM(path, num_rows, 40) / 1e6;
+  // the row by row parser of dmlc, which the iterators used before
+  {
+    std::unique_ptr<dmlc::Parser<uint64_t> > parser(
+        dmlc::Parser<uint64_t>::Create(path.c_str(), 0, 1, "libsvm"));
+    const uint64_t start = mxnet::test::perf::getMicroTickCount();
+    size_t num = 0;
+    while (parser->Next()) num += parser->Value().size;
+    const uint64_t us = mxnet::test::perf::getMicroTickCount() - start;
+    EXPECT_EQ(num, static_cast<size_t>(num_rows));
+    std::cout << "dmlc::Parser: " << mbytes * 1e6 / std::max<uint64_t>(us, 1) << " MB/s"
+              << std::endl;
+  }
+  std::vector<int> nthreads = {1};
+  if (omp_get_num_procs() > 1) nthreads.push_back(std::min(omp_get_num_procs(), 8));
+  for (int nthread : nthreads) {
+    TextBlockReader reader(path, 0, 1, kLibSVMText, nthread);
+    reader.BeforeFirst();
+    const uint64_t start = mxnet::test::perf::getMicroTickCount();
+    const size_t num = TakeLabels(&reader, 256).size();
+    const uint64_t us = mxnet::test::perf::getMicroTickCount() - start;
+    EXPECT_EQ(num, static_cast<size_t>(num_rows));
+    std::cout << "TextBlockReader, " << nthread << " threads: "
+              << mbytes * 1e6 / std::max<uint64_t>(us, 1) << " MB/s" << std::endl;
+  }
+  std::remove(path.c_str());
+}
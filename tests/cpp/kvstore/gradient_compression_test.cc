@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file gradient_compression_test.cc
+ * \brief Tests and timing of the gradient compression kernels
+ */
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "test_util.h"
+#include "test_perf.h"
+#include "../../src/kvstore/gradient_compression-inl.h"
+
+using namespace mxnet;
+using namespace mxnet::kvstore;
+
+namespace {
+
+TBlob Blob(std::vector<float>* data) {
+  return TBlob(data->data(), TShape{static_cast<int64_t>(data->size())}, cpu::kDevMask);
+}
+
+std::vector<float> RandomGradient(size_t size, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist(0, 1);
+  std::vector<float> grad(size);
+  for (auto& g : grad) g = dist(gen);
+  return grad;
+}
+
+}  // namespace
+
+TEST(GradientCompression, TopKCompressedSize) {
+  // a full block of 2 * 64 * 500 elements sends 64 entries
+  EXPECT_EQ(TopKBlockSize(500), 64000);
+  EXPECT_EQ(TopKCompressedSize(64000, 500), 128);
+  EXPECT_EQ(TopKCompressedSize(6, 500), 2);
+  EXPECT_EQ(TopKCompressedSize(64001, 500), 130);
+  EXPECT_EQ(TopKCompressedSize(3 * 64000 + 2500, 500), 3 * 128 + 2 * 3);
+}
+
+TEST(GradientCompression, TopKEffectiveRatio) {
+  // ratios are rounded to 1 / (2 * factor)
+  EXPECT_EQ(TopKCompressionFactor(0.001f), 500);
+  EXPECT_EQ(TopKCompressionFactor(0.5f), 1);
+  EXPECT_EQ(TopKCompressionFactor(0.25f), 2);
+  EXPECT_EQ(TopKCompressionFactor(0.3f), 2);
+  EXPECT_EQ(TopKCompressionFactor(0.4f), 1);
+  EXPECT_FLOAT_EQ(TopKEffectiveRatio(TopKCompressionFactor(0.001f)), 0.001f);
+  EXPECT_FLOAT_EQ(TopKEffectiveRatio(TopKCompressionFactor(0.3f)), 0.25f);
+  EXPECT_FLOAT_EQ(TopKEffectiveRatio(TopKCompressionFactor(0.4f)), 0.5f);
+}
+
+TEST(GradientCompression, TopKLargestEntries) {
+  const int factor = 4;
+  const int64_t block = TopKBlockSize(factor);
+  std::vector<float> grad = RandomGradient(3 * block + 100, 1);
+  std::vector<float> residual(grad.size(), 0);
+  std::vector<float> compr(TopKCompressedSize(grad.size(), factor));
+  std::vector<float> decompr(grad.size(), 1);
+  mshadow::Stream<cpu>* s = nullptr;
+  QuantizeTopKImpl(s, {Blob(&grad), Blob(&residual), Blob(&compr)}, factor);
+  DequantizeTopKImpl(s, {Blob(&compr), Blob(&decompr)}, factor);
+  for (size_t begin = 0; begin < grad.size(); begin += block) {
+    const size_t end = std::min(grad.size(), static_cast<size_t>(begin + block));
+    float min_sent = INFINITY, max_kept = 0;
+    int64_t num_sent = 0;
+    for (size_t i = begin; i < end; ++i) {
+      // every entry is either sent or kept in the residual
+      if (decompr[i] != 0) {
+        EXPECT_EQ(decompr[i], grad[i]);
+        EXPECT_EQ(residual[i], 0);
+        min_sent = std::min(min_sent, std::abs(decompr[i]));
+        ++num_sent;
+      } else {
+        EXPECT_EQ(residual[i], grad[i]);
+        max_kept = std::max(max_kept, std::abs(residual[i]));
+      }
+    }
+    EXPECT_EQ(num_sent, TopKNumEntries(end - begin, factor));
+    EXPECT_GE(min_sent, max_kept);
+  }
+}
+
+TEST(GradientCompression, TopKErrorFeedback) {
+  // the dropped entries are sent later, nothing is lost
+  const int factor = 8;
+  std::vector<float> residual(1000, 0);
+  std::vector<float> compr(TopKCompressedSize(residual.size(), factor));
+  std::vector<float> decompr(residual.size());
+  std::vector<float> total_grad(residual.size(), 0), total_sent(residual.size(), 0);
+  mshadow::Stream<cpu>* s = nullptr;
+  for (unsigned step = 0; step < 20; ++step) {
+    std::vector<float> grad = RandomGradient(residual.size(), step);
+    QuantizeTopKImpl(s, {Blob(&grad), Blob(&residual), Blob(&compr)}, factor);
+    DequantizeTopKImpl(s, {Blob(&compr), Blob(&decompr)}, factor);
+    for (size_t i = 0; i < grad.size(); ++i) {
+      total_grad[i] += grad[i];
+      total_sent[i] += decompr[i];
+    }
+  }
+  for (size_t i = 0; i < residual.size(); ++i) {
+    EXPECT_NEAR(total_sent[i] + residual[i], total_grad[i], 1e-3);
+  }
+}
+
+/*!
+ * \brief compression ratio and throughput of 2bit and topk compression
+ */
+TEST(GradientCompression, TimingCPU) {
+  std::vector<size_t> sizes;
+  if (mxnet::test::performance_run) {
+    sizes = {1 << 16, 1 << 20, 1 << 24};
+  } else {
+    sizes = {1 << 16};
+  }
+  const std::vector<float> ratios = {0.01f, 0.001f};
+  mshadow::Stream<cpu>* s = nullptr;
+  for (size_t size : sizes) {
+    std::vector<float> grad = RandomGradient(size, 0);
+    std::vector<float> residual(size, 0), decompr(size);
+    const int repeat = 5;
+    auto report = [&](const std::string& name, size_t compr_size, uint64_t quantize_us,
+                      uint64_t dequantize_us) {
+      const double mbytes = static_cast<double>(size) * sizeof(float) * repeat / (1 << 20);
+      std::cout << name << " size: " << size
+                << ", compression ratio: " << static_cast<double>(size) / compr_size
+                << ", quantize: " << mbytes / (quantize_us * 1e-6) << " MB/s"
+                << ", dequantize: " << mbytes / (dequantize_us * 1e-6) << " MB/s"
+                << std::endl;
+    };
+
+    std::vector<float> compr((size + 15) / 16);
+    uint64_t start = mxnet::test::perf::getMicroTickCount();
+    for (int i = 0; i < repeat; ++i) {
+      Quantize2BitImpl(s, {Blob(&grad), Blob(&residual), Blob(&compr)}, 0.5);
+    }
+    const uint64_t quantize = mxnet::test::perf::getMicroTickCount() - start + 1;
+    start = mxnet::test::perf::getMicroTickCount();
+    for (int i = 0; i < repeat; ++i) {
+      Dequantize2BitImpl(s, {Blob(&compr), Blob(&decompr)}, 0.5);
+    }
+    report("2bit", compr.size(), quantize, mxnet::test::perf::getMicroTickCount() - start + 1);
+
+    for (float ratio : ratios) {
+      const int factor = std::max(1, static_cast<int>(std::round(0.5 / ratio)));
+      compr.resize(TopKCompressedSize(size, factor));
+      std::fill(residual.begin(), residual.end(), 0);
+      start = mxnet::test::perf::getMicroTickCount();
+      for (int i = 0; i < repeat; ++i) {
+        QuantizeTopKImpl(s, {Blob(&grad), Blob(&residual), Blob(&compr)}, factor);
+      }
+      const uint64_t quantize = mxnet::test::perf::getMicroTickCount() - start + 1;
+      start = mxnet::test::perf::getMicroTickCount();
+      for (int i = 0; i < repeat; ++i) {
+        DequantizeTopKImpl(s, {Blob(&compr), Blob(&decompr)}, factor);
+      }
+      report("topk " + std::to_string(ratio), compr.size(), quantize,
+             mxnet::test::perf::getMicroTickCount() - start + 1);
+    }
+  }
+}
@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file row_sparse_hash_store_test.cc
+ * \brief Tests of the hash tables holding row_sparse values on kvstore servers
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "../../src/kvstore/row_sparse_hash_store.h"
+
+using namespace mxnet::kvstore;
+
+TEST(RowSparseHashStore, LazyRows) {
+  RowSparseHashStore store(4, RowInitializer::Parse("zeros"), 0, 0);
+  EXPECT_EQ(store.size(), 0U);
+  float* row = store.Row(int64_t(1) << 40);
+  EXPECT_EQ(store.size(), 1U);
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(row[i], 0.f);
+  row[2] = 3.f;
+  EXPECT_EQ(store.Row(int64_t(1) << 40)[2], 3.f);
+  EXPECT_EQ(store.size(), 1U);
+}
+
+TEST(RowSparseHashStore, Initializer) {
+  const size_t len = 1000;
+  RowSparseHashStore a(len, RowInitializer::Parse("uniform:0.5"), 7, 0);
+  RowSparseHashStore b(len, RowInitializer::Parse("uniform:0.5"), 7, 0);
+  const float* ra = a.Row(42);
+  const float* rb = b.Row(42);
+  const float* other = a.Row(43);
+  size_t same = 0;
+  for (size_t i = 0; i < len; ++i) {
+    EXPECT_EQ(ra[i], rb[i]);
+    EXPECT_GE(ra[i], -0.5f);
+    EXPECT_LT(ra[i], 0.5f);
+    same += ra[i] == other[i];
+  }
+  EXPECT_LT(same, 10U);
+
+  RowSparseHashStore normal(len, RowInitializer::Parse("normal:2"), 7, 0);
+  const float* rn = normal.Row(0);
+  double sum = 0, sq = 0;
+  for (size_t i = 0; i < len; ++i) {
+    sum += rn[i];
+    sq += rn[i] * rn[i];
+  }
+  EXPECT_NEAR(sum / len, 0, 0.3);
+  EXPECT_NEAR(std::sqrt(sq / len), 2, 0.3);
+}
+
+TEST(RowSparseHashStore, EvictCold) {
+  RowSparseHashStore store(2, RowInitializer::Parse("zeros"), 0, 3);
+  for (int64_t id = 0; id < 5; ++id) {
+    store.Tick();
+    store.Row(id)[0] = id + 1;
+  }
+  // row 0 is used again, so rows 1 and 2 are the coldest
+  store.Tick();
+  store.Row(0);
+  store.EvictCold();
+  EXPECT_EQ(store.size(), 3U);
+  EXPECT_EQ(store.Row(0)[0], 1.f);
+  EXPECT_EQ(store.Row(3)[0], 4.f);
+  EXPECT_EQ(store.Row(4)[0], 5.f);
+  // evicted rows come back initialized
+  EXPECT_EQ(store.Row(1)[0], 0.f);
+}
+
+TEST(RowSparseHashStore, Dump) {
+  RowSparseHashStore store(2, RowInitializer::Parse("zeros"), 0, 0);
+  std::vector<int64_t> ids;
+  std::vector<float> values;
+  store.Dump(&ids, &values);
+  EXPECT_TRUE(ids.empty());
+  for (int64_t id : {int64_t(1) << 40, int64_t(3), int64_t(200)}) {
+    store.Row(id)[1] = static_cast<float>(id % 1000);
+  }
+  store.Dump(&ids, &values);
+  EXPECT_EQ(ids, std::vector<int64_t>({3, 200, int64_t(1) << 40}));
+  EXPECT_EQ(values, std::vector<float>({0, 3, 0, 200, 0, (int64_t(1) << 40) % 1000}));
+}
+
+TEST(RowSparseHashStore, ConcurrentRows) {
+  RowSparseHashStore store(8, RowInitializer::Parse("zeros"), 0, 0);
+  const int num_threads = 4, num_rows = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&store, t]() {
+      // each thread writes its own column of the same rows
+      for (int64_t id = 0; id < num_rows; ++id) store.Row(id * 7919)[t] = 1.f;
+    });
+  }
+  for (auto& t : threads) t.join();
+  EXPECT_EQ(store.size(), static_cast<size_t>(num_rows));
+  for (int64_t id = 0; id < num_rows; ++id) {
+    const float* row = store.Row(id * 7919);
+    for (int t = 0; t < num_threads; ++t) EXPECT_EQ(row[t], 1.f);
+  }
+}
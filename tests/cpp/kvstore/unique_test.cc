@@ -0,0 +1,147 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file unique_test.cc
+ * \brief Tests and timing of the unique row ids pulled from kvstore
+ */
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "test_util.h"
+#include "test_perf.h"
+#include "../../src/kvstore/unique.h"
+
+using namespace mxnet::kvstore;
+
+namespace {
+
+/*!
+ * \brief n row ids drawn from num_rows rows by Zipf's law with exponent s,
+ *  the way words or users are looked up in embeddings
+ */
+std::vector<int64_t> ZipfIds(size_t n, size_t num_rows, double s, unsigned seed) {
+  std::vector<double> cdf(num_rows);
+  double sum = 0;
+  for (size_t k = 0; k < num_rows; ++k) {
+    sum += 1.0 / std::pow(static_cast<double>(k + 1), s);
+    cdf[k] = sum;
+  }
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> dist(0, sum);
+  std::vector<int64_t> ids(n);
+  for (size_t i = 0; i < n; ++i) {
+    const size_t rank = std::lower_bound(cdf.begin(), cdf.end(), dist(gen)) - cdf.begin();
+    // the hot rows are spread over the ids
+    ids[i] = static_cast<int64_t>((std::min(rank, num_rows - 1) * 2654435761ULL) % num_rows);
+  }
+  return ids;
+}
+
+std::vector<int64_t> Expected(std::vector<int64_t> ids) {
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+int NumThreads() {
+  return std::max(2u, std::thread::hardware_concurrency());
+}
+
+}  // namespace
+
+TEST(Unique, HashUniqueSorted) {
+  for (size_t num_rows : {size_t(10), size_t(1000), size_t(100000)}) {
+    std::vector<int64_t> ids = ZipfIds(200000, num_rows, 1.0, 0);
+    const std::vector<int64_t> expected = Expected(ids);
+    const size_t n = HashUnique(ids.data(), ids.size(), true, NumThreads());
+    ASSERT_EQ(n, expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), ids.begin()));
+  }
+}
+
+TEST(Unique, HashUniqueUnsorted) {
+  std::vector<int64_t> ids = ZipfIds(100000, 5000, 1.1, 1);
+  const std::vector<int64_t> expected = Expected(ids);
+  const size_t n = HashUnique(ids.data(), ids.size(), false, NumThreads());
+  ASSERT_EQ(n, expected.size());
+  ids.resize(n);
+  EXPECT_EQ(Expected(ids), expected);
+}
+
+TEST(Unique, HashUniqueDistinct) {
+  // hardly any duplicates, which are sorted instead
+  std::vector<int64_t> ids(100000);
+  for (size_t i = 0; i < ids.size(); ++i) ids[i] = (i * 7919) % 99991;
+  const std::vector<int64_t> expected = Expected(ids);
+  const size_t n = HashUnique(ids.data(), ids.size(), true, NumThreads());
+  ASSERT_EQ(n, expected.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), ids.begin()));
+}
+
+TEST(Unique, HashUniqueSmall) {
+  std::vector<int64_t> empty;
+  EXPECT_EQ(HashUnique(empty.data(), 0, true, NumThreads()), 0U);
+  std::vector<int64_t> ids = {5, -1, 5, 3, -1, int64_t(1) << 50};
+  EXPECT_EQ(HashUnique(ids.data(), ids.size(), true, NumThreads()), 4U);
+  EXPECT_EQ(ids[0], -1);
+  EXPECT_EQ(ids[1], 3);
+  EXPECT_EQ(ids[2], 5);
+  EXPECT_EQ(ids[3], int64_t(1) << 50);
+}
+
+TEST(Unique, TimingZipf) {
+  std::vector<size_t> sizes;
+  if (mxnet::test::performance_run) {
+    sizes = {1 << 16, 1 << 20, 1 << 24};
+  } else {
+    sizes = {1 << 16};
+  }
+  const size_t num_rows = 1 << 20;
+  const int repeat = 5;
+  for (size_t size : sizes) {
+    for (double s : {0.8, 1.1}) {
+      const std::vector<int64_t> ids = ZipfIds(size, num_rows, s, 2);
+      std::vector<int64_t> buf;
+      size_t num_sort = 0, num_hash = 0;
+      uint64_t sort_us = 0, hash_us = 0;
+      for (int i = 0; i < repeat; ++i) {
+        buf = ids;
+        uint64_t start = mxnet::test::perf::getMicroTickCount();
+        num_sort = SortUnique(buf.data(), buf.size(), NumThreads());
+        sort_us += mxnet::test::perf::getMicroTickCount() - start;
+        buf = ids;
+        start = mxnet::test::perf::getMicroTickCount();
+        num_hash = HashUnique(buf.data(), buf.size(), true, NumThreads());
+        hash_us += mxnet::test::perf::getMicroTickCount() - start;
+      }
+      EXPECT_EQ(num_sort, num_hash);
+      std::cout << "size: " << size << ", zipf exponent: " << s
+                << ", unique: " << num_hash
+                << ", sort: " << sort_us / repeat << " us"
+                << ", hash: " << hash_us / repeat << " us" << std::endl;
+    }
+  }
+}
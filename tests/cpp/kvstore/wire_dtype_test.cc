@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file wire_dtype_test.cc
+ * \brief Tests of the casts to the 16 bit types sent by dist kvstore
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "../../src/kvstore/wire_dtype.h"
+
+using namespace mxnet::kvstore;
+
+namespace {
+
+std::vector<float> RoundTrip(const std::vector<float>& in, bool bfloat16) {
+  std::vector<uint16_t> wire(in.size());
+  std::vector<float> out(in.size());
+  CastToWire(in.data(), reinterpret_cast<char*>(wire.data()), in.size(), bfloat16);
+  CastFromWire(reinterpret_cast<const char*>(wire.data()), out.data(), in.size(), bfloat16);
+  return out;
+}
+
+}  // namespace
+
+TEST(WireDType, Float16) {
+  // long enough for the vectorized loop and its remainder
+  std::vector<float> in;
+  for (int i = -9; i < 10; ++i) in.push_back(i * 0.75f);
+  in.push_back(65504.f);
+  in.push_back(1.f / 3);
+  std::vector<float> out = RoundTrip(in, false);
+  for (size_t i = 0; i < in.size(); ++i) {
+    EXPECT_EQ(out[i], static_cast<float>(mshadow::half::half_t(in[i])));
+  }
+  EXPECT_EQ(out[0], -6.75f);
+  EXPECT_EQ(out[in.size() - 2], 65504.f);
+  EXPECT_NEAR(out.back(), 1.f / 3, 1e-3);
+}
+
+TEST(WireDType, BFloat16) {
+  const float inf = std::numeric_limits<float>::infinity();
+  std::vector<float> in = {0.f, -2.5f, 393.f, 1.f + 1.f / 256, 1.f + 3.f / 256, 1e-30f,
+                           inf, -inf, std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::quiet_NaN()};
+  std::vector<float> out = RoundTrip(in, true);
+  EXPECT_EQ(out[0], 0.f);
+  EXPECT_EQ(out[1], -2.5f);
+  // 8 bits of mantissa, ties round to even
+  EXPECT_EQ(out[2], 392.f);
+  EXPECT_EQ(out[3], 1.f);
+  EXPECT_EQ(out[4], 1.f + 4.f / 256);
+  EXPECT_NEAR(out[5], 1e-30f, 1e-32f);
+  EXPECT_EQ(out[6], inf);
+  EXPECT_EQ(out[7], -inf);
+  EXPECT_EQ(out[8], inf);
+  EXPECT_TRUE(std::isnan(out[9]));
+}
@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file numa_test.cc
+ * \brief tests of the NUMA topology of the host
+*/
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../../src/common/numa.h"
+
+#if !defined(_WIN32)
+namespace {
+/*!
+ * \brief Directory laid out like /sys/devices/system/node, removed with the object.
+ */
+class FakeNodeDir {
+ public:
+  FakeNodeDir() {
+    char tmpl[] = "/tmp/mxnet_numa_test_XXXXXX";
+    dir_ = mkdtemp(tmpl);
+  }
+  ~FakeNodeDir() {
+    for (const auto& file : files_) std::remove(file.c_str());
+    for (auto it = dirs_.rbegin(); it != dirs_.rend(); ++it) rmdir(it->c_str());
+    rmdir(dir_.c_str());
+  }
+  void Write(const std::string& name, const std::string& content) {
+    const std::string path = dir_ + "/" + name;
+    std::ofstream(path) << content << "\n";
+    files_.push_back(path);
+  }
+  void AddNode(int id, const std::string& cpulist) {
+    const std::string node = dir_ + "/node" + std::to_string(id);
+    mkdir(node.c_str(), 0755);
+    dirs_.push_back(node);
+    Write("node" + std::to_string(id) + "/cpulist", cpulist);
+  }
+  const std::string& dir() const {
+    return dir_;
+  }
+
+ private:
+  std::string dir_;
+  std::vector<std::string> dirs_;
+  std::vector<std::string> files_;
+};
+}  // namespace
+#endif  // !defined(_WIN32)
+
+TEST(NUMA, ParseCPUList) {
+  using mxnet::common::ParseCPUList;
+  EXPECT_EQ(ParseCPUList("0-3,8,10-11"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCPUList("5"), std::vector<int>({5}));
+  EXPECT_TRUE(ParseCPUList("").empty());
+}
+
+#if !defined(_WIN32)
+TEST(NUMA, ReadNodesWithGaps) {
+  FakeNodeDir sysfs;
+  // node 1 was unplugged, node 3 has memory only
+  sysfs.Write("online", "0,2-3");
+  sysfs.AddNode(0, "0-1");
+  sysfs.AddNode(2, "2-3,6");
+  sysfs.AddNode(3, "");
+  const auto nodes = mxnet::common::ReadNumaNodes(sysfs.dir());
+  ASSERT_EQ(nodes.size(), 2U);
+  EXPECT_EQ(nodes[0].id, 0);
+  EXPECT_EQ(nodes[0].cpus, std::vector<int>({0, 1}));
+  // the id used by mbind is kept next to the CPUs
+  EXPECT_EQ(nodes[1].id, 2);
+  EXPECT_EQ(nodes[1].cpus, std::vector<int>({2, 3, 6}));
+}
+
+TEST(NUMA, ReadNodesWithoutSysfs) {
+  FakeNodeDir sysfs;
+  EXPECT_TRUE(mxnet::common::ReadNumaNodes(sysfs.dir()).empty());
+}
+#endif  // !defined(_WIN32)
+
+TEST(NUMA, ContextsRoundRobin) {
+  const auto& nodes = mxnet::common::NumaNodes();
+  ASSERT_FALSE(nodes.empty());
+  const int num_nodes = static_cast<int>(nodes.size());
+  for (int dev_id = 0; dev_id < 2 * num_nodes; ++dev_id) {
+    const int node = mxnet::common::NumaNodeOfContext(mxnet::Context::CPU(dev_id));
+    EXPECT_EQ(node, dev_id % num_nodes);
+    EXPECT_FALSE(nodes[node].cpus.empty());
+  }
+}
@@ -26,7 +26,10 @@
 #include <dmlc/logging.h>
 #include <mxnet/storage.h>
 #include <cstdio>
+#include <cstdlib>
+#include <vector>
 #include "test_util.h"
+#include "../../src/storage/pooled_storage_manager.h"
 
 TEST(Storage, Basic_CPU) {
   constexpr size_t kSize = 1024;
@@ -42,6 +45,118 @@ TEST(Storage, Basic_CPU) {
   storage->Free(handle);
 }
 
+TEST(Storage, Pooled_CPU) {
+  mxnet::storage::CPUPooledStorageManager manager(mxnet::Context::kCPU,
+                                                  "MXNET_CPU_MEM_POOL", true, 20, 4096);
+  mxnet::Storage::Handle handle;
+  handle.ctx = mxnet::Context::CPU();
+  handle.size = 1000;
+  manager.Alloc(&handle);
+  auto ptr = handle.dptr;
+  manager.Free(handle);
+  // 1000 and 1024 bytes fall into the same size class
+  handle.size = 1024;
+  manager.Alloc(&handle);
+  EXPECT_EQ(handle.dptr, ptr);
+  manager.Free(handle);
+  manager.ReleaseAll();
+  EXPECT_EQ(manager.used_memory(), 0U);
+  // requests above the cutoff take whole pages only
+  handle.size = (1 << 20) + 1;
+  manager.Alloc(&handle);
+  EXPECT_EQ(manager.used_memory(), (1U << 20) + 4096);
+  manager.Free(handle);
+  manager.ReleaseAll();
+}
+
+namespace {
+/*!
+ * \brief Host memory standing in for a device, counting the bytes it hands out.
+ */
+struct MockDeviceStorage {
+  static size_t allocated;
+  static void* Alloc(size_t size) {
+    allocated += size;
+    return std::malloc(size);
+  }
+  static void Free(void* ptr) {
+    std::free(ptr);
+  }
+  static bool MemoryInfo(size_t* free, size_t* total) {
+    return false;
+  }
+};
+size_t MockDeviceStorage::allocated = 0;
+
+/*!
+ * \brief Device that reports 1% of its memory as free.
+ */
+struct LowMemoryDeviceStorage : public MockDeviceStorage {
+  static bool MemoryInfo(size_t* free, size_t* total) {
+    *total = static_cast<size_t>(100) << 30;
+    *free = static_cast<size_t>(1) << 30;
+    return true;
+  }
+};
+
+/*!
+ * \brief Whether a cached block is reused after a larger request missed the pool.
+ */
+bool ReusedAfterMiss(int reserve) {
+  mxnet::storage::PooledStorageManager<LowMemoryDeviceStorage> manager(
+      mxnet::Context::kCPU, "MXNET_MOCK_MEM_POOL", true, 20, 4096, 0, reserve);
+  MockDeviceStorage::allocated = 0;
+  mxnet::Storage::Handle small, large;
+  small.size = 1024;
+  large.size = 1 << 16;
+  manager.Alloc(&small);
+  manager.Free(small);
+  manager.Alloc(&large);
+  manager.Alloc(&small);
+  const bool reused = MockDeviceStorage::allocated == small.size + large.size;
+  manager.Free(small);
+  manager.Free(large);
+  manager.ReleaseAll();
+  return reused;
+}
+
+/*!
+ * \brief Bytes requested from the device for batches of varying sequence length.
+ */
+size_t PooledDeviceMemory(bool round) {
+  MockDeviceStorage::allocated = 0;
+  mxnet::storage::PooledStorageManager<MockDeviceStorage> manager(mxnet::Context::kCPU,
+                                                                  "MXNET_MOCK_MEM_POOL", round,
+                                                                  24, 1 << 24);
+  std::vector<mxnet::Storage::Handle> handles(4);
+  for (size_t seq_len = 100; seq_len < 200; ++seq_len) {
+    for (size_t i = 0; i < handles.size(); ++i) {
+      handles[i].size = seq_len * (i + 1) * 1024;
+      manager.Alloc(&handles[i]);
+    }
+    for (auto& handle : handles) {
+      manager.Free(handle);
+    }
+  }
+  EXPECT_EQ(manager.used_memory(), MockDeviceStorage::allocated);
+  manager.ReleaseAll();
+  EXPECT_EQ(manager.used_memory(), 0U);
+  return MockDeviceStorage::allocated;
+}
+}  // namespace
+
+TEST(Storage, Pooled_Round_Fragmentation) {
+  const size_t exact = PooledDeviceMemory(false);
+  const size_t round = PooledDeviceMemory(true);
+  EXPECT_LT(round, exact);
+}
+
+TEST(Storage, Pooled_Low_Free_Memory) {
+  // the CPU pool keeps no reserve unless asked for
+  EXPECT_TRUE(ReusedAfterMiss(0));
+  EXPECT_FALSE(ReusedAfterMiss(5));
+}
+
 #if MXNET_USE_CUDA
 TEST(Storage, Basic_GPU) {
   if (mxnet::test::unitTestsWithCuda) {
@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# pylint: skip-file
+import sys
+sys.path.insert(0, "../../python/")
+import argparse
+import os
+import time
+import mxnet as mx
+import numpy as np
+
+shape = (2, 3)
+big_shape = (1200, 1200)        # bigger than MXNET_KVSTORE_BIGARRAY_BOUND
+keys_shapes = [('3', shape), ('99', big_shape)]
+rate = 2
+
+kv = mx.kv.create('dist_async')
+my_rank = kv.rank
+nworker = kv.num_workers
+
+def test_bounded_staleness(staleness, nrepeat):
+    """ worker 0 is slow. The others may run ahead of it by staleness pushes,
+        so each pull sees at least the pushes of all workers up to then
+    """
+    kv.set_optimizer(mx.optimizer.create('test', rescale_grad=rate))
+    for k, s in keys_shapes:
+        kv.init(k, mx.nd.ones(s))
+    for i in range(nrepeat):
+        if my_rank == 0:
+            time.sleep(0.2)
+        for k, s in keys_shapes:
+            kv.push(k, mx.nd.ones(s))
+        for k, s in keys_shapes:
+            val = mx.nd.zeros(s)
+            kv.pull(k, out=val)
+            val = val.asnumpy()
+            # all workers pushed at least i + 1 - staleness times
+            lower = 1 + rate * nworker * max(0, i + 1 - staleness)
+            upper = 1 + rate * nworker * nrepeat
+            # parts of big keys on different servers may have seen different pushes
+            assert np.all(val >= lower) and np.all(val <= upper), (my_rank, i, lower, val.min())
+    print('worker ' + str(my_rank) + ' is done with bounded staleness tests')
+
+def test_async_push_pull(nrepeat):
+    """ the pushes of each worker are applied in order, and all of them are
+        applied once every worker is done
+    """
+    kv.set_optimizer(mx.optimizer.create('test', rescale_grad=rate))
+    # many keys, so that they are updated by all the threads of the servers
+    many_keys_shapes = keys_shapes + [(str(100 + i), shape) for i in range(16)]
+    for k, s in many_keys_shapes:
+        kv.init(k, mx.nd.ones(s))
+    for i in range(nrepeat):
+        for k, s in many_keys_shapes:
+            kv.push(k, mx.nd.ones(s))
+        for k, s in many_keys_shapes:
+            val = mx.nd.zeros(s)
+            kv.pull(k, out=val)
+            # the pull of a key is handled after the pushes of the same worker
+            assert np.all(val.asnumpy() >= 1 + rate * (i + 1)), (my_rank, i, k)
+    mx.nd.waitall()
+    kv._barrier()
+    for k, s in many_keys_shapes:
+        val = mx.nd.zeros(s)
+        kv.pull(k, out=val)
+        expected = 1 + rate * nworker * nrepeat
+        assert np.all(val.asnumpy() == expected), (my_rank, k, val.asnumpy().min())
+    print('worker ' + str(my_rank) + ' is done with async push pull tests')
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='test distributed kvstore in dist_async mode')
+    parser.add_argument('--nrepeat', type=int, default=7)
+    opt = parser.parse_args()
+    staleness = int(os.environ.get('MXNET_KVSTORE_STALENESS', -1))
+    if staleness >= 0:
+        test_bounded_staleness(staleness, opt.nrepeat)
+    else:
+        test_async_push_pull(opt.nrepeat)
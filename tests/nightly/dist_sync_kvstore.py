@@ -20,6 +20,7 @@
 # pylint: skip-file
 import sys
 sys.path.insert(0, "../../python/")
+import os
 import argparse
 import mxnet as mx
 import numpy as np
@@ -56,9 +57,18 @@ init_test_keys_big = [str(i) for i in range(300, 400)]
 init_test_keys_device = [str(i) for i in range(400, 500)]
 init_test_keys_device_big = [str(i) for i in range(500, 600)]
 
+# small keys sent in fused messages when MXNET_KVSTORE_FUSION_THRESHOLD is set
+fused_keys = [str(i) for i in range(2000, 2064)]
+fused_fp16_keys = [str(i) for i in range(2100, 2132)]
+
 compr_keys_shapes = [('1000', shape), ('1200', irregular_shape),('1300', big_shape)]
 compr_init_keys_shapes = [('1001', shape), ('1201', irregular_shape),('1301', big_shape)]
 compr_random_keys_shapes = [('1002', shape),('1202', irregular_shape),('1302', big_shape)]
+topk_keys_shapes = [('1400', shape), ('1401', irregular_shape), ('1402', big_shape)]
+sparse_store_key = '3000'
+snapshot_keys_shapes = [('3100', shape), ('3101', big_shape)]
+snapshot_rsp_key = '3102'
+snapshot_prefix = '/tmp/dist_sync_kvstore_snapshot'
 
 rate = 2
 
@@ -327,6 +337,123 @@ def test_sync_2bit_compression(threshold, nrepeat):
     check_compr_random(threshold, nrepeat)
     print('worker ' + str(my_rank) + ' is done with compression tests')
 
+def test_sync_fused_push_pull(nrepeat):
+    def check_fused_keys(keys, dtype, nrepeat):
+        kv.init(keys, [mx.nd.ones(shape, dtype=dtype)] * len(keys))
+        for i in range(nrepeat):
+            # push and pull all keys in one call, so that they share messages
+            kv.push(keys, [mx.nd.ones(shape, dtype=dtype) * (my_rank + 1)] * len(keys))
+            num = (nworker + 1) * nworker * rate / 2 * (i + 1) + 1
+            vals = [mx.nd.zeros(shape, dtype=dtype) for _ in keys]
+            kv.pull(keys, out=vals)
+            for val in vals:
+                check_diff(val, num, my_rank)
+        # a key on its own still works
+        for k in keys:
+            val = mx.nd.zeros(shape, dtype=dtype)
+            kv.pull(k, out=val)
+            check_diff(val, (nworker + 1) * nworker * rate / 2 * nrepeat + 1, my_rank)
+
+    check_fused_keys(fused_keys, 'float32', nrepeat)
+    check_fused_keys(fused_fp16_keys, 'float16', nrepeat)
+    print('worker ' + str(my_rank) + ' is done with fused push pull tests')
+
+def compute_expected_topk_compression(arr, curr_residual, ratio):
+    # simulates the blocks of top-k compression, see gradient_compression-inl.h
+    factor = max(1, int(0.5 / ratio + 0.5))
+    block = 128 * factor
+    residual = (curr_residual + arr).astype(np.float32).flatten()
+    decompr = np.zeros(residual.shape, dtype=np.float32)
+    for begin in range(0, residual.size, block):
+        part = residual[begin:begin + block]
+        k = min(64, (part.size + 2 * factor - 1) // (2 * factor))
+        top = np.argsort(-np.abs(part))[:k]
+        decompr[begin + top] = part[top]
+        part[top] = 0
+    return residual.reshape(arr.shape), decompr.reshape(arr.shape)
+
+def test_sync_topk_compression(ratio, nrepeat):
+    kv.set_gradient_compression({'type': 'topk', 'ratio': ratio})
+    # same data on all workers, so that the expected values are known
+    rnd.seed(123)
+    for k, s in topk_keys_shapes:
+        kv.init(k, mx.nd.zeros(s))
+    for k, s in topk_keys_shapes:
+        curr_residual = np.zeros(s, dtype=np.float32)
+        for l in range(nrepeat):
+            orig_val = mx.nd.zeros(s)
+            kv.pull(k, orig_val)
+            grad = rnd.rand(s[0], s[1]).astype(np.float32)
+            kv.push(k, mx.nd.array(grad))
+            val = mx.nd.zeros(s)
+            kv.pull(k, val)
+            curr_residual, decompr = compute_expected_topk_compression(grad, curr_residual, ratio)
+            assert_almost_equal((val - orig_val).asnumpy(), decompr * nworker * rate)
+    print('worker ' + str(my_rank) + ' is done with topk compression tests')
+
+def test_sync_sparse_store(nrepeat):
+    # requires MXNET_KVSTORE_SERVER_SPARSE_STORE, the value is too big for dense arrays
+    num_rows = 10 ** 8
+    s = (num_rows, 4)
+    last = num_rows - 1
+    # optimizers with states are rejected
+    for optimizer in ['adam', 'test']:
+        try:
+            kv.set_optimizer(mx.optimizer.create(optimizer))
+            assert False, optimizer + ' keeps states'
+        except ValueError:
+            pass
+    # a stateless optimizer adding rate * grad, like the test optimizer
+    kv.set_optimizer(mx.optimizer.create('sgd', learning_rate=1, rescale_grad=-rate))
+    kv.init(sparse_store_key, mx.nd.sparse.zeros('row_sparse', s))
+    # rows are created when first pulled
+    val = mx.nd.sparse.zeros('row_sparse', s)
+    row_ids = mx.nd.array([0, 12345, last], dtype='int64')
+    kv.row_sparse_pull(sparse_store_key, out=val, row_ids=row_ids)
+    check_diff(val.data, 0, my_rank)
+    for i in range(nrepeat):
+        # each worker pushes its own row and the last row
+        grad = mx.nd.sparse.row_sparse_array((np.ones((2, 4)), [my_rank, last]), shape=s)
+        kv.push(sparse_store_key, grad)
+        row_ids = mx.nd.array(list(range(nworker)) + [last], dtype='int64')
+        kv.row_sparse_pull(sparse_store_key, out=val, row_ids=row_ids)
+        expected = np.full((nworker + 1, 4), rate * (i + 1), dtype=np.float32)
+        expected[-1] *= nworker
+        assert_almost_equal(val.data.asnumpy(), expected)
+    print('worker ' + str(my_rank) + ' is done with sparse store tests')
+
+def test_sync_snapshot(restore, nrepeat):
+    # the first job saves the values after nrepeat pushes, the second one restores them
+    if os.environ.get('MXNET_KVSTORE_SERVER_SPARSE_STORE', '0') != '0':
+        # the rows of the sparse store are saved too, which needs a stateless optimizer
+        kv.set_optimizer(mx.optimizer.create('sgd', learning_rate=1, rescale_grad=-rate))
+    else:
+        kv.set_optimizer(mx.optimizer.create('test', rescale_grad=rate))
+    for k, s in snapshot_keys_shapes:
+        kv.init(k, mx.nd.zeros(s) if restore else mx.nd.ones(s))
+    rsp_init = mx.nd.zeros(big_shape) if restore else mx.nd.ones(big_shape)
+    kv.init(snapshot_rsp_key, rsp_init.tostype('row_sparse'))
+    if not restore:
+        for i in range(nrepeat):
+            for k, s in snapshot_keys_shapes:
+                kv.push(k, mx.nd.ones(s))
+            kv.push(snapshot_rsp_key, mx.nd.ones(big_shape).tostype('row_sparse'))
+    expected = 1 + rate * nworker * nrepeat
+    for k, s in snapshot_keys_shapes:
+        val = mx.nd.zeros(s)
+        kv.pull(k, out=val)
+        check_diff(val, expected, my_rank)
+    val = mx.nd.sparse.zeros('row_sparse', big_shape)
+    kv.row_sparse_pull(snapshot_rsp_key, out=val, row_ids=mx.nd.arange(big_shape[0], dtype='int64'))
+    check_diff(val, expected, my_rank)
+    if not restore and my_rank == 0:
+        kv.save_server_snapshot(snapshot_prefix)
+        kv.wait_server_snapshot()
+        # the servers of the local test cluster share this disk
+        for r in range(int(os.environ.get('DMLC_NUM_SERVER', '1'))):
+            assert os.path.exists(snapshot_prefix + '-server-' + str(r) + '.params')
+    print('worker ' + str(my_rank) + ' is done with snapshot tests')
+
 def test_sync_init(gpu_tests=False):
     def get_dtype(idx, cur_keys):
         if idx < len(cur_keys)/2:
@@ -359,10 +486,25 @@ if __name__ == "__main__":
     opt = parser.parse_args()
     if opt.type == 'all' or  opt.type == 'init':
         test_sync_init(opt.gpu)
+    # the sparse store of the servers only holds float32 row_sparse values,
+    # so it is tested on its own
+    if opt.type == 'sparse_store':
+        test_sync_sparse_store(opt.nrepeat)
+        sys.exit(0)
     kv = init_kv()
     if opt.type == 'all' or  opt.type == 'default':
         kv = set_optimizer(use_multiprecision=opt.multiprecision)
         test_sync_push_pull(opt.nrepeat)
+    # saving and restoring snapshots needs two jobs
+    if opt.type == 'save_snapshot' or opt.type == 'restore_snapshot':
+        test_sync_snapshot(opt.type == 'restore_snapshot', opt.nrepeat)
+    if opt.type == 'all' or  opt.type == 'fused':
+        kv = set_optimizer(use_multiprecision=opt.multiprecision)
+        test_sync_fused_push_pull(opt.nrepeat)
+    # topk compression is only tested on its own, as compression can be set only once
+    if opt.type == 'topk':
+        kv = set_optimizer(use_multiprecision=opt.multiprecision)
+        test_sync_topk_compression(0.01, opt.nrepeat)
     # dont run non compressed tests after this as kvstore compression will be set here
     if opt.type == 'all' or  opt.type == 'compressed':
         kv, threshold = init_kv_compressed(kv)
@@ -53,6 +53,8 @@ juLog -name=Python.Local.KVStore -error=Error python test_kvstore.py
 
 # python: distributed kvstore
 juLog -name=Python.Distributed.KVStore -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+MXNET_KVSTORE_SERVER_UPDATE_THREADS=4 juLog -name=Python.Distributed.KVStore.UpdateThreads -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+MXNET_KVSTORE_SERVER_UPDATE_THREADS=4 juLog -name=Python.Distributed.AsyncKVStore.UpdateThreads -error=Error ../../tools/launch.py -n 4 python dist_async_kvstore.py
 
 # download data
 juLog -name=DownloadData bash ./download.sh
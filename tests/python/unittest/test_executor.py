@@ -161,6 +161,80 @@ def test_reshape():
     assert np.all(exe.outputs[0].asnumpy() == 4)
 
 
+@with_seed()
+def test_elemwise_fusion():
+    a = mx.sym.Variable('a')
+    b = mx.sym.Variable('b')
+    c = mx.sym.Variable('c')
+    x = mx.sym.Activation(mx.sym.broadcast_add(a, b), act_type='relu')
+    x = mx.sym.sigmoid(x * c) * 0.5 + 1
+    y = mx.sym.FullyConnected(x, num_hidden=3, no_bias=True, name='fc')
+    out = mx.sym.Group([x, mx.sym.tanh(mx.sym.exp(-y))])
+    shape = (4, 5)
+    args = {'a': mx.nd.random.uniform(-1, 1, shape),
+            'b': mx.nd.random.uniform(-1, 1, shape),
+            'c': mx.nd.random.uniform(-1, 1, shape),
+            'fc_weight': mx.nd.random.uniform(-1, 1, (3, 5))}
+    np_args = {k: v.asnumpy() for k, v in args.items()}
+    np_x = 1 / (1 + np.exp(-np.maximum(np_args['a'] + np_args['b'], 0) * np_args['c'])) * 0.5 + 1
+    np_y = np.tanh(np.exp(-np.dot(np_x, np_args['fc_weight'].T)))
+
+    prev = mx.test_utils.set_env_var('MXNET_CPU_ELEMWISE_FUSION', '1', '0')
+    try:
+        for fused in ['1', '0']:
+            mx.test_utils.set_env_var('MXNET_CPU_ELEMWISE_FUSION', fused)
+            exe = out.bind(mx.cpu(), args=args, grad_req='null')
+            assert ('_FusedElemwise' in exe.debug_str()) == (fused == '1')
+            exe.forward(is_train=False)
+            mx.test_utils.assert_almost_equal(exe.outputs[0].asnumpy(), np_x, rtol=1e-5, atol=1e-6)
+            mx.test_utils.assert_almost_equal(exe.outputs[1].asnumpy(), np_y, rtol=1e-5, atol=1e-6)
+        # graphs computing gradients are not fused
+        exe = out.simple_bind(mx.cpu(), a=shape, b=shape, c=shape)
+        assert '_FusedElemwise' not in exe.debug_str()
+    finally:
+        mx.test_utils.set_env_var('MXNET_CPU_ELEMWISE_FUSION', prev)
+
+
+@with_seed()
+def test_backward_memory_budget():
+    def planned_mb(exe):
+        line = [l for l in exe.debug_str().split('\n') if l.endswith('MB allocated')][0]
+        return int(line.split()[1])
+
+    # every activation takes 2 MB
+    shape = (512, 1024)
+    x = mx.sym.Variable('data')
+    for i in range(6):
+        x = mx.sym.FullyConnected(x, num_hidden=shape[1], name='fc%d' % i)
+        x = mx.sym.Activation(x, act_type='tanh', name='act%d' % i)
+    out = mx.sym.sum(x)
+    args = {'data': mx.nd.random.uniform(-1, 1, shape)}
+    for i in range(6):
+        args['fc%d_weight' % i] = mx.nd.random.uniform(-0.05, 0.05, (shape[1], shape[1]))
+        args['fc%d_bias' % i] = mx.nd.random.uniform(-0.05, 0.05, (shape[1],))
+
+    def run(budget_mb):
+        mx.test_utils.set_env_var('MXNET_BACKWARD_MEMORY_BUDGET_MB', str(budget_mb))
+        exe = out.simple_bind(mx.cpu(), data=shape)
+        for k, v in args.items():
+            exe.arg_dict[k][:] = v
+        exe.forward(is_train=True)
+        exe.backward()
+        grads = {k: v.asnumpy() for k, v in exe.grad_dict.items()}
+        return planned_mb(exe), exe.outputs[0].asnumpy(), grads
+
+    prev = mx.test_utils.set_env_var('MXNET_BACKWARD_MEMORY_BUDGET_MB', '0', '0')
+    try:
+        base_mb, base_out, base_grads = run(0)
+        budget_mb, budget_out, budget_grads = run(base_mb // 2)
+    finally:
+        mx.test_utils.set_env_var('MXNET_BACKWARD_MEMORY_BUDGET_MB', prev)
+    assert budget_mb < base_mb, (budget_mb, base_mb)
+    mx.test_utils.assert_almost_equal(budget_out, base_out, rtol=1e-5, atol=1e-5)
+    for k, v in base_grads.items():
+        mx.test_utils.assert_almost_equal(budget_grads[k], v, rtol=1e-5, atol=1e-6)
+
+
 if __name__ == "__main__":
     import nose
     nose.runmodule()
@@ -863,6 +863,104 @@ def test_inline():
     assert len_1 == len_2 + 2
 
 
+@with_seed()
+def test_hybrid_static_memory():
+    x = mx.nd.random.uniform(shape=(2, 3, 32, 32))
+    x2 = mx.nd.random.uniform(shape=(4, 3, 32, 32))
+
+    net1 = gluon.model_zoo.vision.get_resnet(1, 18, pretrained=False, prefix='net_')
+    net2 = gluon.model_zoo.vision.get_resnet(1, 18, pretrained=False, prefix='net_')
+    net1.collect_params().initialize()
+    net2.collect_params().initialize()
+    net1(x)
+    for k, v in net1.collect_params().items():
+        net2.collect_params()[k].set_data(v.data())
+
+    net1.hybridize()
+    net2.hybridize(static_alloc=True)
+    for data in [x, x2, x, x2]:
+        y1 = net1(data)
+        y2 = net2(data)
+        assert_almost_equal(y1.asnumpy(), y2.asnumpy(), rtol=1e-3, atol=1e-5)
+
+    # previous outputs must survive later calls
+    y_prev = net2(x)
+    y_prev_np = y_prev.asnumpy()
+    net2(x)
+    assert_almost_equal(y_prev.asnumpy(), y_prev_np)
+
+    net3 = gluon.nn.HybridSequential()
+    with net3.name_scope():
+        net3.add(gluon.nn.Dense(10))
+    net3.initialize()
+    net3.hybridize(static_alloc=True, static_shape=True)
+    net3(mx.nd.ones((2, 5)))
+    try:
+        net3(mx.nd.ones((3, 5)))
+        assert False, "static_shape should reject a new input shape"
+    except mx.base.MXNetError:
+        pass
+
+
+@with_seed()
+def test_hybrid_static_memory_shapes():
+    # more input shapes than kept states, so that states are freed and planned again
+    net1 = gluon.nn.HybridSequential()
+    net2 = gluon.nn.HybridSequential()
+    for net in [net1, net2]:
+        with net.name_scope():
+            net.add(gluon.nn.Dense(8, activation='relu', flatten=False))
+            net.add(gluon.nn.Dense(4, flatten=False))
+    net1.initialize()
+    net2.initialize()
+    x = mx.nd.random.uniform(shape=(2, 5, 6))
+    net1(x)
+    net2(x)
+    for p1, p2 in zip(net1.collect_params().values(), net2.collect_params().values()):
+        p2.set_data(p1.data())
+
+    net1.hybridize()
+    net2.hybridize(static_alloc=True, max_static_states=2)
+    inputs = [mx.nd.random.uniform(shape=(2, seq_len, 6)) for seq_len in range(1, 5)]
+    for data in inputs + inputs[::-1] + inputs:
+        assert_almost_equal(net1(data).asnumpy(), net2(data).asnumpy(), rtol=1e-5, atol=1e-6)
+
+
+@with_seed()
+def test_hybrid_static_memory_elemwise_fusion():
+    class ElemwiseChain(gluon.HybridBlock):
+        def __init__(self, **kwargs):
+            super(ElemwiseChain, self).__init__(**kwargs)
+            with self.name_scope():
+                self.dense = gluon.nn.Dense(6)
+
+        def hybrid_forward(self, F, x, y):
+            # the sum of the chain is used twice, the chain of the dense output once
+            z = F.Activation(F.broadcast_add(x, y), act_type='relu')
+            z = F.sigmoid(z * y) * 0.5 + 1
+            h = F.tanh(F.exp(-self.dense(z)))
+            return z, h * 2 - 1
+
+    x = mx.nd.random.uniform(-1, 1, shape=(4, 5))
+    y = mx.nd.random.uniform(-1, 1, shape=(4, 5))
+    net = ElemwiseChain(prefix='chain_')
+    net.initialize()
+    expected = [o.asnumpy() for o in net(x, y)]
+
+    prev = mx.test_utils.set_env_var('MXNET_CPU_ELEMWISE_FUSION', '1', '0')
+    try:
+        for fused in ['1', '0']:
+            mx.test_utils.set_env_var('MXNET_CPU_ELEMWISE_FUSION', fused)
+            fused_net = ElemwiseChain(prefix='chain_', params=net.collect_params())
+            fused_net.hybridize(static_alloc=True)
+            # the second call reuses the buffers planned by the first one
+            for _ in range(2):
+                for out, exp in zip(fused_net(x, y), expected):
+                    assert_almost_equal(out.asnumpy(), exp, rtol=1e-5, atol=1e-6)
+    finally:
+        mx.test_utils.set_env_var('MXNET_CPU_ELEMWISE_FUSION', prev)
+
+
 def test_activations():
     point_to_validate = mx.nd.array([-0.1, 0.1] * 3)
 
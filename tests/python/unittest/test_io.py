@@ -84,6 +84,132 @@ def test_Cifar10Rec():
     for i in range(10):
         assert(labelcount[i] == 5000)
 
+def test_ImageRecordIter_cache_decoded():
+    get_cifar10()
+    def read_epochs(num_epochs, **kwargs):
+        dataiter = mx.io.ImageRecordIter(
+                path_imgrec="data/cifar/train.rec",
+                rand_crop=False,
+                rand_mirror=False,
+                shuffle=False,
+                resize=36,
+                data_shape=(3,28,28),
+                batch_size=1000,
+                preprocess_threads=4,
+                **kwargs)
+        epochs = []
+        for _ in range(num_epochs):
+            dataiter.reset()
+            batches = [batch.data[0].asnumpy() for _, batch in zip(range(5), dataiter)]
+            epochs.append(np.concatenate(batches))
+        return epochs
+    expected = read_epochs(1)[0]
+    cache_file = os.path.join(os.getcwd(), 'decoded_cache.bin')
+    for kwargs in [{}, {'cache_decoded_file': cache_file}]:
+        for data in read_epochs(3, cache_decoded=True, **kwargs):
+            assert_almost_equal(data, expected)
+    assert not os.path.exists(cache_file)
+
+def test_ImageRecordIter_cache_decoded_same_ids():
+    get_cifar10()
+    # records with the same id in their header are cached apart
+    path = os.path.join(os.getcwd(), 'same_ids.rec')
+    reader = mx.recordio.MXRecordIO("data/cifar/train.rec", 'r')
+    writer = mx.recordio.MXRecordIO(path, 'w')
+    for _ in range(4):
+        header, img = mx.recordio.unpack(reader.read())
+        writer.write(mx.recordio.pack(header._replace(id=0, id2=0), img))
+    reader.close()
+    writer.close()
+    def read_epochs(num_epochs, **kwargs):
+        dataiter = mx.io.ImageRecordIter(path_imgrec=path, data_shape=(3,32,32),
+                                         batch_size=4, **kwargs)
+        epochs = []
+        for _ in range(num_epochs):
+            dataiter.reset()
+            epochs.append(dataiter.next().data[0].asnumpy())
+        return epochs
+    expected = read_epochs(1)[0]
+    for data in read_epochs(2, cache_decoded=True):
+        assert_almost_equal(data, expected)
+    os.remove(path)
+
+def test_ImageRecordIter_fused_augment():
+    get_cifar10()
+    def read_batch(**kwargs):
+        dataiter = mx.io.ImageRecordIter(
+                path_imgrec="data/cifar/train.rec",
+                rand_crop=True,
+                rand_mirror=True,
+                shuffle=False,
+                data_shape=(3,28,28),
+                batch_size=100,
+                # one thread, so that each image gets the same random numbers
+                preprocess_threads=1,
+                **kwargs)
+        return dataiter.next().data[0].asnumpy()
+    # the resize differs from the one of OpenCV by at most one level
+    for kwargs in [{'resize': 36}, {'min_crop_size': 24, 'max_crop_size': 32}, {}]:
+        fused = read_batch(fused_augment=True, **kwargs)
+        separate = read_batch(**kwargs)
+        assert np.abs(fused - separate).max() <= 1
+
+def test_TensorRecordIter():
+    import struct
+    num_records, shape, label_width, batch_size = 10, (2, 3), 2, 4
+    data = np.arange(num_records * 6, dtype=np.float32).reshape((num_records,) + shape)
+    label = np.arange(num_records * label_width, dtype=np.float32).reshape(num_records, -1)
+    ids = np.arange(100, 100 + num_records, dtype=np.uint64)
+    # the layout of src/io/tensor_record.h
+    ids_offset = 128
+    labels_offset = ids_offset + ids.nbytes
+    data_offset = (labels_offset + label.nbytes + 4095) // 4096 * 4096
+    header = struct.pack('<QIiII8QQQQQQ', 0x524f534e4554584d, 1, 0, len(shape), label_width,
+                         *(shape + (0,) * 6 + (num_records, ids_offset, labels_offset,
+                                                data_offset, 0)))
+    path = os.path.join(os.getcwd(), 'data.trec')
+    with open(path, 'wb') as fout:
+        fout.write(header + ids.tobytes() + label.tobytes())
+        fout.write(b'\0' * (data_offset - labels_offset - label.nbytes))
+        fout.write(data.tobytes())
+
+    def read_epoch(dataiter):
+        dataiter.reset()
+        records, pads = [], []
+        for batch in dataiter:
+            assert batch.data[0].shape == (batch_size,) + shape
+            assert batch.label[0].shape == (batch_size, label_width)
+            num = batch_size - batch.pad
+            index = batch.index[:num].astype(np.int64) - 100
+            assert_almost_equal(batch.data[0].asnumpy()[:num], data[index])
+            assert_almost_equal(batch.label[0].asnumpy()[:num], label[index])
+            records.extend(index)
+            pads.append(batch.pad)
+        return records, pads
+
+    dataiter = mx.io.TensorRecordIter(path_tensorrec=path, batch_size=batch_size)
+    for _ in range(2):
+        records, pads = read_epoch(dataiter)
+        assert records == list(range(num_records))
+        assert pads == [0, 0, 2]
+    # batches changed in place and kept after the iterator do not change the file
+    dataiter.reset()
+    batch = dataiter.next()
+    batch.data[0][:] = -1
+    assert read_epoch(dataiter)[0] == list(range(num_records))
+    del dataiter
+    assert batch.data[0].asnumpy().shape == (batch_size,) + shape
+    dataiter = mx.io.TensorRecordIter(path_tensorrec=path, batch_size=batch_size, shuffle=True)
+    epochs = [read_epoch(dataiter)[0] for _ in range(2)]
+    for records in epochs:
+        assert sorted(records) == list(range(num_records))
+    assert epochs[0] != epochs[1]
+    dataiter = mx.io.TensorRecordIter(path_tensorrec=path, batch_size=batch_size,
+                                      num_parts=2, part_index=1)
+    assert read_epoch(dataiter)[0] == list(range(5, 10))
+    del dataiter
+    os.remove(path)
+
 def test_NDArrayIter():
     data = np.ones([1000, 2, 2])
     label = np.ones([1000, 1])
@@ -277,9 +403,20 @@ def test_LibSVMIter():
         for batch in iter(data_train):
             data_train.get_data().asnumpy()
 
+    def check_libSVMIter_index_exception():
+        data_path = os.path.join(os.getcwd(), 'data.t')
+        with open(data_path, 'w') as fout:
+            fout.write('1.0 0:0.5 2:1.2\n')
+            # Below line has an indice beyond data_shape. Should throw an exception
+            fout.write('-2.0 3:0.6\n')
+        data_train = mx.io.LibSVMIter(data_libsvm=data_path, data_shape=(3, ), batch_size=2)
+        for batch in iter(data_train):
+            data_train.getdata().asnumpy()
+
     check_libSVMIter_synthetic()
     check_libSVMIter_news_data()
     assertRaises(MXNetError, check_libSVMIter_exception)
+    assertRaises(MXNetError, check_libSVMIter_index_exception)
 
 
 def test_DataBatch():
@@ -313,12 +450,43 @@ def test_CSVIter():
 
     check_CSVIter_synthetic()
 
+def test_CSVIter_rows():
+    cwd = os.getcwd()
+    data_path = os.path.join(cwd, 'rows.csv')
+    label_path = os.path.join(cwd, 'rows_label.csv')
+    num_rows, dim, batch_size = 10, 3, 4
+    with open(data_path, 'w') as fout:
+        for i in range(num_rows):
+            fout.write(','.join([str(i * dim + j) for j in range(dim)]) + '\n')
+    with open(label_path, 'w') as fout:
+        for i in range(num_rows):
+            fout.write('%d\n' % -i)
+
+    data_train = mx.io.CSVIter(data_csv=data_path, data_shape=(dim,), label_csv=label_path,
+                               batch_size=batch_size, round_batch=False, preprocess_threads=3)
+    expected = np.arange(num_rows * dim, dtype=np.float32).reshape((num_rows, dim))
+    for epoch in range(2):
+        data_train.reset()
+        begin = 0
+        for batch in data_train:
+            num = batch_size - batch.pad
+            assert_almost_equal(batch.data[0].asnumpy()[:num], expected[begin:begin + num])
+            assert_almost_equal(batch.label[0].asnumpy()[:num, 0],
+                                -np.arange(begin, begin + num, dtype=np.float32))
+            begin += num
+        assert begin == num_rows
+
 if __name__ == "__main__":
     test_NDArrayIter()
     if h5py:
         test_NDArrayIter_h5py()
     test_MNISTIter()
     test_Cifar10Rec()
+    test_ImageRecordIter_cache_decoded()
+    test_ImageRecordIter_cache_decoded_same_ids()
+    test_ImageRecordIter_fused_augment()
+    test_TensorRecordIter()
     test_LibSVMIter()
     test_NDArrayIter_csr()
     test_CSVIter()
+    test_CSVIter_rows()
@@ -18,6 +18,10 @@
 # pylint: skip-file
 import mxnet as mx
 import numpy as np
+import os
+import subprocess
+import sys
+import time
 import unittest
 from mxnet.test_utils import rand_ndarray, assert_almost_equal, assert_exception
 from common import setup_module, with_seed
@@ -246,6 +250,77 @@ def test_get_type():
     kv = mx.kv.create(kvtype)
     assert kv.type == kvtype
 
+_shm_kvstore_proc = """
+import mxnet as mx
+import numpy as np
+kv = mx.kv.create('shm')
+rank, nproc = kv.rank, kv.num_workers
+# the second value is big enough to be summed by several threads
+shapes = [(4, 4), (1200, 1200)]
+# the initial value of the first process is used
+kv.init(['a', 'b'], [mx.nd.ones(s) * (rank + 1) for s in shapes])
+for s, k in zip(shapes, ['a', 'b']):
+    out = mx.nd.zeros(s)
+    kv.pull(k, out=out)
+    assert (out.asnumpy() == 1).all(), (rank, k)
+for i in range(3):
+    # two devices per process
+    kv.push(['a', 'b'], [[mx.nd.ones(s) * (rank + i)] * 2 for s in shapes])
+    for s, k in zip(shapes, ['a', 'b']):
+        out = mx.nd.zeros(s)
+        kv.pull(k, out=out)
+        expected = 2 * sum(r + i for r in range(nproc))
+        assert (out.asnumpy() == expected).all(), (rank, k, i)
+kv._barrier()
+"""
+
+def _run_shm_kvstore_procs(code, nproc, timeout=300):
+    """Runs code in nproc processes of a shm kvstore and returns their exit codes, killing
+    those still running after timeout seconds."""
+    procs = []
+    for rank in range(nproc):
+        env = dict(os.environ, MXNET_KVSTORE_SHM_RANK=str(rank),
+                   MXNET_KVSTORE_SHM_NUM_PROCS=str(nproc),
+                   MXNET_KVSTORE_SHM_NAME='test_%d' % os.getpid(),
+                   MXNET_KVSTORE_SHM_TIMEOUT=str(timeout))
+        procs.append(subprocess.Popen([sys.executable, '-c', code], env=env))
+    deadline = time.time() + timeout
+    try:
+        for p in procs:
+            p.wait(timeout=max(deadline - time.time(), 0))
+    except subprocess.TimeoutExpired:
+        pass
+    finally:
+        for p in procs:
+            if p.poll() is None:
+                p.kill()
+                p.wait()
+    return [p.returncode for p in procs]
+
+@unittest.skipIf(sys.platform.startswith('win'), 'the shm kvstore needs POSIX shared memory')
+def test_shm_kvstore():
+    assert _run_shm_kvstore_procs(_shm_kvstore_proc, 3) == [0] * 3
+
+_shm_kvstore_dead_proc = """
+import os
+import mxnet as mx
+kv = mx.kv.create('shm')
+kv.init('a', mx.nd.ones((4, 4)))
+if kv.rank == 1:
+    os._exit(0)
+kv.push('a', mx.nd.ones((4, 4)))
+out = mx.nd.zeros((4, 4))
+kv.pull('a', out=out)
+out.wait_to_read()
+"""
+
+@unittest.skipIf(sys.platform.startswith('win'), 'the shm kvstore needs POSIX shared memory')
+def test_shm_kvstore_dead_process():
+    # the others fail instead of waiting for the process which exited
+    codes = _run_shm_kvstore_procs(_shm_kvstore_dead_proc, 3, timeout=60)
+    assert codes[1] == 0
+    assert codes[0] > 0 and codes[2] > 0, codes
+
 @with_seed()
 def test_invalid_pull():
     def check_ignored_pull_single(kv, key):
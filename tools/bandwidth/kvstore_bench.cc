@@ -0,0 +1,339 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file kvstore_bench.cc
+ * \brief benchmark of the distributed kvstore on one machine. Launches the
+ *  scheduler, the servers and the workers as local processes, and reports
+ *  the latency percentiles and the throughput of pushes and pulls.
+ */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <dmlc/logging.h>
+#include <mxnet/engine.h>
+#include <mxnet/kvstore.h>
+#include <mxnet/ndarray.h>
+#include "../../src/kvstore/kvstore_dist_server.h"
+
+using namespace mxnet;
+
+namespace {
+
+struct Options {
+  int num_workers = 2;
+  int num_servers = 1;
+  int port = 9091;
+  int iterations = 20;
+  int warmup = 3;
+  std::vector<std::string> modes = {"dist_sync", "dist_async"};
+  std::vector<std::string> compressions = {"none", "2bit"};
+  std::vector<std::string> dtypes = {"float32", "float16"};
+  std::vector<int> keys = {1, 10};
+  std::vector<int> sizes = {1000, 100000, 1000000};
+  std::string csv;
+};
+
+std::vector<std::string> Split(const std::string& s) {
+  std::vector<std::string> items;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) items.push_back(item);
+  }
+  return items;
+}
+
+std::vector<int> SplitInts(const std::string& s) {
+  std::vector<int> items;
+  for (const auto& item : Split(s)) items.push_back(atoi(item.c_str()));
+  return items;
+}
+
+/*!
+ * \brief parses the arguments in form key=value, later ones win
+ */
+Options Parse(int argc, char* argv[]) {
+  Options opt;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq = arg.find('=');
+    CHECK_NE(eq, std::string::npos) << "Expect key=value instead of " << arg;
+    const std::string key = arg.substr(0, eq), val = arg.substr(eq + 1);
+    if (key == "num_workers") {
+      opt.num_workers = atoi(val.c_str());
+    } else if (key == "num_servers") {
+      opt.num_servers = atoi(val.c_str());
+    } else if (key == "port") {
+      opt.port = atoi(val.c_str());
+    } else if (key == "iterations") {
+      opt.iterations = atoi(val.c_str());
+    } else if (key == "warmup") {
+      opt.warmup = atoi(val.c_str());
+    } else if (key == "modes") {
+      opt.modes = Split(val);
+    } else if (key == "compressions") {
+      opt.compressions = Split(val);
+    } else if (key == "dtypes") {
+      opt.dtypes = Split(val);
+    } else if (key == "keys") {
+      opt.keys = SplitInts(val);
+    } else if (key == "sizes") {
+      opt.sizes = SplitInts(val);
+    } else if (key == "csv") {
+      opt.csv = val;
+    } else {
+      LOG(FATAL) << "Unknown argument " << key;
+    }
+  }
+  CHECK(opt.num_workers > 0 && opt.num_servers > 0 && opt.iterations > 0);
+  return opt;
+}
+
+int DType(const std::string& name) {
+  static const std::map<std::string, int> dtypes = {
+    {"float32", mshadow::kFloat32}, {"float64", mshadow::kFloat64},
+    {"float16", mshadow::kFloat16}};
+  auto it = dtypes.find(name);
+  CHECK(it != dtypes.end()) << "Unknown dtype " << name;
+  return it->second;
+}
+
+/*!
+ * \brief nearest rank percentile of sorted values
+ */
+double Percentile(const std::vector<double>& sorted, double p) {
+  const size_t rank = static_cast<size_t>(p / 100 * sorted.size() + 0.5);
+  return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+double Now() {
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* kHeader = "mode,compression,dtype,keys,size,"
+                      "push_p50_ms,push_p90_ms,push_p99_ms,pull_p50_ms,pull_p90_ms,pull_p99_ms,"
+                      "push_MBps,pull_MBps";
+
+/*!
+ * \brief runs the sweep of one cluster on a worker. Rank 0 reports the latencies
+ *  it observed, which in sync mode include waiting for the slowest worker.
+ */
+int RunWorker(const Options& opt) {
+  CHECK_EQ(opt.modes.size(), 1U);
+  CHECK_EQ(opt.compressions.size(), 1U);
+  const std::string& mode = opt.modes[0];
+  const std::string& compression = opt.compressions[0];
+  std::unique_ptr<KVStore> kv(KVStore::Create(mode.c_str()));
+  const int rank = kv->get_rank();
+  if (rank == 0) {
+    // servers sum the pushes, as async mode needs an updater
+    kv->SendCommandToServers(static_cast<int>(kvstore::CommandType::kController), "sum");
+  }
+  if (compression != "none") kv->SetGradientCompression({{"type", compression}});
+  kv->Barrier();
+
+  int next_key = 0;
+  for (const auto& dtype_name : opt.dtypes) {
+    const int dtype = DType(dtype_name);
+    if (compression != "none" && dtype != mshadow::kFloat32) {
+      if (rank == 0) {
+        LOG(INFO) << "Skip " << dtype_name << " with " << compression
+                  << " compression, which only supports float32";
+      }
+      continue;
+    }
+    for (int num_keys : opt.keys) {
+      for (int size : opt.sizes) {
+        std::vector<int> keys;
+        std::vector<NDArray> vals, outs;
+        std::vector<NDArray*> out_ptrs;
+        for (int k = 0; k < num_keys; ++k) {
+          keys.push_back(next_key++);
+          vals.emplace_back(TShape(mshadow::Shape1(size)), Context::CPU(), false, dtype);
+          vals.back() = 1.0f;
+          outs.emplace_back(TShape(mshadow::Shape1(size)), Context::CPU(), false, dtype);
+        }
+        for (auto& out : outs) out_ptrs.push_back(&out);
+        kv->Init(keys, vals);
+        kv->Barrier();
+
+        std::vector<double> push_ms, pull_ms;
+        for (int it = 0; it < opt.warmup + opt.iterations; ++it) {
+          const double start = Now();
+          kv->Push(keys, vals, 0);
+          Engine::Get()->WaitForAll();
+          const double pushed = Now();
+          kv->Pull(keys, out_ptrs, 0);
+          Engine::Get()->WaitForAll();
+          if (it < opt.warmup) continue;
+          push_ms.push_back(pushed - start);
+          pull_ms.push_back(Now() - pushed);
+        }
+        kv->Barrier();
+        if (rank != 0) continue;
+
+        std::sort(push_ms.begin(), push_ms.end());
+        std::sort(pull_ms.begin(), pull_ms.end());
+        auto mean = [](const std::vector<double>& v) {
+          double sum = 0;
+          for (double x : v) sum += x;
+          return sum / v.size();
+        };
+        const double mbytes = static_cast<double>(num_keys) * size *
+                              mshadow::mshadow_sizeof(dtype) / (1 << 20);
+        std::ostringstream row;
+        row << mode << "," << compression << "," << dtype_name << "," << num_keys << ","
+            << size << "," << Percentile(push_ms, 50) << "," << Percentile(push_ms, 90) << ","
+            << Percentile(push_ms, 99) << "," << Percentile(pull_ms, 50) << ","
+            << Percentile(pull_ms, 90) << "," << Percentile(pull_ms, 99) << ","
+            << mbytes / (mean(push_ms) * 1e-3) << "," << mbytes / (mean(pull_ms) * 1e-3);
+        printf("%s\n", row.str().c_str());
+        fflush(stdout);
+        if (!opt.csv.empty()) std::ofstream(opt.csv, std::ios::app) << row.str() << "\n";
+      }
+    }
+  }
+  // the destructor stops the servers
+  kv.reset();
+  return 0;
+}
+
+/*!
+ * \brief runs a server or the scheduler until the workers are done
+ */
+int RunServer() {
+  std::unique_ptr<KVStore> kv(KVStore::Create("dist"));
+  KVStore* store = kv.get();
+  kv->RunServer([store](int head, const std::string& body) {
+    CHECK_EQ(head, static_cast<int>(kvstore::CommandType::kController));
+    store->set_updater([](int key, const NDArray& recv, NDArray* local) {
+      *local += recv;
+    });
+  });
+  return 0;
+}
+
+std::string SelfPath(const char* argv0) {
+  char buf[4096];
+  const ssize_t len = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+  if (len <= 0) return argv0;
+  buf[len] = '\0';
+  return buf;
+}
+
+pid_t Spawn(const std::string& self, const std::vector<std::string>& args,
+            const std::map<std::string, std::string>& envs) {
+  const pid_t pid = fork();
+  CHECK_GE(pid, 0) << "fork failed: " << strerror(errno);
+  if (pid > 0) return pid;
+  for (const auto& env : envs) setenv(env.first.c_str(), env.second.c_str(), 1);
+  std::vector<char*> argv;
+  argv.push_back(const_cast<char*>(self.c_str()));
+  for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+  execv(self.c_str(), argv.data());
+  fprintf(stderr, "exec %s failed: %s\n", self.c_str(), strerror(errno));
+  _exit(127);
+}
+
+/*!
+ * \brief launches one local cluster per mode and compression, each of which
+ *  runs the sweep of the other options
+ */
+int Launch(const Options& opt, int argc, char* argv[]) {
+  const std::string self = SelfPath(argv[0]);
+  if (!opt.csv.empty()) std::ofstream(opt.csv) << kHeader << "\n";
+  printf("%s\n", kHeader);
+  fflush(stdout);
+  int cluster = 0;
+  for (const auto& mode : opt.modes) {
+    for (const auto& compression : opt.compressions) {
+      std::vector<std::string> args(argv + 1, argv + argc);
+      args.push_back("modes=" + mode);
+      args.push_back("compressions=" + compression);
+      std::map<std::string, std::string> envs = {
+        {"DMLC_PS_ROOT_URI", "127.0.0.1"},
+        {"DMLC_PS_ROOT_PORT", std::to_string(opt.port + cluster++)},
+        {"DMLC_NUM_SERVER", std::to_string(opt.num_servers)},
+        {"DMLC_NUM_WORKER", std::to_string(opt.num_workers)}};
+      if (!getenv("DMLC_NODE_HOST")) envs["DMLC_NODE_HOST"] = "127.0.0.1";
+      std::vector<pid_t> pids;
+      auto spawn = [&](const char* role, int num) {
+        envs["DMLC_ROLE"] = role;
+        for (int i = 0; i < num; ++i) pids.push_back(Spawn(self, args, envs));
+      };
+      spawn("scheduler", 1);
+      spawn("server", opt.num_servers);
+      spawn("worker", opt.num_workers);
+      int failed = 0;
+      for (pid_t pid : pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ++failed;
+      }
+      if (failed) {
+        LOG(ERROR) << failed << " processes failed in " << mode << " with "
+                   << compression << " compression";
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+    printf("Usage: %s [parameters in form key=value]\n"
+           "\tnum_workers=N[default=2] number of worker processes\n"
+           "\tnum_servers=N[default=1] number of server processes\n"
+           "\tmodes=M,...[default=dist_sync,dist_async] kvstore types\n"
+           "\tcompressions=C,...[default=none,2bit] gradient compression types, or none\n"
+           "\tdtypes=D,...[default=float32,float16] dtypes of the values\n"
+           "\tkeys=K,...[default=1,10] numbers of keys pushed and pulled together\n"
+           "\tsizes=S,...[default=1000,100000,1000000] number of elements per key\n"
+           "\titerations=N[default=20] timed pushes and pulls per configuration\n"
+           "\twarmup=N[default=3] untimed pushes and pulls per configuration\n"
+           "\tport=P[default=9091] port of the scheduler of the first cluster, one more per cluster\n"
+           "\tcsv=FILE write the results to FILE too\n", argv[0]);
+    return 0;
+  }
+  const Options opt = Parse(argc, argv);
+  const char* role = getenv("DMLC_ROLE");
+  if (!role) return Launch(opt, argc, argv);
+  if (!strcmp(role, "worker")) return RunWorker(opt);
+  return RunServer();
+}
@@ -0,0 +1,241 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file tensor2rec.cc
+ * \brief pack decoded tensors into the tensor record format, read by TensorRecordIter
+ *
+ *  Tensor List Format: unique-index label[s] path-to-tensor
+ *  The tensors are .npy files, or raw files of the given shape and dtype.
+ * \sa src/io/tensor_record.h
+ */
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/timer.h>
+#include "../src/io/tensor_record.h"
+
+namespace {
+
+/*! \brief type flag of a dtype name, or -1 if unknown */
+int DTypeFromName(const std::string& name) {
+  if (name == "float32") return mshadow::kFloat32;
+  if (name == "float64") return mshadow::kFloat64;
+  if (name == "float16") return mshadow::kFloat16;
+  if (name == "uint8") return mshadow::kUint8;
+  if (name == "int8") return mshadow::kInt8;
+  if (name == "int32") return mshadow::kInt32;
+  if (name == "int64") return mshadow::kInt64;
+  return -1;
+}
+
+/*! \brief type flag of a little endian numpy type descr such as '<f4', or -1 */
+int DTypeFromDescr(const std::string& descr) {
+  if (descr.size() != 3 || (descr[0] != '<' && descr[0] != '|')) return -1;
+  const std::string kind = descr.substr(1);
+  if (kind == "f4") return mshadow::kFloat32;
+  if (kind == "f8") return mshadow::kFloat64;
+  if (kind == "f2") return mshadow::kFloat16;
+  if (kind == "u1") return mshadow::kUint8;
+  if (kind == "i1") return mshadow::kInt8;
+  if (kind == "i4") return mshadow::kInt32;
+  if (kind == "i8") return mshadow::kInt64;
+  return -1;
+}
+
+/*! \brief value of a key in the header dict of a .npy file */
+std::string NpyValue(const std::string& dict, const std::string& key) {
+  size_t pos = dict.find("'" + key + "'");
+  CHECK_NE(pos, std::string::npos) << "No " << key << " in the .npy header " << dict;
+  pos = dict.find(':', pos) + 1;
+  while (pos < dict.size() && isspace(dict[pos])) ++pos;
+  size_t end;
+  if (dict[pos] == '(') {
+    end = dict.find(')', pos) + 1;
+  } else if (dict[pos] == '\'') {
+    end = dict.find('\'', pos + 1) + 1;
+  } else {
+    end = dict.find_first_of(",}", pos);
+  }
+  return dict.substr(pos, end - pos);
+}
+
+/*!
+ * \brief reads a tensor from a .npy file, or a raw file of dtype and shape
+ *  when they are given
+ */
+void ReadTensor(const std::string& path, int* dtype, mxnet::TShape* shape,
+                std::vector<char>* data) {
+  std::ifstream fi(path, std::ios::binary);
+  CHECK(fi) << "Failed to open " << path;
+  std::ostringstream os;
+  os << fi.rdbuf();
+  const std::string content = os.str();
+  size_t offset = 0;
+  if (content.compare(0, 6, "\x93NUMPY") == 0) {
+    CHECK_GE(content.size(), 10U) << "Invalid .npy file " << path;
+    const int major = static_cast<unsigned char>(content[6]);
+    size_t header_len;
+    if (major == 1) {
+      header_len = static_cast<unsigned char>(content[8]) |
+                   static_cast<unsigned char>(content[9]) << 8;
+      offset = 10 + header_len;
+    } else {
+      CHECK_GE(content.size(), 12U) << "Invalid .npy file " << path;
+      header_len = 0;
+      for (int i = 3; i >= 0; --i) {
+        header_len = header_len << 8 | static_cast<unsigned char>(content[8 + i]);
+      }
+      offset = 12 + header_len;
+    }
+    CHECK_LE(offset, content.size()) << "Invalid .npy file " << path;
+    const std::string dict = content.substr(offset - header_len, header_len);
+    CHECK_EQ(NpyValue(dict, "fortran_order"), "False")
+      << "Fortran ordered arrays are not supported: " << path;
+    std::string descr = NpyValue(dict, "descr");
+    descr = descr.substr(1, descr.size() - 2);
+    const int npy_dtype = DTypeFromDescr(descr);
+    CHECK_NE(npy_dtype, -1) << "Unsupported type " << descr << " in " << path;
+    // numpy writes a 1-d shape as (n,)
+    std::string shape_str = NpyValue(dict, "shape");
+    const size_t comma = shape_str.rfind(',');
+    if (comma != std::string::npos && shape_str.find_first_not_of(" ", comma + 1) ==
+        shape_str.size() - 1) {
+      shape_str.erase(comma, 1);
+    }
+    mxnet::TShape npy_shape;
+    std::istringstream is(shape_str);
+    CHECK(is >> npy_shape) << "Invalid shape " << shape_str << " in " << path;
+    if (*dtype == -1) *dtype = npy_dtype;
+    if (shape->ndim() == 0) *shape = npy_shape;
+    CHECK_EQ(*dtype, npy_dtype) << "All tensors must have the same type: " << path;
+    CHECK_EQ(*shape, npy_shape) << "All tensors must have the same shape: " << path;
+  } else {
+    CHECK(*dtype != -1 && shape->ndim() != 0)
+      << path << " is not a .npy file, shape and dtype must be given for raw files";
+  }
+  const size_t bytes = shape->Size() * mshadow::mshadow_sizeof(*dtype);
+  CHECK_EQ(content.size() - offset, bytes) << "Unexpected size of the tensor in " << path;
+  data->assign(content.begin() + offset, content.end());
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    printf("Usage: <tensor.lst> <tensor_root_dir> <output.trec> [additional parameters in form key=value]\n"\
+           "Possible additional parameters:\n"\
+           "\tlabel_width=WIDTH[default=1] specify the label_width in the list, by default set to 1\n"\
+           "\tshape=SHAPE[default=from the first .npy file] shape of the tensors, such as (3,224,224)\n"\
+           "\tdtype=DTYPE[default=from the first .npy file] float32, float64, float16, uint8, int8, int32 or int64\n");
+    return 0;
+  }
+  int label_width = 1;
+  int dtype = -1;
+  mxnet::TShape shape;
+  for (int i = 4; i < argc; ++i) {
+    char key[128], val[128];
+    int effct_len = 0;
+
+#ifdef _MSC_VER
+    effct_len = sscanf_s(argv[i], "%[^=]=%s", key, sizeof(key), val, sizeof(val));
+#else
+    effct_len = sscanf(argv[i], "%[^=]=%s", key, val);
+#endif
+
+    if (effct_len == 2) {
+      if (!strcmp(key, "label_width")) label_width = atoi(val);
+      if (!strcmp(key, "dtype")) {
+        dtype = DTypeFromName(val);
+        CHECK_NE(dtype, -1) << "Unknown dtype " << val;
+      }
+      if (!strcmp(key, "shape")) {
+        std::istringstream is(val);
+        CHECK(is >> shape) << "Invalid shape " << val;
+      }
+    }
+  }
+  CHECK_GE(label_width, 1) << "label_width must be positive";
+
+  // the number of records is in the header, so the list is read first
+  std::vector<uint64_t> ids;
+  std::vector<float> labels;
+  std::vector<std::string> paths;
+  std::ifstream flist(argv[1]);
+  CHECK(flist) << "Failed to open " << argv[1];
+  std::string root = argv[2];
+  std::string sline, fname;
+  while (std::getline(flist, sline)) {
+    std::istringstream is(sline);
+    uint64_t id;
+    if (!(is >> id)) continue;
+    ids.push_back(id);
+    for (int k = 0; k < label_width; ++k) {
+      float label;
+      CHECK(is >> label) << "Invalid TensorList, did you provide the correct label_width?";
+      labels.push_back(label);
+    }
+    CHECK(std::getline(is, fname));
+    // eliminate invalid chars in the end
+    while (fname.length() != 0 &&
+           (isspace(*fname.rbegin()) || !isprint(*fname.rbegin()))) {
+      fname.resize(fname.length() - 1);
+    }
+    // eliminate invalid chars in beginning.
+    const char *p = fname.c_str();
+    while (isspace(*p)) ++p;
+    paths.push_back(root + p);
+  }
+  CHECK(!paths.empty()) << "No tensors in " << argv[1];
+
+  double tstart = dmlc::GetTime();
+  // the shape and dtype of the header are known once the first tensor is read
+  std::vector<char> data;
+  ReadTensor(paths[0], &dtype, &shape, &data);
+  const mxnet::io::TensorRecordHeader header = mxnet::io::TensorRecordHeader::Create(
+      dtype, shape, label_width, paths.size());
+  LOG(INFO) << "Write " << paths.size() << " tensors of shape " << shape << " to " << argv[3];
+  dmlc::Stream *fo = dmlc::Stream::Create(argv[3], "w");
+  fo->Write(&header, sizeof(header));
+  fo->Write(ids.data(), ids.size() * sizeof(uint64_t));
+  fo->Write(labels.data(), labels.size() * sizeof(float));
+  const std::vector<char> padding(
+      header.data_offset - header.labels_offset - labels.size() * sizeof(float), 0);
+  fo->Write(padding.data(), padding.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (i != 0) ReadTensor(paths[i], &dtype, &shape, &data);
+    fo->Write(data.data(), data.size());
+    if ((i + 1) % 1000 == 0) {
+      LOG(INFO) << i + 1 << " tensors processed, " << dmlc::GetTime() - tstart << " sec elapsed";
+    }
+  }
+  LOG(INFO) << "Total: " << paths.size() << " tensors processed, "
+            << dmlc::GetTime() - tstart << " sec elapsed";
+  delete fo;
+  return 0;
+}